@@ -58,6 +58,33 @@ void Fatal(const char *format, ...);
 
     unsigned int LoadTexBMPTransparent(const char *file, int blackThreshold);
 
+    // Texture filtering
+#define TEX_LINEAR 0 // bilinear without mipmaps (HUD, UI and skybox textures)
+#define TEX_MIPMAP 1 // trilinear mipmaps, optionally anisotropic
+
+    unsigned int LoadTexBMPFilter(const char *file, int filter);
+    void TexFilter(GLenum target, int filter);
+    void TexFiltering(int trilinear, float anisotropy);
+    float TexMaxAnisotropy(void);
+    int TexCompressed(void);
+
+    // Cube map skybox
+    void SkyDraw(unsigned int cubemap, const double eye[3], float size);
+
+    // Texture atlas of decals
+    unsigned int AtlasPack(const unsigned int textures[], int n);
+    unsigned int AtlasRect(unsigned int texture, float uv[4]);
+
+    // Textures decoded on worker threads and uploaded together
+    typedef struct TexBatch TexBatch;
+    TexBatch *TexBatchNew(void);
+    void TexBatchAdd(TexBatch *batch, const char *file, int blackThreshold, int filter, unsigned int *texture);
+    void TexBatchAddCube(TexBatch *batch, const char *files[6], unsigned int *texture);
+    void TexBatchLoad(TexBatch *batch, int threads);
+
+    // Textures cooked from BMP files into file.tex
+    void TexCook(int argc, char *argv[]);
+
     void Project(int perspective, double fov, double asp, double dim);
 
     void ErrCheck(const char *where);
@@ -68,7 +95,192 @@ void Fatal(const char *format, ...);
                      float diffuse_r, float diffuse_g, float diffuse_b,
                      float specular_r, float specular_g, float specular_b,
                      float shininess);
+
+    // GL state cache
+    void StateReset(void);
+    void StateEnable(GLenum cap);
+    void StateDisable(GLenum cap);
+    void StateMaterialfv(GLenum pname, const float *v);
+    void StateMaterialf(GLenum pname, float v);
+    void StateBindTexture(unsigned int tex);
+    void StateBlendFunc(GLenum src, GLenum dst);
+    void StateBlendFuncSeparate(GLenum src, GLenum dst, GLenum srcAlpha, GLenum dstAlpha);
+    void StateTexEnv(int mode);
+    void StateStats(int *made, int *dropped, int reset);
+    int StateTextureBinds(void);
+
+    // Cached meshes
+#define MESH_MAXPARTS 4
+
+    typedef struct
+    {
+        float x, y, z;    // position
+        float nx, ny, nz; // normal
+        float s, t;       // texture coordinates
+    } MeshVert;
+
+    typedef struct
+    {
+        MeshVert *vert;                 // vertices (kept after upload)
+        unsigned int *index;            // triangle or line indices
+        int nvert, nindex;              // number of vertices and indices
+        int maxvert, maxindex;          // allocated sizes
+        GLenum prim;                    // GL_TRIANGLES or GL_LINES
+        int texCoords;                  // draw with texture coordinates
+        unsigned int vbo, ibo;          // buffer objects
+        int part[MESH_MAXPARTS + 1];    // first index of each part
+        int nparts;                     // number of parts
+        GLenum mode;                    // primitive being built
+        int first;                      // first vertex of primitive being built
+        float normal[3], tex[2];        // current normal and texture coordinate
+    } Mesh;
+
+    // Cache key: shape type, tessellation, texture mode and shape parameters
+    typedef struct
+    {
+        int type;
+        int slices, stacks;
+        int texMode;
+        float param[6];
+    } MeshKey;
+
+    Mesh *MeshNew(void);
+    void MeshFree(Mesh *mesh);
+    void MeshBegin(Mesh *mesh, GLenum mode);
+    void MeshNormal3f(Mesh *mesh, double nx, double ny, double nz);
+    void MeshTexCoord2f(Mesh *mesh, double s, double t);
+    void MeshVertex3f(Mesh *mesh, double x, double y, double z);
+    void MeshEnd(Mesh *mesh);
+    void MeshPart(Mesh *mesh);
+    void MeshUpload(Mesh *mesh);
+    void MeshDraw(const Mesh *mesh);
+    void MeshDrawPart(const Mesh *mesh, int part);
+    void MeshDrawRange(const Mesh *mesh, int first, int count);
+    void MeshBind(const Mesh *mesh);
+    void MeshUnbind(const Mesh *mesh);
+    void NormalMatrix(const double mat[16], double nmat[9]);
+    void MeshAppend(Mesh *mesh, const Mesh *src, int first, int count, const double mat[16], const float tex[2]);
+    Mesh *MeshCacheFind(const MeshKey *key);
+    Mesh *MeshCacheAdd(const MeshKey *key);
+
+    // Instanced drawing
+    typedef struct
+    {
+        float matrix[16]; // model matrix (column major)
+        float normal[9];  // normal matrix
+        float ambient[4]; // material ambient
+        float diffuse[4]; // material diffuse
+        float layer;      // texture layer
+        float uv[4];      // texture coordinates offset (u0, v0) and scale (du, dv)
+    } Instance;
+
+    typedef struct InstanceSet InstanceSet;
+    InstanceSet *InstanceNew(const Mesh *mesh, int first, int count);
+    void InstanceFree(InstanceSet *set);
+    void InstanceClear(InstanceSet *set);
+    void InstanceAdd(InstanceSet *set, const double matrix[16], const float ambient[4], const float diffuse[4], int layer, const float uv[4]);
+    void InstanceLayers(InstanceSet *set, const unsigned int tex[], int n);
+    void InstanceUpload(InstanceSet *set);
+    void InstanceDraw(const InstanceSet *set);
+    void InstanceStats(int *draws, int *saved, int reset);
+
+    // Frustum culling
+    typedef struct
+    {
+        float *x, *y, *z, *r; // bounding sphere centres and radii
+        int n, max;           // number of spheres and allocated size
+    } CullBounds;
+
+    void CullAdd(CullBounds *b, float x, float y, float z, float r);
+    void CullClear(CullBounds *b);
+    void CullFree(CullBounds *b);
+    int CullSpheres(const CullBounds *b, unsigned char visible[]);
+    int CullTest(const CullBounds *b, unsigned char visible[]);
+    void CullStats(int *culled, int *drawn, int reset);
+
+    // Rain
+    typedef struct
+    {
+        float xPos;
+        float zPos;
+        float collisionTime;
+    } SplashData;
+
+    // Drops as aligned separate arrays (padded to a multiple of 8)
+    typedef struct
+    {
+        float *x, *z, *speed, *length;
+        int n;
+    } RainDrops;
+
+    void RainAlloc(RainDrops *rain, int n);
+    void RainFree(RainDrops *rain);
+    int RainSplashes(const RainDrops *rain, float before, float now, float height, SplashData ring[], int size, int *next, int simd);
+    const char *RainKernel(void);
+    void RainBenchmark(void);
+
+    // GPU rain particles
+    typedef struct ParticleSystem ParticleSystem;
+    int ParticleSupported(void);
+    int ParticleShader(char *VertFile, char *FragFile);
+    ParticleSystem *ParticleNew(int max, float area, float height);
+    void ParticleFree(ParticleSystem *ps);
+    void ParticleCount(ParticleSystem *ps, int n);
+    int ParticleActive(const ParticleSystem *ps);
+    void ParticleWind(ParticleSystem *ps, float wx, float wz);
+    void ParticleCentre(ParticleSystem *ps, float x, float z);
+    void ParticleUpdate(ParticleSystem *ps, float time, float dt);
+    void ParticleDraw(const ParticleSystem *ps);
+
+    // Pixel conversion
+    void PixelBGRtoRGB(unsigned char *dst, const unsigned char *src, int n, int simd);
+    void PixelBGRtoRGBA(unsigned char *dst, const unsigned char *src, int n, int blackThreshold, int simd);
+    void PixelFlipRows(unsigned char *image, int rows, int rowBytes, int simd);
+    void PixelHalve(unsigned char *dst, const unsigned char *src, int w, int h, int bpp);
+    void PixelDXT1(unsigned char *dst, const unsigned char *rgba, int w, int h);
+    const char *PixelKernel(void);
+    void PixelBenchmark(int nfiles, char *files[]);
+
+    // Low resolution offscreen pass
+    void LowResBegin(int scale);
+    void LowResEnd(void);
+
+    // Baked scenes
+    typedef struct Scene Scene;
+
+    typedef struct
+    {
+        float ambient[4], diffuse[4];
+    } SceneMaterial;
+
+    // Copy of a scene drawn by SceneDrawCopies
+    typedef struct
+    {
+        double matrix[16];             // model matrix (column major)
+        const SceneMaterial *material; // material of each tag (NULL for recorded)
+    } SceneCopy;
+
+    Scene *SceneNew(void);
+    void SceneFree(Scene *scene);
+    void SceneMerge(Scene *scene);
+    void SceneCells(Scene *scene, double size);
+    void SceneRecord(Scene *scene);
+    void SceneFinish(Scene *scene);
+    void SceneDraw(const Scene *scene);
+    void SceneDrawCopies(Scene *scene, const SceneCopy copy[], int n);
+    int SceneRecording(void);
+    void SceneTag(int tag);
+    int SceneAddMesh(const Mesh *mesh, int first, int count);
+
+    // Immediate mode drawing that can be recorded into a scene
+    void DrawBegin(GLenum mode);
+    void DrawNormal3f(float nx, float ny, float nz);
+    void DrawTexCoord2f(float s, float t);
+    void DrawVertex3f(float x, float y, float z);
+    void DrawEnd(void);
+
     // Shapes
+    void LodFrame(void);
 
     void cube(double x, double y, double z,
               double dx, double dy, double dz,
@@ -117,8 +329,26 @@ void Fatal(const char *format, ...);
     void drawBarricade(double x, double y, double z, double rotation, unsigned int texture);
 
     // Complex Objs
+    extern int bezierRotations; // engine cover segments around
+    extern int bezierAdaptive;  // engine cover curve subdivided by curvature
+    extern int bezierDebug;     // draw the engine cover profile curve
+
     void drawF1Car(float length, float width, float breadth, unsigned int texture[], float colors[][3], float steeringAngle, int isBraking, float velocity);
 
+    // Car drawn by drawCarFleet
+    typedef struct
+    {
+        double x, y, z;    // position
+        double heading;    // direction the car faces (degrees about y)
+        double steering;   // front wheel steering angle
+        int braking;       // brake light on
+        double velocity;   // forward velocity
+        int livery;        // index into the livery table
+        double wheelAngle; // wheel spin, advanced by the velocity
+    } CarState;
+
+    void drawCarFleet(CarState car[], int n, float (*livery[])[3], int nliveries, unsigned int texture[], double scale);
+
     void drawTireBarrierRow(double startX, double y, double z, int count, double spacing);
 
     void drawF1Garage(double x, double y, double z, double scale, unsigned int texture[], float colors[][3]);
@@ -157,6 +387,52 @@ void Fatal(const char *format, ...);
     char *ReadText(char *file);
     int CreateShader(GLenum type, char *file);
     int CreateShaderProg(char *VertFile, char *FragFile);
+    void ShaderCacheStats(int *fromCache, int *fromText);
+
+    // Shader programs with their active uniforms and attributes
+#define SHADER_SLOTS 64 // hash table size (power of two)
+#define SHADER_SHARED 3 // uniforms shared by every program
+
+    // Shared uniforms, in the order of ShaderShared.value and ShaderProgram.shared
+    enum
+    {
+        SHADER_TIME,       // animation time
+        SHADER_HEIGHT,     // height rain falls from
+        SHADER_POINTSCALE, // pixels of the target per pixel of the window
+    };
+
+    typedef struct
+    {
+        unsigned int hash; // hash of the name (0 for an empty slot)
+        int location;      // location in the program
+        char name[48];     // name (without [0] for arrays)
+    } ShaderVar;
+
+    typedef struct
+    {
+        int id;                          // GL program
+        int frame;                       // frame the shared uniforms were last sent
+        int shared[SHADER_SHARED];       // locations of the shared uniforms (-1 if unused)
+        ShaderVar uniform[SHADER_SLOTS]; // active uniforms by hash of the name
+        ShaderVar attrib[SHADER_SLOTS];  // active attributes by hash of the name
+    } ShaderProgram;
+
+    // Values of the shared uniforms, set once per frame
+    typedef struct
+    {
+        float value[SHADER_SHARED]; // indexed by SHADER_TIME, SHADER_HEIGHT and SHADER_POINTSCALE
+    } ShaderShared;
+
+    ShaderProgram *ShaderReflect(int prog);
+    ShaderProgram *ShaderNew(char *VertFile, char *FragFile);
+    int ShaderUniform(const ShaderProgram *p, const char *name);
+    int ShaderAttrib(const ShaderProgram *p, const char *name);
+    void ShaderFrame(const ShaderShared *values);
+    void ShaderUse(ShaderProgram *p);
+    void ShaderSet1i(const ShaderProgram *p, const char *name, int x);
+    void ShaderSet1f(const ShaderProgram *p, const char *name, float x);
+    void ShaderSet2f(const ShaderProgram *p, const char *name, float x, float y);
+    void ShaderSet3fv(const ShaderProgram *p, const char *name, const float *v);
 
 #ifdef __cplusplus
 }
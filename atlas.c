@@ -0,0 +1,198 @@
+//  Texture atlas
+//
+//  Decals drawn on many small surfaces (sponsor boards, banners, team and
+//  car liveries) are packed side by side into one texture at load time, so
+//  a scene can draw them all with a single texture bound.  Each texture
+//  keeps its own size and is placed on a shelf: shelves are as tall as the
+//  tallest texture on them and as wide as the atlas.  Every texture is
+//  surrounded by a gutter repeating its edge pixels and starts on a
+//  multiple of the gutter, so filtering does not pick up the neighbouring
+//  texture down to the mipmap level where the gutter is one pixel.  Smaller
+//  levels would average neighbours together, so the atlas stops there.
+//  Textures set to GL_CLAMP (colour keyed decals) get a transparent gutter
+//  instead, which looks like the transparent border they were clamped to.
+//
+//  AtlasRect maps a texture to the atlas and the part of it the texture
+//  took, so texture coordinates from 0 to 1 become u0 + s * du, v0 + t * dv.
+//  Coordinates outside 0 to 1 (repeated textures) cannot be remapped and
+//  must keep drawing with the original texture, which is not deleted.
+#include "CSCIx229.h"
+
+#define ATLAS_LEVELS 4                   //  Mipmap levels after level 0
+#define ATLAS_GUTTER (1 << ATLAS_LEVELS) //  Edge pixels repeated around each texture
+
+static unsigned int atlas = 0;   //  Atlas texture
+static unsigned int *tex;        //  Textures packed into it
+static float (*rect)[4];         //  and where (u0, v0, du, dv)
+static int ntex = 0;
+
+//  A texture to place
+typedef struct
+{
+   int k;       // index into tex
+   int w, h;    // size
+   int x, y;    // corner in the atlas, gutter excluded
+} AtlasItem;
+
+//
+//  Sort tallest first
+//
+static int AtlasCompare(const void *a, const void *b)
+{
+   const AtlasItem *A = (const AtlasItem *)a;
+   const AtlasItem *B = (const AtlasItem *)b;
+   if (A->h != B->h)
+      return B->h - A->h;
+   return A->k - B->k;
+}
+
+//
+//  Place items on shelves no wider than width, returns the height used
+//     Each item goes on the first shelf with room, else on a new shelf
+//
+static int AtlasShelves(AtlasItem item[], int n, int width)
+{
+   int shelfY[64], shelfX[64], shelfH[64];
+   int nshelf = 0, height = 0;
+   qsort(item, n, sizeof(AtlasItem), AtlasCompare);
+   for (int i = 0; i < n; i++)
+   {
+      //  Whole gutters so every texture starts on a multiple of the gutter
+      int w = (item[i].w + 3 * ATLAS_GUTTER - 1) & ~(ATLAS_GUTTER - 1);
+      int h = (item[i].h + 3 * ATLAS_GUTTER - 1) & ~(ATLAS_GUTTER - 1);
+      if (w > width)
+         Fatal("Texture %d is %d wide, too wide for a %d atlas\n", tex[item[i].k], item[i].w, width);
+      int s = 0;
+      while (s < nshelf && (shelfX[s] + w > width || shelfH[s] < h))
+         s++;
+      if (s == nshelf)
+      {
+         if (nshelf == 64)
+            Fatal("Too many atlas shelves\n");
+         shelfY[s] = height;
+         shelfX[s] = 0;
+         shelfH[s] = h;
+         height += h;
+         nshelf++;
+      }
+      item[i].x = shelfX[s] + ATLAS_GUTTER;
+      item[i].y = shelfY[s] + ATLAS_GUTTER;
+      shelfX[s] += w;
+   }
+   return height;
+}
+
+//
+//  Copy a w x h RGBA image into the atlas at x,y
+//     The gutter repeats the edges, or stays transparent without edge
+//
+static void AtlasCopy(unsigned char *dst, int width, const unsigned char *src, int w, int h, int x, int y, int edge)
+{
+   int gutter = edge ? ATLAS_GUTTER : 0;
+   for (int j = -gutter; j < h + gutter; j++)
+   {
+      const unsigned char *row = src + 4 * (size_t)w * (j < 0 ? 0 : j >= h ? h - 1 : j);
+      unsigned char *out = dst + 4 * ((size_t)(y + j) * width + x);
+      for (int i = -gutter; i < 0; i++)
+         memcpy(out + 4 * i, row, 4);
+      memcpy(out, row, 4 * w);
+      for (int i = w; i < w + gutter; i++)
+         memcpy(out + 4 * i, row + 4 * (w - 1), 4);
+   }
+}
+
+/*
+ *  Pack n textures into one mipmapped RGBA atlas and return it
+ *     The textures must not be packed already.  Prints the size of the
+ *     atlas and the memory it saves over a texture array of the same
+ *     textures.
+ */
+unsigned int AtlasPack(const unsigned int textures[], int n)
+{
+   if (atlas)
+      Fatal("Textures are already packed into an atlas\n");
+   tex = (unsigned int *)malloc(n * sizeof(unsigned int));
+   rect = (float (*)[4])malloc(n * sizeof(*rect));
+   AtlasItem *item = (AtlasItem *)malloc(n * sizeof(AtlasItem));
+   if (!tex || !rect || !item)
+      Fatal("Cannot allocate atlas of %d textures\n", n);
+   memcpy(tex, textures, n * sizeof(unsigned int));
+   ntex = n;
+
+   //  Sizes of the textures
+   int maxw = 0, maxh = 0;
+   for (int k = 0; k < n; k++)
+   {
+      StateBindTexture(tex[k]);
+      item[k].k = k;
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &item[k].w);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &item[k].h);
+      if (item[k].w > maxw)
+         maxw = item[k].w;
+      if (item[k].h > maxh)
+         maxh = item[k].h;
+   }
+
+   //  Shelves as wide as the largest texture allows, up to 2048
+   int max;
+   glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max);
+   int width = max < 2048 ? max : 2048;
+   int height = AtlasShelves(item, n, width);
+   if (height > max)
+      Fatal("Atlas of %d textures is %dx%d, larger than %d\n", n, width, height, max);
+
+   //  Copy the textures into the atlas
+   unsigned char *image = (unsigned char *)calloc(4 * (size_t)width, height);
+   unsigned char *pixels = (unsigned char *)malloc(4 * (size_t)maxw * maxh);
+   if (!image || !pixels)
+      Fatal("Cannot allocate %dx%d atlas\n", width, height);
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+   for (int i = 0; i < n; i++)
+   {
+      AtlasItem *it = item + i;
+      int wrap;
+      StateBindTexture(tex[it->k]);
+      glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrap);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+      AtlasCopy(image, width, pixels, it->w, it->h, it->x, it->y, wrap != GL_CLAMP);
+      rect[it->k][0] = (float)it->x / width;
+      rect[it->k][1] = (float)it->y / height;
+      rect[it->k][2] = (float)it->w / width;
+      rect[it->k][3] = (float)it->h / height;
+   }
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+   glGenTextures(1, &atlas);
+   StateBindTexture(atlas);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ATLAS_LEVELS);
+   TexFilter(GL_TEXTURE_2D, TEX_MIPMAP);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   StateBindTexture(0);
+   ErrCheck("AtlasPack");
+
+   printf("Packed %d textures into a %dx%d atlas (%.1f MB, a texture array of them would take %.1f MB)\n",
+          n, width, height, 4.0 * width * height / (1 << 20), 4.0 * maxw * maxh * n / (1 << 20));
+   free(image);
+   free(pixels);
+   free(item);
+   return atlas;
+}
+
+/*
+ *  Atlas a texture was packed into and its place there (u0, v0, du, dv)
+ *     Returns 0 for textures that are not packed
+ */
+unsigned int AtlasRect(unsigned int texture, float uv[4])
+{
+   for (int k = 0; k < ntex; k++)
+   {
+      if (tex[k] == texture)
+      {
+         memcpy(uv, rect[k], sizeof(rect[k]));
+         return atlas;
+      }
+   }
+   return 0;
+}
@@ -10,7 +10,19 @@ double P[3][3] = {
     {-0.102, 0.0, 0.470},
     {-0.526, 0.0, 0.360}};
 
-double curve[50 + 1][3];
+// Engine cover settings
+int bezierRotations = NUM_ROTATIONS; // segments around the surface of revolution
+int bezierAdaptive = 0;              // subdivide the curve by curvature
+int bezierDebug = 0;                 // draw the profile curve
+
+#define MAX_CURVE 257            // most points on the profile curve
+#define CURVE_POINTS 50          // uniform segments on the profile curve
+#define CURVE_MAXDEPTH 8         // adaptive subdivision depth (2^8 segments)
+#define CURVE_MINDEPTH 3         // adaptive segments are at most 1/8 of the curve
+#define CURVE_MAXTURN 0.05       // tangent turn per adaptive segment (radians)
+
+double curve[MAX_CURVE][3];
+int numCurve = 0;
 
 // This function (GetBezierPoints) is AI generated I wanted to know the formula and construction of it
 // Code to get Bezier points
@@ -30,47 +42,90 @@ void GetBezierPoints(double t, double result[3])
     result[2] = b0 * P[0][2] + b1 * P[1][2] + b2 * P[2][2];
 }
 
-// draws the first curve and stores the points
+// Angle between the curve tangents at t0 and t1
+static double BezierTurn(double t0, double t1)
+{
+    // B'(t) = 2(1-t)(P1-P0) + 2t(P2-P1)
+    double d0[3], d1[3];
+    double dot = 0, len0 = 0, len1 = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        d0[k] = (1 - t0) * (P[1][k] - P[0][k]) + t0 * (P[2][k] - P[1][k]);
+        d1[k] = (1 - t1) * (P[1][k] - P[0][k]) + t1 * (P[2][k] - P[1][k]);
+        dot += d0[k] * d1[k];
+        len0 += d0[k] * d0[k];
+        len1 += d1[k] * d1[k];
+    }
+    if (len0 == 0 || len1 == 0)
+        return M_PI;
+    double c = dot / sqrt(len0 * len1);
+    return acos(c > 1 ? 1 : c < -1 ? -1 : c);
+}
+
+// Add the points after t0 up to t1, splitting where the curve bends
+static void BezierSubdivide(double t0, double t1, int depth)
+{
+    if (depth < CURVE_MAXDEPTH && (depth < CURVE_MINDEPTH || BezierTurn(t0, t1) > CURVE_MAXTURN))
+    {
+        BezierSubdivide(t0, (t0 + t1) / 2, depth + 1);
+        BezierSubdivide((t0 + t1) / 2, t1, depth + 1);
+    }
+    else
+        GetBezierPoints(t1, curve[numCurve++]);
+}
+
+// stores the points of the first curve
 void GetBezierCurve()
 {
+    numCurve = 0;
+    if (bezierAdaptive)
+    {
+        GetBezierPoints(0, curve[numCurve++]);
+        BezierSubdivide(0, 1, 0);
+        return;
+    }
     // Evaluate curve at all 50 points
-    for (int i = 0; i <= 50; i++)
+    for (int i = 0; i <= CURVE_POINTS; i++)
     {
-        double t = i / (double)50;
-        GetBezierPoints(t, curve[i]);
+        double t = i / (double)CURVE_POINTS;
+        GetBezierPoints(t, curve[numCurve++]);
     }
+}
 
-    // Draw the curve
+// Draw the curve
+void DrawBezierCurve()
+{
     glLineWidth(3);
-    glBegin(GL_LINE_STRIP);
-    for (int i = 0; i <= 50; i++)
-        glVertex3f(curve[i][0], curve[i][1], curve[i][2]);
-    glEnd();
+    DrawBegin(GL_LINE_STRIP);
+    for (int i = 0; i < numCurve; i++)
+        DrawVertex3f(curve[i][0], curve[i][1], curve[i][2]);
+    DrawEnd();
     glLineWidth(1);
 }
 
-void GetRotationObj()
+void GetRotationObj(Mesh *mesh)
 {
+    int last = numCurve - 1;
 
     // Rotate from -180 to 0 degrees
-    for (int j = 0; j < NUM_ROTATIONS; j++)
+    for (int j = 0; j < bezierRotations; j++)
     {
         // degree intervals
-        double angle1 = -180.0 + (180.0 * j / NUM_ROTATIONS);
-        double angle2 = -180.0 + (180.0 * (j + 1) / NUM_ROTATIONS);
+        double angle1 = -180.0 + (180.0 * j / bezierRotations);
+        double angle2 = -180.0 + (180.0 * (j + 1) / bezierRotations);
 
         double theta1 = angle1 * M_PI / 180.0;
         double theta2 = angle2 * M_PI / 180.0;
         // draw the quad
-        glBegin(GL_QUAD_STRIP);
-        for (int i = 0; i <= 50; i++)
+        MeshBegin(mesh, GL_QUAD_STRIP);
+        for (int i = 0; i <= last; i++)
         {
             double x = curve[i][0];
             double z = curve[i][2];
 
             // Calculate tangent to the curve
             double dx, dz;
-            if (i < 50)
+            if (i < last)
             {
                 dx = curve[i + 1][0] - curve[i][0];
                 dz = curve[i + 1][2] - curve[i][2];
@@ -123,60 +178,115 @@ void GetRotationObj()
             double y2 = -z * sin(theta2);
             double z2 = z * cos(theta2);
 
-            glNormal3f(-nx1_norm, -ny1_norm, -nz1_norm);
-            glVertex3f(x, y1, z1);
+            MeshNormal3f(mesh, -nx1_norm, -ny1_norm, -nz1_norm);
+            MeshVertex3f(mesh, x, y1, z1);
 
-            glNormal3f(-nx2, -ny2, -nz2);
-            glVertex3f(x, y2, z2);
+            MeshNormal3f(mesh, -nx2, -ny2, -nz2);
+            MeshVertex3f(mesh, x, y2, z2);
         }
-        glEnd();
+        MeshEnd(mesh);
     }
     // circular end cap at X = -0.526
-    double end_x = curve[50][0]; // x = -0.526
-    double end_z = curve[50][2]; // z = 0.360 (radius of circle)
+    double end_x = curve[last][0]; // x = -0.526
+    double end_z = curve[last][2]; // z = 0.360 (radius of circle)
 
-    glBegin(GL_TRIANGLE_FAN);
+    MeshBegin(mesh, GL_TRIANGLE_FAN);
 
     // Normal points in -X direction
-    glNormal3f(-1, 0, 0);
-    glVertex3f(end_x, 0, 0); // Center of the circle
+    MeshNormal3f(mesh, -1, 0, 0);
+    MeshVertex3f(mesh, end_x, 0, 0); // Center of the circle
 
     // Draw circle around the X-axis
-    for (int j = 0; j <= NUM_ROTATIONS; j++)
+    for (int j = 0; j <= bezierRotations; j++)
     {
-        double angle = -180.0 + (180.0 * j / NUM_ROTATIONS);
+        double angle = -180.0 + (180.0 * j / bezierRotations);
         double theta = angle * M_PI / 180.0;
 
         double y = -end_z * sin(theta);
         double z = end_z * cos(theta);
 
-        glNormal3f(-1, 0, 0);
-        glVertex3f(end_x, y, z);
+        MeshNormal3f(mesh, -1, 0, 0);
+        MeshVertex3f(mesh, end_x, y, z);
     }
-    glEnd();
+    MeshEnd(mesh);
 }
 
-void drawF1Car(float length, float width, float breadth, unsigned int texture[], float colors[][3], float steeringAngle, int isBraking, float velocity)
+// Engine cover mesh, rebuilt only when the curve or tessellation changes
+static Mesh *EngineCoverMesh()
 {
-    // colors[0] body color
-    // colors[1] fin/wing color (rear and front wings)
-    // colors[2] reinforcement bar color
-    // steeringAngle angle to rotate front wheels
-    // isBraking 1 if braking, 0 otherwise (for brake light)
+    static Mesh *mesh = NULL;
+    static double builtP[3][3];
+    static int builtRotations, builtAdaptive;
 
-    // Scaling factors
-    float scaleX = length;
-    float scaleY = breadth;
-    float scaleZ = width;
+    if (mesh && !memcmp(builtP, P, sizeof(P)) &&
+        builtRotations == bezierRotations && builtAdaptive == bezierAdaptive)
+        return mesh;
 
-    glPushMatrix();
-    glTranslated(0, 0.65 * scaleY, 0);
-    glScalef(scaleX, scaleY, scaleZ);
+    // The old mesh is not freed since baked scenes may still draw it
+    mesh = MeshNew();
+    GetBezierCurve();
+    GetRotationObj(mesh);
+    MeshUpload(mesh);
+
+    memcpy(builtP, P, sizeof(P));
+    builtRotations = bezierRotations;
+    builtAdaptive = bezierAdaptive;
+    return mesh;
+}
+
+// Car parts coloured by the livery
+enum
+{
+    CAR_FIXED, // same material for every livery
+    CAR_BODY,  // colors[0]
+    CAR_WING,  // colors[1]
+    CAR_BAR,   // colors[2]
+    CAR_ROLES
+};
+
+// Ambient and diffuse colour of a car part in a livery
+static void CarLivery(int role, float colors[][3], SceneMaterial *mat)
+{
+    const float *c = colors[role - 1];
+    for (int k = 0; k < 3; k++)
+    {
+        if (role == CAR_BODY)
+        {
+            mat->ambient[k] = c[k];
+            mat->diffuse[k] = c[k] * 1.3;
+        }
+        else if (role == CAR_WING)
+        {
+            mat->ambient[k] = 1.0;
+            mat->diffuse[k] = c[k] * 1.2;
+        }
+        else
+        {
+            mat->ambient[k] = c[k];
+            mat->diffuse[k] = c[k] * 1.4;
+        }
+    }
+    mat->ambient[3] = mat->diffuse[3] = 1.0;
+}
 
+// Set the material of a car part, tagged so baked cars can change livery
+static void SetCarMaterial(int role, float colors[][3])
+{
+    static const float specular[CAR_ROLES] = {0, 1.0, 0.8, 1.2};
+    static const float shininess[CAR_ROLES] = {0, 100, 80, 120};
+    SceneMaterial mat;
+    CarLivery(role, colors, &mat);
+    SetMaterial(mat.ambient[0], mat.ambient[1], mat.ambient[2],
+                mat.diffuse[0], mat.diffuse[1], mat.diffuse[2],
+                specular[role], specular[role], specular[role], shininess[role]);
+    SceneTag(role);
+}
+
+// Static parts of the car: everything but the wheels and brake light
+static void F1CarBody(unsigned int texture[], float colors[][3])
+{
     // Base metal body - using body color
-    SetMaterial(colors[0][0], colors[0][1], colors[0][2],
-                colors[0][0] * 1.3, colors[0][1] * 1.3, colors[0][2] * 1.3,
-                1.0, 1.0, 1.0, 100);
+    SetCarMaterial(CAR_BODY, colors);
 
     // First trapezoid aligned along X, base on ground
     glPushMatrix();
@@ -226,10 +336,8 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
     // Rear cube section
     glPushMatrix();
     glTranslated(-2.25, 0, 0);
-    glDisable(GL_TEXTURE_2D);
-    SetMaterial(colors[0][0], colors[0][1], colors[0][2],
-                colors[0][0] * 1.3, colors[0][1] * 1.3, colors[0][2] * 1.3,
-                1.0, 1.0, 1.0, 100);
+    StateDisable(GL_TEXTURE_2D);
+    SetCarMaterial(CAR_BODY, colors);
     // pass 1 for normal shape
     cube(0, 0, 0,
          0.75, 0.35, 1,
@@ -238,13 +346,13 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
          1,
          1);
     // pass 2 for transparent texture
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glBindTexture(GL_TEXTURE_2D, texture[12]);
+    StateEnable(GL_TEXTURE_2D);
+    StateEnable(GL_BLEND);
+    StateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    StateBindTexture(texture[12]);
 
-    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
-    glEnable(GL_POLYGON_OFFSET_FILL);
+    StateTexEnv(GL_DECAL);
+    StateEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(-1.0, -1.0);
 
     cube(0, 0, 0,
@@ -254,10 +362,10 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
          1,
          1);
 
-    glDisable(GL_POLYGON_OFFSET_FILL);
-    glDisable(GL_BLEND);
-    glDisable(GL_TEXTURE_2D);
-    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    StateDisable(GL_POLYGON_OFFSET_FILL);
+    StateDisable(GL_BLEND);
+    StateDisable(GL_TEXTURE_2D);
+    StateTexEnv(GL_MODULATE);
     glPopMatrix();
 
     // Rear connection trapezoid
@@ -280,9 +388,7 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
     glPopMatrix();
 
     // Rear wing and fin
-    SetMaterial(1.0, 1.0, 1.0,
-                colors[1][0] * 1.2, colors[1][1] * 1.2, colors[1][2] * 1.2,
-                0.8, 0.8, 0.8, 80);
+    SetCarMaterial(CAR_WING, colors);
 
     rectangleTex(-4.4, 1.06, 0, 0.45, 1.6, -90, 0, 0, texture[9], 1); // back fin
     rectangleTex(-4.4, 1.11, 0.8, 0.45, 0.1, 0, 0, 0, texture[9], 1);
@@ -292,39 +398,13 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
     rectangleTex(-4.4, 0.85, -0.6, 0.45, 0.62, -45, 0, 0, texture[9], 1);
     rectangleTex(-4.4, 0.85, 0.6, 0.45, 0.62, 45, 0, 0, texture[9], 1);
 
-    // rear light
-    if (isBraking)
-    {
-        // red glowing brake lights when braking
-        SetMaterial(1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.3, 0.3, 50);
-        glDisable(GL_LIGHTING);
-        glColor3f(1.0, 0.0, 0.0);
-    }
-    else
-    {
-        // Dim red when not braking
-        SetMaterial(0.3, 0.0, 0.0, 0.3, 0.0, 0.0, 0.1, 0.0, 0.0, 10);
-    }
-
-    // brake light
-    glPushMatrix();
-    glTranslated(-4.65, 0.5, 0);
-    noTexCube(0, 0, 0, 0.08, 0.15, 0.1, 0);
-    glPopMatrix();
-
-    if (isBraking)
-    {
-        glEnable(GL_LIGHTING); // Reenable lighting
-    }
-
     // front wings
-    SetMaterial(1.0, 1.0, 1.0,
-                colors[1][0] * 1.2, colors[1][1] * 1.2, colors[1][2] * 1.2,
-                0.8, 0.8, 0.8, 80);
+    SetCarMaterial(CAR_WING, colors);
     rectangleTex(2.4, -0.15, 0.6, 0.45, 1.5, -90, 0, -18, texture[9], 1);
     rectangleTex(2.4, -0.15, -0.6, 0.45, 1.5, -90, 0, 18, texture[9], 1);
 
     // Suspension
+    SceneTag(CAR_FIXED);
     SetMaterial(0.25, 0.25, 0.28, 0.4, 0.4, 0.43, 1.0, 1.0, 1.0, 100);
 
     // Front left suspension
@@ -346,47 +426,14 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
 
     cylinder(-2.2, 1.06, 0, 0.02, 0.2, 8, 90, 0, 0, 0, 0, 0);
 
-    // Wheels
-    // Black for tires
-
-    if (!isBraking && fabs(velocity) > 0.01f)
-    {
-        carRotateAngle = (carRotateAngle - 10) % 360;
-    }
-
-    if (isBraking && fabs(velocity) > 0.01f)
-    {
-        carRotateAngle = (carRotateAngle + 3) % 360;
-    }
-
-    SetMaterial(1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.1, 0.1, 0.1, 5);
-
-    // Front wheels with steering rotation
-    glPushMatrix();
-    glRotated(-steeringAngle * 0.4, 0, 1, 0); // Rotate around Y axis for steering
-    cylinderTex(1, 0, -1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
-    glPopMatrix();
-
-    glPushMatrix();
-    glRotated(-steeringAngle * 0.4, 0, 1, 0); // Rotate around Y axis for steering
-    cylinderTex(1, 0, 1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
-    glPopMatrix();
-
-    // Rear wheels
-    cylinderTex(-4, 0, -1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
-    cylinderTex(-4, 0, 1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
-
     // cockpit bezier and halo
-    SetMaterial(colors[0][0], colors[0][1], colors[0][2],
-                colors[0][0] * 1.3, colors[0][1] * 1.3, colors[0][2] * 1.3,
-                1.0, 1.0, 1.0, 100);
+    SetCarMaterial(CAR_BODY, colors);
 
     glPushMatrix();
     glTranslated(-3.7, 0.15, 0);
     glRotatef(180, 0, 1, 0);
     glScalef(3, 2.2, 1);
-    GetBezierCurve();
-    GetRotationObj();
+    MeshDraw(EngineCoverMesh());
     glPopMatrix();
 
     // Front cockpit trapezoid
@@ -402,9 +449,7 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
     glPopMatrix();
 
     // Halo reinforcement bars
-    SetMaterial(colors[2][0], colors[2][1], colors[2][2],
-                colors[2][0] * 1.4, colors[2][1] * 1.4, colors[2][2] * 1.4,
-                1.2, 1.2, 1.2, 120);
+    SetCarMaterial(CAR_BAR, colors);
 
     glPushMatrix();
     glTranslated(-1.8, 0.8, 0);
@@ -416,34 +461,370 @@ void drawF1Car(float length, float width, float breadth, unsigned int texture[],
 
     // Top horizontal bar
     cylinder(-1.15, 0.36, 0, 0.04, 0.8, 4, 0, 0, 10, 0, 0, 0);
+    SceneTag(CAR_FIXED);
+}
+
+// Brake light, glowing when braking
+static void F1CarBrakeLight(int isBraking)
+{
+    if (isBraking)
+    {
+        // Emissive red so it glows the same whatever the lighting
+        float glow[] = {1.0, 0.0, 0.0, 1.0};
+        SetMaterial(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 10);
+        StateMaterialfv(GL_EMISSION, glow);
+    }
+    else
+    {
+        // Dim red when not braking
+        SetMaterial(0.3, 0.0, 0.0, 0.3, 0.0, 0.0, 0.1, 0.0, 0.0, 10);
+    }
+
+    glPushMatrix();
+    glTranslated(-4.65, 0.5, 0);
+    noTexCube(0, 0, 0, 0.08, 0.15, 0.1, 0);
+    glPopMatrix();
+}
+
+// Wheel at the origin with its axis along y
+static void F1CarWheel(unsigned int texture[])
+{
+    SetMaterial(1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.1, 0.1, 0.1, 5);
+    cylinderTex(0, 0, 0, 0.6, 0.6, 20, 0, 0, 0, 1, texture, 10, 11);
+}
+
+// Wheels spun by carRotateAngle, front wheels steered
+static void F1CarWheels(unsigned int texture[], float steeringAngle)
+{
+    SetMaterial(1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.1, 0.1, 0.1, 5);
+
+    // Front wheels with steering rotation
+    glPushMatrix();
+    glRotated(-steeringAngle * 0.4, 0, 1, 0); // Rotate around Y axis for steering
+    cylinderTex(1, 0, -1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
+    cylinderTex(1, 0, 1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
+    glPopMatrix();
+
+    // Rear wheels
+    cylinderTex(-4, 0, -1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
+    cylinderTex(-4, 0, 1.35, 0.6, 0.6, 20, 90, carRotateAngle, 0, 1, texture, 10, 11);
+}
+
+// Car body baked for one livery
+typedef struct
+{
+    float (*colors)[3];    // livery colours
+    unsigned int *texture; // textures
+    const Mesh *cover;     // engine cover the body was baked with
+    Scene *body;
+} CarBody;
+
+#define MAX_CAR_BODIES 16
+
+static CarBody carBody[MAX_CAR_BODIES];
+static int numCarBodies = 0;
+
+// Body scene for a livery, baked on first use and again if the engine cover changes
+static Scene *F1CarBodyScene(unsigned int texture[], float colors[][3])
+{
+    const Mesh *cover = EngineCoverMesh();
+    CarBody *car = NULL;
+    for (int k = 0; k < numCarBodies && !car; k++)
+        if (carBody[k].colors == colors && carBody[k].texture == texture)
+            car = carBody + k;
+    if (car && car->cover == cover)
+        return car->body;
+    if (!car)
+    {
+        if (numCarBodies == MAX_CAR_BODIES)
+            Fatal("Too many car liveries\n");
+        car = carBody + numCarBodies++;
+        car->colors = colors;
+        car->texture = texture;
+        car->body = NULL;
+    }
+    SceneFree(car->body);
+    car->body = SceneNew();
+    car->cover = cover;
+
+    // Record in car coordinates
+    glPushMatrix();
+    glLoadIdentity();
+    SceneRecord(car->body);
+    F1CarBody(texture, colors);
+    SceneFinish(car->body);
+    glPopMatrix();
+    return car->body;
+}
+
+void drawF1Car(float length, float width, float breadth, unsigned int texture[], float colors[][3], float steeringAngle, int isBraking, float velocity)
+{
+    // colors[0] body color
+    // colors[1] fin/wing color (rear and front wings)
+    // colors[2] reinforcement bar color
+    // steeringAngle angle to rotate front wheels
+    // isBraking 1 if braking, 0 otherwise (for brake light)
+
+    // Scaling factors
+    float scaleX = length;
+    float scaleY = breadth;
+    float scaleZ = width;
+
+    glPushMatrix();
+    glTranslated(0, 0.65 * scaleY, 0);
+    glScalef(scaleX, scaleY, scaleZ);
+
+    // Wheel spin
+    if (!isBraking && fabs(velocity) > 0.01f)
+    {
+        carRotateAngle = (carRotateAngle - 10) % 360;
+    }
+
+    if (isBraking && fabs(velocity) > 0.01f)
+    {
+        carRotateAngle = (carRotateAngle + 3) % 360;
+    }
+
+    // Animated parts are posed every frame
+    F1CarBrakeLight(isBraking);
+    F1CarWheels(texture, steeringAngle);
+
+    // The static body is drawn from its baked scene, or
+    // drawn directly when it is part of a scene being recorded
+    if (SceneRecording())
+        F1CarBody(texture, colors);
+    else
+        SceneDraw(F1CarBodyScene(texture, colors));
+
+    if (bezierDebug)
+    {
+        glPushMatrix();
+        glTranslated(-3.7, 0.15, 0);
+        glRotatef(180, 0, 1, 0);
+        glScalef(3, 2.2, 1);
+        DrawBezierCurve();
+        glPopMatrix();
+    }
 
     glPopMatrix(); // End scaling transformation
 }
 
+// Fleet scenes: body, wheel and brake light off and on
+static Scene *fleetBody = NULL;
+static Scene *fleetWheel = NULL;
+static Scene *fleetLight[2] = {NULL, NULL};
+static unsigned int *fleetTexture = NULL; // textures the fleet was baked with
+static const Mesh *fleetCover = NULL;     // engine cover the fleet was baked with
+
+// Copies drawn this frame
+static SceneCopy *bodyCopy = NULL, *wheelCopy = NULL, *lightCopy[2] = {NULL, NULL};
+static int maxCopies = 0;
+
+#define MAX_LIVERIES 32
+
+// Bounding sphere of a car in car coordinates
+#define CAR_X -1.0
+#define CAR_Y 0.3
+#define CAR_R 4.4
+
+static CullBounds carBounds = {0};    // bounding spheres of the cars
+static unsigned char *carVisible = NULL;
+
+// Record a fleet scene in car coordinates
+static Scene *FleetRecord(Scene *scene)
+{
+    SceneFree(scene);
+    scene = SceneNew();
+    SceneMerge(scene);
+    SceneRecord(scene);
+    return scene;
+}
+
+// Bake the parts shared by every car of the fleet
+static void FleetBake(unsigned int texture[], float colors[][3])
+{
+    glPushMatrix();
+    glLoadIdentity();
+
+    fleetBody = FleetRecord(fleetBody);
+    F1CarBody(texture, colors);
+    SceneFinish(fleetBody);
+
+    fleetWheel = FleetRecord(fleetWheel);
+    F1CarWheel(texture);
+    SceneFinish(fleetWheel);
+
+    for (int k = 0; k < 2; k++)
+    {
+        fleetLight[k] = FleetRecord(fleetLight[k]);
+        F1CarBrakeLight(k);
+        SceneFinish(fleetLight[k]);
+    }
+
+    glPopMatrix();
+    fleetTexture = texture;
+    fleetCover = EngineCoverMesh();
+}
+
+// Column major matrix operations applied on the right like glTranslated etc.
+static void MatTranslate(double m[16], double x, double y, double z)
+{
+    for (int k = 0; k < 4; k++)
+        m[12 + k] += x * m[k] + y * m[4 + k] + z * m[8 + k];
+}
+
+static void MatRotate(double m[16], double th, int axis)
+{
+    // Rotate th degrees about x (0), y (1) or z (2)
+    int a = 4 * ((axis + 1) % 3), b = 4 * ((axis + 2) % 3);
+    double c = Cos(th), s = Sin(th);
+    for (int k = 0; k < 4; k++)
+    {
+        double ma = m[a + k], mb = m[b + k];
+        m[a + k] = c * ma + s * mb;
+        m[b + k] = c * mb - s * ma;
+    }
+}
+
+static void MatScale(double m[16], double s)
+{
+    for (int k = 0; k < 12; k++)
+        m[k] *= s;
+}
+
+/*
+ *  Draw a fleet of cars
+ *     Each part of the car (body batches, wheels, brake lights) is drawn
+ *     for the whole fleet at once with instancing.  Liveries give the
+ *     body, wing and bar colours, car[k].livery indexes them.  Cars outside
+ *     the view are skipped.
+ */
+void drawCarFleet(CarState car[], int n, float (*livery[])[3], int nliveries, unsigned int texture[], double scale)
+{
+    // Wheels spin with the velocity
+    for (int k = 0; k < n; k++)
+    {
+        if (fabs(car[k].velocity) > 0.01f)
+            car[k].wheelAngle = fmod(car[k].wheelAngle + (car[k].braking ? 3 : -10), 360);
+    }
+
+    // Cars in a scene being recorded are drawn one by one
+    if (SceneRecording())
+    {
+        for (int k = 0; k < n; k++)
+        {
+            glPushMatrix();
+            glTranslated(car[k].x, car[k].y, car[k].z);
+            glRotated(car[k].heading, 0, 1, 0);
+            glScaled(scale, scale, scale);
+            drawF1Car(1, 1, 1, texture, livery[car[k].livery], car[k].steering, car[k].braking, 0);
+            glPopMatrix();
+        }
+        return;
+    }
+
+    if (texture != fleetTexture || EngineCoverMesh() != fleetCover)
+        FleetBake(texture, livery[0]);
+
+    // Material of each part in each livery
+    static SceneMaterial material[MAX_LIVERIES][CAR_ROLES];
+    if (nliveries > MAX_LIVERIES)
+        Fatal("Too many liveries %d\n", nliveries);
+    for (int i = 0; i < nliveries; i++)
+        for (int role = CAR_BODY; role < CAR_ROLES; role++)
+            CarLivery(role, livery[i], &material[i][role]);
+
+    if (n > maxCopies)
+    {
+        maxCopies = n;
+        bodyCopy = (SceneCopy *)realloc(bodyCopy, n * sizeof(SceneCopy));
+        wheelCopy = (SceneCopy *)realloc(wheelCopy, 4 * n * sizeof(SceneCopy));
+        lightCopy[0] = (SceneCopy *)realloc(lightCopy[0], n * sizeof(SceneCopy));
+        lightCopy[1] = (SceneCopy *)realloc(lightCopy[1], n * sizeof(SceneCopy));
+        carVisible = (unsigned char *)realloc(carVisible, n);
+        if (!bodyCopy || !wheelCopy || !lightCopy[0] || !lightCopy[1] || !carVisible)
+            Fatal("Cannot allocate %d cars\n", n);
+    }
+
+    // Cars in view
+    CullClear(&carBounds);
+    for (int k = 0; k < n; k++)
+    {
+        double x = CAR_X * Cos(car[k].heading);
+        double z = -CAR_X * Sin(car[k].heading);
+        CullAdd(&carBounds, car[k].x + scale * x, car[k].y + scale * (0.65 + CAR_Y), car[k].z + scale * z, scale * CAR_R);
+    }
+    CullTest(&carBounds, carVisible);
+
+    // Pose the parts of every car in view
+    static const double wheelX[4] = {1, 1, -4, -4};
+    static const double wheelZ[4] = {-1.35, 1.35, -1.35, 1.35};
+    int nbody = 0, nlight[2] = {0, 0};
+    for (int k = 0; k < n; k++)
+    {
+        if (car[k].livery < 0 || car[k].livery >= nliveries)
+            Fatal("Car %d has unknown livery %d\n", k, car[k].livery);
+        if (!carVisible[k])
+            continue;
+
+        // Car coordinates as in drawF1Car
+        SceneCopy *body = bodyCopy + nbody;
+        double *m = body->matrix;
+        memset(m, 0, sizeof(body->matrix));
+        m[0] = m[5] = m[10] = m[15] = 1;
+        MatTranslate(m, car[k].x, car[k].y, car[k].z);
+        MatRotate(m, car[k].heading, 1);
+        MatScale(m, scale);
+        MatTranslate(m, 0, 0.65, 0);
+        body->material = material[car[k].livery];
+
+        int on = car[k].braking != 0;
+        lightCopy[on][nlight[on]++] = *body;
+
+        for (int w = 0; w < 4; w++)
+        {
+            SceneCopy *wheel = wheelCopy + 4 * nbody + w;
+            *wheel = *body;
+            // Front wheels steer
+            if (w < 2)
+                MatRotate(wheel->matrix, -car[k].steering * 0.4, 1);
+            MatTranslate(wheel->matrix, wheelX[w], 0, wheelZ[w]);
+            MatRotate(wheel->matrix, 90, 0);
+            MatRotate(wheel->matrix, car[k].wheelAngle, 1);
+        }
+        nbody++;
+    }
+
+    SceneDrawCopies(fleetLight[0], lightCopy[0], nlight[0]);
+    SceneDrawCopies(fleetLight[1], lightCopy[1], nlight[1]);
+    SceneDrawCopies(fleetWheel, wheelCopy, 4 * nbody);
+    SceneDrawCopies(fleetBody, bodyCopy, nbody);
+}
+
 void squareBracketMarking()
 {
     // Square bracket like marking
     SetMaterial(1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 0.3, 0.3, 0.3, 30);
     glPushMatrix();
     glScaled(0.3, 0.3, 0.3);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
     // top left small line
-    glVertex3f(5.2, 0.01, 2.5);
-    glVertex3f(4.4, 0.01, 2.5);
-    glVertex3f(4.4, 0.01, 2);
-    glVertex3f(5.2, 0.01, 2);
+    DrawVertex3f(5.2, 0.01, 2.5);
+    DrawVertex3f(4.4, 0.01, 2.5);
+    DrawVertex3f(4.4, 0.01, 2);
+    DrawVertex3f(5.2, 0.01, 2);
     // top right small line
-    glVertex3f(5.2, 0.01, -2.5);
-    glVertex3f(4.4, 0.01, -2.5);
-    glVertex3f(4.4, 0.01, -2);
-    glVertex3f(5.2, 0.01, -2);
+    DrawVertex3f(5.2, 0.01, -2.5);
+    DrawVertex3f(4.4, 0.01, -2.5);
+    DrawVertex3f(4.4, 0.01, -2);
+    DrawVertex3f(5.2, 0.01, -2);
     // Yellow line top
-    glVertex3f(5, 0.01, -2.5);
-    glVertex3f(5.2, 0.01, -2.5);
-    glVertex3f(5.2, 0.01, 2.5);
-    glVertex3f(5, 0.01, 2.5);
-    glEnd();
+    DrawVertex3f(5, 0.01, -2.5);
+    DrawVertex3f(5.2, 0.01, -2.5);
+    DrawVertex3f(5.2, 0.01, 2.5);
+    DrawVertex3f(5, 0.01, 2.5);
+    DrawEnd();
     glPopMatrix();
 }
 
@@ -459,100 +840,100 @@ void drawF1Garage(double x, double y, double z, double scale, unsigned int textu
     glPushMatrix();
     glTranslated(-2, 0.01, 12);
     glRotatef(180, 0, 1, 0);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
     // top left small line
-    glVertex3f(5.2, 0.01, 2.5);
-    glVertex3f(4.8, 0.01, 2.5);
-    glVertex3f(4.8, 0.01, 2);
-    glVertex3f(5.2, 0.01, 2);
+    DrawVertex3f(5.2, 0.01, 2.5);
+    DrawVertex3f(4.8, 0.01, 2.5);
+    DrawVertex3f(4.8, 0.01, 2);
+    DrawVertex3f(5.2, 0.01, 2);
     // top right small line
-    glVertex3f(5.2, 0.01, -2.5);
-    glVertex3f(4.8, 0.01, -2.5);
-    glVertex3f(4.8, 0.01, -2);
-    glVertex3f(5.2, 0.01, -2);
+    DrawVertex3f(5.2, 0.01, -2.5);
+    DrawVertex3f(4.8, 0.01, -2.5);
+    DrawVertex3f(4.8, 0.01, -2);
+    DrawVertex3f(5.2, 0.01, -2);
     // Yellow line top
-    glVertex3f(5, 0.01, -2.5);
-    glVertex3f(5.2, 0.01, -2.5);
-    glVertex3f(5.2, 0.01, 2.5);
-    glVertex3f(5, 0.01, 2.5);
-    glEnd();
+    DrawVertex3f(5, 0.01, -2.5);
+    DrawVertex3f(5.2, 0.01, -2.5);
+    DrawVertex3f(5.2, 0.01, 2.5);
+    DrawVertex3f(5, 0.01, 2.5);
+    DrawEnd();
     glPopMatrix();
 
     // Garage dimensions - 16 units wide, 12 units deep, 6 units tall
 
     // Floor
     SetMaterial(0.15, 0.15, 0.15, 0.3, 0.3, 0.3, 0.1, 0.1, 0.1, 10);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[1]); // Concrete texture
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glTexCoord2f(0, 0);
-    glVertex3f(-8, 0, -6);
-    glTexCoord2f(8, 0);
-    glVertex3f(8, 0, -6);
-    glTexCoord2f(8, 6);
-    glVertex3f(8, 0, 6);
-    glTexCoord2f(0, 6);
-    glVertex3f(-8, 0, 6);
-    glEnd();
-    glDisable(GL_TEXTURE_2D);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[1]); // Concrete texture
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-8, 0, -6);
+    DrawTexCoord2f(8, 0);
+    DrawVertex3f(8, 0, -6);
+    DrawTexCoord2f(8, 6);
+    DrawVertex3f(8, 0, 6);
+    DrawTexCoord2f(0, 6);
+    DrawVertex3f(-8, 0, 6);
+    DrawEnd();
+    StateDisable(GL_TEXTURE_2D);
 
     // back wall
     SetMaterial(0.2, 0.2, 0.22, 0.4, 0.4, 0.45, 0.1, 0.1, 0.1, 10);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[1]);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 0, 1);
-    glTexCoord2f(0, 0);
-    glVertex3f(-8, 0, -6);
-    glTexCoord2f(8, 0);
-    glVertex3f(8, 0, -6);
-    glTexCoord2f(8, 3);
-    glVertex3f(8, 6, -6);
-    glTexCoord2f(0, 3);
-    glVertex3f(-8, 6, -6);
-    glEnd();
-    glDisable(GL_TEXTURE_2D);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[1]);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 0, 1);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-8, 0, -6);
+    DrawTexCoord2f(8, 0);
+    DrawVertex3f(8, 0, -6);
+    DrawTexCoord2f(8, 3);
+    DrawVertex3f(8, 6, -6);
+    DrawTexCoord2f(0, 3);
+    DrawVertex3f(-8, 6, -6);
+    DrawEnd();
+    StateDisable(GL_TEXTURE_2D);
 
     // side walls
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[1]);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[1]);
     // Left wall
-    glBegin(GL_QUADS);
-    glNormal3f(1, 0, 0);
-    glTexCoord2f(0, 0);
-    glVertex3f(-8, 0, -6);
-    glTexCoord2f(6, 0);
-    glVertex3f(-8, 0, 6);
-    glTexCoord2f(6, 3);
-    glVertex3f(-8, 6, 6);
-    glTexCoord2f(0, 3);
-    glVertex3f(-8, 6, -6);
-    glEnd();
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(1, 0, 0);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-8, 0, -6);
+    DrawTexCoord2f(6, 0);
+    DrawVertex3f(-8, 0, 6);
+    DrawTexCoord2f(6, 3);
+    DrawVertex3f(-8, 6, 6);
+    DrawTexCoord2f(0, 3);
+    DrawVertex3f(-8, 6, -6);
+    DrawEnd();
     // right wall
-    glBegin(GL_QUADS);
-    glNormal3f(-1, 0, 0);
-    glTexCoord2f(0, 0);
-    glVertex3f(8, 0, 6);
-    glTexCoord2f(6, 0);
-    glVertex3f(8, 0, -6);
-    glTexCoord2f(6, 3);
-    glVertex3f(8, 6, -6);
-    glTexCoord2f(0, 3);
-    glVertex3f(8, 6, 6);
-    glEnd();
-    glDisable(GL_TEXTURE_2D);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(-1, 0, 0);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(8, 0, 6);
+    DrawTexCoord2f(6, 0);
+    DrawVertex3f(8, 0, -6);
+    DrawTexCoord2f(6, 3);
+    DrawVertex3f(8, 6, -6);
+    DrawTexCoord2f(0, 3);
+    DrawVertex3f(8, 6, 6);
+    DrawEnd();
+    StateDisable(GL_TEXTURE_2D);
 
     // ceiling
     SetMaterial(0.25, 0.25, 0.25, 0.5, 0.5, 0.5, 0.2, 0.2, 0.2, 20);
-    glBegin(GL_QUADS);
-    glNormal3f(0, -1, 0);
-    glVertex3f(-8, 6, -6);
-    glVertex3f(8, 6, -6);
-    glVertex3f(8, 6, 6);
-    glVertex3f(-8, 6, 6);
-    glEnd();
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, -1, 0);
+    DrawVertex3f(-8, 6, -6);
+    DrawVertex3f(8, 6, -6);
+    DrawVertex3f(8, 6, 6);
+    DrawVertex3f(-8, 6, 6);
+    DrawEnd();
 
     // Banner
     glPushMatrix();
@@ -570,13 +951,13 @@ void drawF1Garage(double x, double y, double z, double scale, unsigned int textu
         {
             double lx = -4 + i * 4;
             double lz = -2 + j * 4;
-            glBegin(GL_QUADS);
-            glNormal3f(0, -1, 0);
-            glVertex3f(lx - 0.9, 5.95, lz - 0.6);
-            glVertex3f(lx + 0.9, 5.95, lz - 0.6);
-            glVertex3f(lx + 0.9, 5.95, lz + 0.6);
-            glVertex3f(lx - 0.9, 5.95, lz + 0.6);
-            glEnd();
+            DrawBegin(GL_QUADS);
+            DrawNormal3f(0, -1, 0);
+            DrawVertex3f(lx - 0.9, 5.95, lz - 0.6);
+            DrawVertex3f(lx + 0.9, 5.95, lz - 0.6);
+            DrawVertex3f(lx + 0.9, 5.95, lz + 0.6);
+            DrawVertex3f(lx - 0.9, 5.95, lz + 0.6);
+            DrawEnd();
         }
     }
 
@@ -741,19 +1122,19 @@ void drawF1Garage(double x, double y, double z, double scale, unsigned int textu
 
     // Safety yellow lines on garage floor
     SetMaterial(1.0, 1.0, 0.1, 1.0, 1.0, 0.2, 0.3, 0.3, 0.3, 30);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
     // Yellow line left
-    glVertex3f(3, 0.01, -5);
-    glVertex3f(3.2, 0.01, -5);
-    glVertex3f(3.2, 0.01, 5);
-    glVertex3f(3, 0.01, 5);
+    DrawVertex3f(3, 0.01, -5);
+    DrawVertex3f(3.2, 0.01, -5);
+    DrawVertex3f(3.2, 0.01, 5);
+    DrawVertex3f(3, 0.01, 5);
     // Yellow line right
-    glVertex3f(-3, 0.01, -5);
-    glVertex3f(-3.2, 0.01, -5);
-    glVertex3f(-3.2, 0.01, 5);
-    glVertex3f(-3, 0.01, 5);
-    glEnd();
+    DrawVertex3f(-3, 0.01, -5);
+    DrawVertex3f(-3.2, 0.01, -5);
+    DrawVertex3f(-3.2, 0.01, 5);
+    DrawVertex3f(-3, 0.01, 5);
+    DrawEnd();
 
     // THE F1 CAR
     glPushMatrix();
@@ -823,22 +1204,22 @@ void drawRoadBlockWithCurbs(double x, double y, double z, double width, double l
     SetMaterial(0.4, 0.4, 0.4, 0.7, 0.7, 0.7, 0.2, 0.2, 0.2, 10);
     glColor3f(1.0, 1.0, 1.0);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[0]); // Asphalt texture
-
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glTexCoord2f(0, 0);
-    glVertex3f(-width / 2, 0, -length / 2);
-    glTexCoord2f(width * 2, 0);
-    glVertex3f(width / 2, 0, -length / 2);
-    glTexCoord2f(width * 2, length * 2);
-    glVertex3f(width / 2, 0, length / 2);
-    glTexCoord2f(0, length * 2);
-    glVertex3f(-width / 2, 0, length / 2);
-    glEnd();
-
-    glDisable(GL_TEXTURE_2D);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[0]); // Asphalt texture
+
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-width / 2, 0, -length / 2);
+    DrawTexCoord2f(width * 2, 0);
+    DrawVertex3f(width / 2, 0, -length / 2);
+    DrawTexCoord2f(width * 2, length * 2);
+    DrawVertex3f(width / 2, 0, length / 2);
+    DrawTexCoord2f(0, length * 2);
+    DrawVertex3f(-width / 2, 0, length / 2);
+    DrawEnd();
+
+    StateDisable(GL_TEXTURE_2D);
     glColor3f(1.0, 1.0, 1.0);
     SetMaterial(0.8, 0.8, 0.8, 0.9, 0.9, 0.9, 0.5, 0.5, 0.5, 50);
 
@@ -880,28 +1261,28 @@ void drawRoadBlockRightTurn(double x, double y, double z, double innerRadius, do
     SetMaterial(0.4, 0.4, 0.4, 0.7, 0.7, 0.7, 0.2, 0.2, 0.2, 10);
     glColor3f(1.0, 1.0, 1.0);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[0]);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[0]);
 
     for (int i = 0; i < segments; i++)
     {
         double angle1 = i * angleStep * M_PI / 180.0;
         double angle2 = (i + 1) * angleStep * M_PI / 180.0;
 
-        glBegin(GL_QUADS);
-        glNormal3f(0, 1, 0);
-        glTexCoord2f(0, (float)i / segments);
-        glVertex3f(innerRadius * cos(angle1), 0, innerRadius * sin(angle1));
-        glTexCoord2f(1, (float)i / segments);
-        glVertex3f(outerRadius * cos(angle1), 0, outerRadius * sin(angle1));
-        glTexCoord2f(1, (float)(i + 1) / segments);
-        glVertex3f(outerRadius * cos(angle2), 0, outerRadius * sin(angle2));
-        glTexCoord2f(0, (float)(i + 1) / segments);
-        glVertex3f(innerRadius * cos(angle2), 0, innerRadius * sin(angle2));
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 1, 0);
+        DrawTexCoord2f(0, (float)i / segments);
+        DrawVertex3f(innerRadius * cos(angle1), 0, innerRadius * sin(angle1));
+        DrawTexCoord2f(1, (float)i / segments);
+        DrawVertex3f(outerRadius * cos(angle1), 0, outerRadius * sin(angle1));
+        DrawTexCoord2f(1, (float)(i + 1) / segments);
+        DrawVertex3f(outerRadius * cos(angle2), 0, outerRadius * sin(angle2));
+        DrawTexCoord2f(0, (float)(i + 1) / segments);
+        DrawVertex3f(innerRadius * cos(angle2), 0, innerRadius * sin(angle2));
+        DrawEnd();
     }
 
-    glDisable(GL_TEXTURE_2D);
+    StateDisable(GL_TEXTURE_2D);
 
     // Curb parameters
     double curbWidth = 0.2;
@@ -928,22 +1309,22 @@ void drawRoadBlockRightTurn(double x, double y, double z, double innerRadius, do
             }
 
             // Inner curb segment
-            glBegin(GL_QUADS);
-            glNormal3f(0, 1, 0);
-            glVertex3f(innerRadius * cos(angle1), 0.01, innerRadius * sin(angle1));
-            glVertex3f((innerRadius + curbWidth) * cos(angle1), 0.01, (innerRadius + curbWidth) * sin(angle1));
-            glVertex3f((innerRadius + curbWidth) * cos(angle2), 0.01, (innerRadius + curbWidth) * sin(angle2));
-            glVertex3f(innerRadius * cos(angle2), 0.01, innerRadius * sin(angle2));
-            glEnd();
+            DrawBegin(GL_QUADS);
+            DrawNormal3f(0, 1, 0);
+            DrawVertex3f(innerRadius * cos(angle1), 0.01, innerRadius * sin(angle1));
+            DrawVertex3f((innerRadius + curbWidth) * cos(angle1), 0.01, (innerRadius + curbWidth) * sin(angle1));
+            DrawVertex3f((innerRadius + curbWidth) * cos(angle2), 0.01, (innerRadius + curbWidth) * sin(angle2));
+            DrawVertex3f(innerRadius * cos(angle2), 0.01, innerRadius * sin(angle2));
+            DrawEnd();
 
             // Outer curb segment
-            glBegin(GL_QUADS);
-            glNormal3f(0, 1, 0);
-            glVertex3f((outerRadius - curbWidth) * cos(angle1), 0.01, (outerRadius - curbWidth) * sin(angle1));
-            glVertex3f(outerRadius * cos(angle1), 0.01, outerRadius * sin(angle1));
-            glVertex3f(outerRadius * cos(angle2), 0.01, outerRadius * sin(angle2));
-            glVertex3f((outerRadius - curbWidth) * cos(angle2), 0.01, (outerRadius - curbWidth) * sin(angle2));
-            glEnd();
+            DrawBegin(GL_QUADS);
+            DrawNormal3f(0, 1, 0);
+            DrawVertex3f((outerRadius - curbWidth) * cos(angle1), 0.01, (outerRadius - curbWidth) * sin(angle1));
+            DrawVertex3f(outerRadius * cos(angle1), 0.01, outerRadius * sin(angle1));
+            DrawVertex3f(outerRadius * cos(angle2), 0.01, outerRadius * sin(angle2));
+            DrawVertex3f((outerRadius - curbWidth) * cos(angle2), 0.01, (outerRadius - curbWidth) * sin(angle2));
+            DrawEnd();
         }
     }
 
@@ -966,28 +1347,28 @@ void drawRoadBlockLeftTurn(double x, double y, double z, double innerRadius, dou
     // Main road surface
     SetMaterial(0.4, 0.4, 0.4, 0.7, 0.7, 0.7, 0.2, 0.2, 0.2, 10);
     glColor3f(1.0, 1.0, 1.0);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[0]);
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[0]);
 
     for (int i = 0; i < segments; i++)
     {
         double angle1 = i * angleStep * M_PI / 180.0;
         double angle2 = (i + 1) * angleStep * M_PI / 180.0;
 
-        glBegin(GL_QUADS);
-        glNormal3f(0, 1, 0);
-        glTexCoord2f(0, (float)i / segments);
-        glVertex3f(innerRadius * cos(angle1), 0, -innerRadius * sin(angle1));
-        glTexCoord2f(1, (float)i / segments);
-        glVertex3f(outerRadius * cos(angle1), 0, -outerRadius * sin(angle1));
-        glTexCoord2f(1, (float)(i + 1) / segments);
-        glVertex3f(outerRadius * cos(angle2), 0, -outerRadius * sin(angle2));
-        glTexCoord2f(0, (float)(i + 1) / segments);
-        glVertex3f(innerRadius * cos(angle2), 0, -innerRadius * sin(angle2));
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 1, 0);
+        DrawTexCoord2f(0, (float)i / segments);
+        DrawVertex3f(innerRadius * cos(angle1), 0, -innerRadius * sin(angle1));
+        DrawTexCoord2f(1, (float)i / segments);
+        DrawVertex3f(outerRadius * cos(angle1), 0, -outerRadius * sin(angle1));
+        DrawTexCoord2f(1, (float)(i + 1) / segments);
+        DrawVertex3f(outerRadius * cos(angle2), 0, -outerRadius * sin(angle2));
+        DrawTexCoord2f(0, (float)(i + 1) / segments);
+        DrawVertex3f(innerRadius * cos(angle2), 0, -innerRadius * sin(angle2));
+        DrawEnd();
     }
 
-    glDisable(GL_TEXTURE_2D);
+    StateDisable(GL_TEXTURE_2D);
 
     // Curb parameters
     double curbWidth = 0.2;
@@ -1015,22 +1396,22 @@ void drawRoadBlockLeftTurn(double x, double y, double z, double innerRadius, dou
             }
 
             // Inner curb segment
-            glBegin(GL_QUADS);
-            glNormal3f(0, 1, 0);
-            glVertex3f(innerRadius * cos(angle1), 0.01, -innerRadius * sin(angle1));
-            glVertex3f((innerRadius + curbWidth) * cos(angle1), 0.01, -(innerRadius + curbWidth) * sin(angle1));
-            glVertex3f((innerRadius + curbWidth) * cos(angle2), 0.01, -(innerRadius + curbWidth) * sin(angle2));
-            glVertex3f(innerRadius * cos(angle2), 0.01, -innerRadius * sin(angle2));
-            glEnd();
+            DrawBegin(GL_QUADS);
+            DrawNormal3f(0, 1, 0);
+            DrawVertex3f(innerRadius * cos(angle1), 0.01, -innerRadius * sin(angle1));
+            DrawVertex3f((innerRadius + curbWidth) * cos(angle1), 0.01, -(innerRadius + curbWidth) * sin(angle1));
+            DrawVertex3f((innerRadius + curbWidth) * cos(angle2), 0.01, -(innerRadius + curbWidth) * sin(angle2));
+            DrawVertex3f(innerRadius * cos(angle2), 0.01, -innerRadius * sin(angle2));
+            DrawEnd();
 
             // Outer curb segment
-            glBegin(GL_QUADS);
-            glNormal3f(0, 1, 0);
-            glVertex3f((outerRadius - curbWidth) * cos(angle1), 0.01, -(outerRadius - curbWidth) * sin(angle1));
-            glVertex3f(outerRadius * cos(angle1), 0.01, -outerRadius * sin(angle1));
-            glVertex3f(outerRadius * cos(angle2), 0.01, -outerRadius * sin(angle2));
-            glVertex3f((outerRadius - curbWidth) * cos(angle2), 0.01, -(outerRadius - curbWidth) * sin(angle2));
-            glEnd();
+            DrawBegin(GL_QUADS);
+            DrawNormal3f(0, 1, 0);
+            DrawVertex3f((outerRadius - curbWidth) * cos(angle1), 0.01, -(outerRadius - curbWidth) * sin(angle1));
+            DrawVertex3f(outerRadius * cos(angle1), 0.01, -outerRadius * sin(angle1));
+            DrawVertex3f(outerRadius * cos(angle2), 0.01, -outerRadius * sin(angle2));
+            DrawVertex3f((outerRadius - curbWidth) * cos(angle2), 0.01, -(outerRadius - curbWidth) * sin(angle2));
+            DrawEnd();
         }
     }
 
@@ -1048,50 +1429,50 @@ void drawCircuit(unsigned int texture[], unsigned int barricadeTextures[], int n
     SetMaterial(0.5, 0.5, 0.5, 0.6, 0.6, 0.6, 0.2, 0.2, 0.2, 10);
     glColor3f(0.6, 0.6, 0.6);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[1]); // Grass texture
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[1]); // Grass texture
 
     glPushMatrix();
     glTranslated(0, -0.01, 0); // Slightly below road level
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
 
-    glTexCoord2f(0, 0);
-    glVertex3f(-80, 0, -80);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-80, 0, -80);
 
-    glTexCoord2f(0, 40);
-    glVertex3f(80, 0, -80);
+    DrawTexCoord2f(0, 40);
+    DrawVertex3f(80, 0, -80);
 
-    glTexCoord2f(40, 40);
-    glVertex3f(80, 0, 80);
+    DrawTexCoord2f(40, 40);
+    DrawVertex3f(80, 0, 80);
 
-    glTexCoord2f(40, 0);
-    glVertex3f(-80, 0, 80);
-    glEnd();
+    DrawTexCoord2f(40, 0);
+    DrawVertex3f(-80, 0, 80);
+    DrawEnd();
     glPopMatrix();
-    glDisable(GL_TEXTURE_2D);
+    StateDisable(GL_TEXTURE_2D);
 
     // Grass area beside the right side of the track
     SetMaterial(0.1, 0.3, 0.1, 0.2, 0.5, 0.2, 0.05, 0.1, 0.05, 5);
     glColor3f(0.2, 0.5, 0.2);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture[2]); // Grass texture
+    StateEnable(GL_TEXTURE_2D);
+    StateBindTexture(texture[2]); // Grass texture
 
     // Right grass strip
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glTexCoord2f(0, 0);
-    glVertex3f(-3, -0.001, 0);
-    glTexCoord2f(0, 5);
-    glVertex3f(-3, -0.001, 11);
-    glTexCoord2f(40, 5);
-    glVertex3f(43, -0.001, 11);
-    glTexCoord2f(40, 0);
-    glVertex3f(43, -0.001, 00);
-    glEnd();
-
-    glDisable(GL_TEXTURE_2D);
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
+    DrawTexCoord2f(0, 0);
+    DrawVertex3f(-3, -0.001, 0);
+    DrawTexCoord2f(0, 5);
+    DrawVertex3f(-3, -0.001, 11);
+    DrawTexCoord2f(40, 5);
+    DrawVertex3f(43, -0.001, 11);
+    DrawTexCoord2f(40, 0);
+    DrawVertex3f(43, -0.001, 00);
+    DrawEnd();
+
+    StateDisable(GL_TEXTURE_2D);
 
     // Five F1 garages
     float garagePositions[5] = {
@@ -1131,14 +1512,14 @@ void drawCircuit(unsigned int texture[], unsigned int barricadeTextures[], int n
 
     // Horizontal fence bars
     glLineWidth(2.0);
-    glBegin(GL_LINES);
+    DrawBegin(GL_LINES);
     for (int j = 0; j < 6; j++)
     {
         double barY = 0.3 + j * 0.2;
-        glVertex3f(0, barY, 7);
-        glVertex3f(56, barY, 7);
+        DrawVertex3f(0, barY, 7);
+        DrawVertex3f(56, barY, 7);
     }
-    glEnd();
+    DrawEnd();
     glLineWidth(1.0); // Reset to default
     glPopMatrix();
 
@@ -1256,13 +1637,13 @@ void drawBarricade(double x, double y, double z, double rotation, unsigned int t
     int numWires = 8;
     float wireHeight = 1.4 / numWires;
 
-    glBegin(GL_LINES);
+    DrawBegin(GL_LINES);
     for (int i = 1; i <= numWires; i++)
     {
-        glVertex3f(0, i * wireHeight, 0);
-        glVertex3f(0, i * wireHeight, 3);
+        DrawVertex3f(0, i * wireHeight, 0);
+        DrawVertex3f(0, i * wireHeight, 3);
     }
-    glEnd();
+    DrawEnd();
 
     glLineWidth(1.0);
     glPopMatrix();
@@ -1423,7 +1804,7 @@ void drawTrafficLight()
                 100.0);        // shininess
     // Set emission for glow
     float redEmission[] = {0.8, 0.0, 0.0, 1.0};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, redEmission);
+    StateMaterialfv(GL_EMISSION, redEmission);
     sphere(0, 0, 0, 0.8);
     glPopMatrix();
 
@@ -1435,7 +1816,7 @@ void drawTrafficLight()
                 1.0, 0.5, 0.5, // specular (shiny red)
                 100.0);        // shininess
     // Set emission for glow
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, redEmission);
+    StateMaterialfv(GL_EMISSION, redEmission);
     sphere(0, 0, 0, 0.8);
     glPopMatrix();
 
@@ -1447,13 +1828,13 @@ void drawTrafficLight()
                 1.0, 0.5, 0.5, // specular (shiny red)
                 100.0);        // shininess
     // Set emission for glow
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, redEmission);
+    StateMaterialfv(GL_EMISSION, redEmission);
     sphere(0, 0, 0, 0.8);
     glPopMatrix();
 
     // Reset emission to zero for other objects
     float noEmission[] = {0.0, 0.0, 0.0, 1.0};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, noEmission);
+    StateMaterialfv(GL_EMISSION, noEmission);
 }
 
 void drawCamera()
@@ -1527,13 +1908,13 @@ void drawCamera()
                 100.0);        // shininess
     // Set emission for glow
     float redEmission[] = {0.8, 0.0, 0.0, 1.0};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, redEmission);
+    StateMaterialfv(GL_EMISSION, redEmission);
     cube(0, 0, 0, 0.04, 0.04, 0.04, 0, 0, 0, 0);
     glPopMatrix();
 
     // Reset emission to zero for other objects
     float noEmission[] = {0.0, 0.0, 0.0, 1.0};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, noEmission);
+    StateMaterialfv(GL_EMISSION, noEmission);
 }
 void drawLampFixture()
 {
@@ -1563,7 +1944,7 @@ void drawLampFixture()
         float z1 = domeRadius * cos(lat1);
         float r1 = domeRadius * sin(lat1);
 
-        glBegin(GL_QUAD_STRIP);
+        DrawBegin(GL_QUAD_STRIP);
         for (int k = 0; k <= slices; k++)
         {
             float lng = 2.0 * M_PI * (float)k / slices;
@@ -1575,17 +1956,17 @@ void drawLampFixture()
             float ny0 = r0 * sinLng / domeRadius;
             float nz0 = z0 / domeRadius;
 
-            glNormal3f(nx0, ny0, nz0);
-            glVertex3f(r0 * cosLng, r0 * sinLng, z0);
+            DrawNormal3f(nx0, ny0, nz0);
+            DrawVertex3f(r0 * cosLng, r0 * sinLng, z0);
 
             float nx1 = r1 * cosLng / domeRadius;
             float ny1 = r1 * sinLng / domeRadius;
             float nz1 = z1 / domeRadius;
 
-            glNormal3f(nx1, ny1, nz1);
-            glVertex3f(r1 * cosLng, r1 * sinLng, z1);
+            DrawNormal3f(nx1, ny1, nz1);
+            DrawVertex3f(r1 * cosLng, r1 * sinLng, z1);
         }
-        glEnd();
+        DrawEnd();
     }
 
     // emissive base
@@ -1597,23 +1978,23 @@ void drawLampFixture()
 
     // Enable strong emission for glow effect
     float emission[] = {1.0f, 1.0f, 0.9f, 1.0f}; // Warm white glow
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emission);
+    StateMaterialfv(GL_EMISSION, emission);
 
-    glBegin(GL_TRIANGLE_FAN);
-    glNormal3f(0, 0, -1); // Normal pointing down
-    glVertex3f(0, 0, 0);  // center
+    DrawBegin(GL_TRIANGLE_FAN);
+    DrawNormal3f(0, 0, -1); // Normal pointing down
+    DrawVertex3f(0, 0, 0);  // center
 
     for (int k = 0; k <= slices; k++)
     {
         float lng = 2.0 * M_PI * (float)k / slices;
-        glNormal3f(0, 0, -1);
-        glVertex3f(domeRadius * cos(lng), domeRadius * sin(lng), 0);
+        DrawNormal3f(0, 0, -1);
+        DrawVertex3f(domeRadius * cos(lng), domeRadius * sin(lng), 0);
     }
-    glEnd();
+    DrawEnd();
 
     // Reset emission to zero so it doesn't affect other objects
     float noEmission[] = {0.0f, 0.0f, 0.0f, 1.0f};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, noEmission);
+    StateMaterialfv(GL_EMISSION, noEmission);
 
     glPopMatrix();
 }
@@ -1636,13 +2017,13 @@ void drawGrandStand()
     SetMaterial(0.3, 0.25, 0.2, 0.5, 0.4, 0.3, 0.2, 0.2, 0.2, 10.0);
 
     // Deck Surface
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glVertex3f(-standWidth / 2, 0, 0);
-    glVertex3f(standWidth / 2, 0, 0);
-    glVertex3f(standWidth / 2, 0, standHeight);
-    glVertex3f(-standWidth / 2, 0, standHeight);
-    glEnd();
+    DrawBegin(GL_QUADS);
+    DrawNormal3f(0, 1, 0);
+    DrawVertex3f(-standWidth / 2, 0, 0);
+    DrawVertex3f(standWidth / 2, 0, 0);
+    DrawVertex3f(standWidth / 2, 0, standHeight);
+    DrawVertex3f(-standWidth / 2, 0, standHeight);
+    DrawEnd();
 
     glPopMatrix();
     // draw Seats
@@ -1666,22 +2047,22 @@ void drawGrandStand()
         float z2 = (rowZ + sittingHeight) * cos(angle);
 
         // Seat surface
-        glBegin(GL_QUADS);
-        glNormal3f(0, 1, 0);
-        glVertex3f(-standWidth / 2, y1, z1);
-        glVertex3f(standWidth / 2, y1, z1);
-        glVertex3f(standWidth / 2, y1, z2);
-        glVertex3f(-standWidth / 2, y1, z2);
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 1, 0);
+        DrawVertex3f(-standWidth / 2, y1, z1);
+        DrawVertex3f(standWidth / 2, y1, z1);
+        DrawVertex3f(standWidth / 2, y1, z2);
+        DrawVertex3f(-standWidth / 2, y1, z2);
+        DrawEnd();
 
         // Seat back
-        glBegin(GL_QUADS);
-        glNormal3f(0, 0, -1);
-        glVertex3f(-standWidth / 2, y2, z2);
-        glVertex3f(standWidth / 2, y2, z2);
-        glVertex3f(standWidth / 2, y2 + seatHeight, z2);
-        glVertex3f(-standWidth / 2, y2 + seatHeight, z2);
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 0, -1);
+        DrawVertex3f(-standWidth / 2, y2, z2);
+        DrawVertex3f(standWidth / 2, y2, z2);
+        DrawVertex3f(standWidth / 2, y2 + seatHeight, z2);
+        DrawVertex3f(-standWidth / 2, y2 + seatHeight, z2);
+        DrawEnd();
     }
     glPopMatrix();
 
@@ -1703,22 +2084,22 @@ void drawGrandStand()
         float z = s * stepD;
 
         // Tread
-        glBegin(GL_QUADS);
-        glNormal3f(0, 1, 0);
-        glVertex3f(leftX, y + stepH, z);
-        glVertex3f(leftX + 1.0f, y + stepH, z);
-        glVertex3f(leftX + 1.0f, y + stepH, z + stepD);
-        glVertex3f(leftX, y + stepH, z + stepD);
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 1, 0);
+        DrawVertex3f(leftX, y + stepH, z);
+        DrawVertex3f(leftX + 1.0f, y + stepH, z);
+        DrawVertex3f(leftX + 1.0f, y + stepH, z + stepD);
+        DrawVertex3f(leftX, y + stepH, z + stepD);
+        DrawEnd();
 
         // Riser
-        glBegin(GL_QUADS);
-        glNormal3f(0, 0, -1);
-        glVertex3f(leftX, y, z);
-        glVertex3f(leftX + 1.0f, y, z);
-        glVertex3f(leftX + 1.0f, y + stepH, z);
-        glVertex3f(leftX, y + stepH, z);
-        glEnd();
+        DrawBegin(GL_QUADS);
+        DrawNormal3f(0, 0, -1);
+        DrawVertex3f(leftX, y, z);
+        DrawVertex3f(leftX + 1.0f, y, z);
+        DrawVertex3f(leftX + 1.0f, y + stepH, z);
+        DrawVertex3f(leftX, y + stepH, z);
+        DrawEnd();
     }
 
     // support pillars
@@ -1762,23 +2143,23 @@ void drawGrandStand()
     glPopMatrix();
 
     // draw closing triangles
-    glBegin(GL_TRIANGLES);
-    glVertex3f(-standWidth / 2 - 1.0f, 0, -0.3);
-    glVertex3f(-standWidth / 2 - 1.0f, endY + 0.3f, endZ + 0.2f);
-    glVertex3f(-standWidth / 2 - 1.0f, 0, endZ + 0.2f);
-    glEnd();
-
-    glBegin(GL_TRIANGLES);
-    glVertex3f(-standWidth / 2, 0, -0.3);
-    glVertex3f(-standWidth / 2, endY + 0.3f, endZ + 0.2f);
-    glVertex3f(-standWidth / 2, 0, endZ + 0.2f);
-    glEnd();
-
-    glBegin(GL_TRIANGLES);
-    glVertex3f(standWidth / 2, 0, -0.2);
-    glVertex3f(standWidth / 2, endY + 0.2f, endZ + 0.2f);
-    glVertex3f(standWidth / 2, 0, endZ + 0.2f);
-    glEnd();
+    DrawBegin(GL_TRIANGLES);
+    DrawVertex3f(-standWidth / 2 - 1.0f, 0, -0.3);
+    DrawVertex3f(-standWidth / 2 - 1.0f, endY + 0.3f, endZ + 0.2f);
+    DrawVertex3f(-standWidth / 2 - 1.0f, 0, endZ + 0.2f);
+    DrawEnd();
+
+    DrawBegin(GL_TRIANGLES);
+    DrawVertex3f(-standWidth / 2, 0, -0.3);
+    DrawVertex3f(-standWidth / 2, endY + 0.3f, endZ + 0.2f);
+    DrawVertex3f(-standWidth / 2, 0, endZ + 0.2f);
+    DrawEnd();
+
+    DrawBegin(GL_TRIANGLES);
+    DrawVertex3f(standWidth / 2, 0, -0.2);
+    DrawVertex3f(standWidth / 2, endY + 0.2f, endZ + 0.2f);
+    DrawVertex3f(standWidth / 2, 0, endZ + 0.2f);
+    DrawEnd();
 
     // draw platform
     glPushMatrix();
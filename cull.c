@@ -0,0 +1,156 @@
+//  Frustum culling
+//
+//  Bounding spheres are kept as a structure of arrays (centres and radii in
+//  separate arrays) so the test against the six frustum planes can run on
+//  four spheres at a time with SSE.  The planes are taken from the current
+//  projection and modelview matrices, so spheres are given in the
+//  coordinates of the current modelview.
+#include "CSCIx229.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+static int culledCount = 0; //  Objects culled since the last reset
+static int drawnCount = 0;  //  Objects drawn since the last reset
+
+/*
+ *  Add a bounding sphere
+ */
+void CullAdd(CullBounds *b, float x, float y, float z, float r)
+{
+   if (b->n == b->max)
+   {
+      b->max = b->max ? 2 * b->max : 64;
+      b->x = (float *)realloc(b->x, b->max * sizeof(float));
+      b->y = (float *)realloc(b->y, b->max * sizeof(float));
+      b->z = (float *)realloc(b->z, b->max * sizeof(float));
+      b->r = (float *)realloc(b->r, b->max * sizeof(float));
+      if (!b->x || !b->y || !b->z || !b->r)
+         Fatal("Cannot allocate %d bounding spheres\n", b->max);
+   }
+   b->x[b->n] = x;
+   b->y[b->n] = y;
+   b->z[b->n] = z;
+   b->r[b->n] = r;
+   b->n++;
+}
+
+/*
+ *  Remove all bounding spheres
+ */
+void CullClear(CullBounds *b)
+{
+   b->n = 0;
+}
+
+/*
+ *  Free the bounding sphere arrays
+ */
+void CullFree(CullBounds *b)
+{
+   free(b->x);
+   free(b->y);
+   free(b->z);
+   free(b->r);
+   memset(b, 0, sizeof(CullBounds));
+}
+
+//
+//  Frustum planes (ax+by+cz+d >= 0 inside) of projection * modelview
+//     Rows of the combined matrix added to and subtracted from the last row
+//
+static void CullPlanes(float plane[6][4])
+{
+   double P[16], M[16], C[16];
+   glGetDoublev(GL_PROJECTION_MATRIX, P);
+   glGetDoublev(GL_MODELVIEW_MATRIX, M);
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         C[4 * j + i] = P[i] * M[4 * j] + P[4 + i] * M[4 * j + 1] + P[8 + i] * M[4 * j + 2] + P[12 + i] * M[4 * j + 3];
+   for (int p = 0; p < 6; p++)
+   {
+      int row = p / 2;
+      double sign = (p % 2) ? -1 : 1;
+      double v[4];
+      for (int j = 0; j < 4; j++)
+         v[j] = C[4 * j + 3] + sign * C[4 * j + row];
+      //  Normalize so the distance can be compared with the radius
+      double len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+      if (len > 0)
+         len = 1 / len;
+      for (int j = 0; j < 4; j++)
+         plane[p][j] = v[j] * len;
+   }
+}
+
+/*
+ *  Test bounding spheres against the current view frustum
+ *  without counting them in the culling statistics
+ *     visible[k] is set to 1 if sphere k may be visible, 0 otherwise
+ *     Returns the number of visible spheres
+ */
+int CullSpheres(const CullBounds *b, unsigned char visible[])
+{
+   float plane[6][4];
+   CullPlanes(plane);
+
+   int k = 0;
+#ifdef __SSE__
+   //  Four spheres at a time
+   const __m128 zero = _mm_setzero_ps();
+   for (; k + 4 <= b->n; k += 4)
+   {
+      __m128 x = _mm_loadu_ps(b->x + k);
+      __m128 y = _mm_loadu_ps(b->y + k);
+      __m128 z = _mm_loadu_ps(b->z + k);
+      __m128 r = _mm_loadu_ps(b->r + k);
+      int mask = 15;
+      for (int p = 0; p < 6; p++)
+      {
+         __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[p][0]), x), _mm_mul_ps(_mm_set1_ps(plane[p][1]), y));
+         d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(plane[p][2]), z));
+         d = _mm_add_ps(d, _mm_add_ps(_mm_set1_ps(plane[p][3]), r));
+         mask &= _mm_movemask_ps(_mm_cmpge_ps(d, zero));
+      }
+      for (int i = 0; i < 4; i++)
+         visible[k + i] = (mask >> i) & 1;
+   }
+#endif
+   //  Remaining spheres (all of them without SSE)
+   for (; k < b->n; k++)
+   {
+      visible[k] = 1;
+      for (int p = 0; p < 6 && visible[k]; p++)
+         if (plane[p][0] * b->x[k] + plane[p][1] * b->y[k] + plane[p][2] * b->z[k] + plane[p][3] + b->r[k] < 0)
+            visible[k] = 0;
+   }
+
+   int n = 0;
+   for (k = 0; k < b->n; k++)
+      n += visible[k];
+   return n;
+}
+
+/*
+ *  Test bounding spheres against the current view frustum
+ *     visible[k] is set to 1 if sphere k may be visible, 0 otherwise
+ *     Returns the number of visible spheres
+ */
+int CullTest(const CullBounds *b, unsigned char visible[])
+{
+   int n = CullSpheres(b, visible);
+   drawnCount += n;
+   culledCount += b->n - n;
+   return n;
+}
+
+/*
+ *  Objects culled and drawn since the last reset
+ */
+void CullStats(int *culled, int *drawn, int reset)
+{
+   *culled = culledCount;
+   *drawn = drawnCount;
+   if (reset)
+      culledCount = drawnCount = 0;
+}
@@ -0,0 +1,19 @@
+#version 120
+
+uniform sampler2D sceneDepth;  // depth of the scene at full resolution
+uniform int scale;             // window pixels across a block (at most 4)
+uniform vec2 texel;            // size of a window pixel in texture coordinates
+
+void main()
+{
+    // Window pixels covered by this pixel of the small target
+    vec2 corner = floor(gl_FragCoord.xy) * float(scale) + 0.5;
+
+    // Nearest depth, so nothing behind a nearer object in the block shows
+    float depth = 1.0;
+    for (int j = 0; j < 4; j++)
+        for (int i = 0; i < 4; i++)
+            if (i < scale && j < scale)
+                depth = min(depth, texture2D(sceneDepth, (corner + vec2(i, j)) * texel).r);
+    gl_FragDepth = depth;
+}
@@ -15,6 +15,18 @@
  *  [          Lower light
  *  ]          Higher light
  *  F3         Toggle light distance
+ *  b          Toggle engine cover profile curve
+ *  v          Toggle adaptive engine cover subdivision
+ *  x          Toggle splashes computed in the shader or on the CPU
+ *  c          Toggle vector or scalar CPU splash search
+ *  g          Cycle rain columns, GPU particles and procedural drops
+ *  -/=        Halve/double the number of GPU rain drops or procedural drops per tile
+ *  l          Toggle procedural rain drawn as thin lines or point sprites
+ *  o          Toggle rain overdraw measurement (fragments per pixel)
+ *  h          Cycle rain drawn at full, half and quarter resolution
+ *  t          Toggle trilinear mipmapped or bilinear textures
+ *  f          Cycle texture anisotropy (1x up to the driver limit)
+ *  ,/.        Wind blowing rain towards -x/+x
  */
 
 #include "CSCIx229.h"
@@ -41,13 +53,6 @@ typedef struct
    float length;
 } DropData;
 
-typedef struct
-{
-   float xPos;
-   float zPos;
-   float collisionTime;
-} SplashData;
-
 int numRainDrops = 7000;
 int maxSplashes = 300;
 float rainHeight = 30.0f;
@@ -55,11 +60,56 @@ float rainArea = 120.0f;
 
 GLuint rainVBO;
 GLuint splashVBO;
-GLuint rainShader, splashShader;
+ShaderProgram *rainShader, *splashShader;
+ShaderProgram *splashDropShader; // splashes computed from the drops
+int splashAnalytic = 1;  // 1 = splashes from splashdrop.vert, 0 = found on the CPU
 
 SplashData *splashBuffer;
 int splashWriteIndex = 0;
 DropData *rainDrops = NULL;
+RainDrops rainSoA; // drops as separate arrays for the CPU splash search
+int rainSimd = 1;  // 1 = vector splash search, 0 = scalar
+
+// Rain modes
+#define RAIN_COLUMNS 0    // drops from rainVBO falling in fixed columns
+#define RAIN_PARTICLES 1  // drops advanced on the GPU
+#define RAIN_PROCEDURAL 2 // drops made up from gl_VertexID without a buffer
+const char *textRain[] = {"Columns", "Particles", "Procedural"};
+int rainMode = RAIN_PROCEDURAL;
+int rainModern = 0; // OpenGL 3.0 available for particles and procedural drops
+
+// GPU rain particles and procedural drops
+ParticleSystem *rainParticles = NULL;
+ShaderProgram *rainParticleShader, *splashParticleShader;
+ShaderProgram *rainProcShader, *splashProcShader;
+ShaderProgram *rainStreakShader; // procedural drops drawn as lines
+int rainStreaks = 0;             // 1 = procedural drops as lines, 0 = point sprites
+int maxRainDrops = 1000000;      // most GPU drops
+int rainCount = 7000;            // GPU drops drawn
+float rainWind = 0.0f;           // wind velocity along x
+float lastRainUpdate = -1.0f;    // rainTime of the last particle update
+
+// Procedural drops in tiles around the camera
+#define RAIN_TILES 9                      // tiles across the grid
+float rainTileSize = 15.0f;               // width of a tile
+int rainTileDrops = 200;                  // drops in a tile at full density
+float rainFalloff[2] = {15.0f, 60.0f};    // density falls off between these distances
+float rainMinDensity = 0.1f;              // density beyond the falloff
+CullBounds rainTileBounds;                // bounding spheres of the tiles
+float rainTile[RAIN_TILES * RAIN_TILES][2]; // centres of the visible tiles
+int rainTileCount[RAIN_TILES * RAIN_TILES]; // drops drawn in each visible tile
+int rainTilesDrawn = 0;                   // visible tiles
+float rainEye[3];                         // camera position
+int rainActive = 0, rainTotal = 0;        // drops drawn and drops a full grid would draw
+
+// Rain drawn at 1/rainScale of the window resolution (1, 2 or 4)
+int rainScale = 1;
+
+// Rain overdraw measurement
+int rainOverdraw = 0;             // measure rain fragments per pixel
+int rainStatsQuery = 0;           // fragment shader invocations can be counted
+GLuint rainQuery[2];              // shader invocations and samples passed
+float rainShaded, rainWritten;    // rain fragments shaded and written per pixel
 
 // For rain animation
 float rainTime = 0.0f;
@@ -69,8 +119,8 @@ float fogIntensity = 0.04f;
 
 int dayNightMode = 1; // 0 = day, 1 = night
 const char *textDayNight[] = {"Day", "Night"};
-GLuint nightSky[6]; // Night skybox textures
-GLuint mornSky[6];  // Morning skybox textures
+GLuint nightSky; // Night skybox cube map
+GLuint mornSky;  // Morning skybox cube map
 
 // Colors in order: Body, Fins, Halo
 // Ferrari
@@ -104,6 +154,22 @@ float astonMartinColors[3][3] = {
     {0.9, 0.75, 0.3}   // Gold
 };
 
+// Livery table of the car fleet
+float (*liveries[])[3] = {ferrariColors, mclarenColors, mercedesColors, redBullColors, astonMartinColors};
+#define NUM_LIVERIES (int)(sizeof(liveries) / sizeof(liveries[0]))
+
+// Starting grid slots (x,z) and the cars on them
+// (position, heading, steering, braking, velocity, livery)
+// The McLaren (grid[1]) is driven away from its slot
+const double gridSlot[][2] = {{6, -1}, {4, 1}, {2, -1}, {0, 1}, {-2, -1}};
+CarState grid[] = {
+    {6, 0, -1, 0, 0, 0, 0, 0},
+    {4, 0, 1, 0, 0, 0, 0, 1},
+    {2, 0, -1, 0, 0, 0, 0, 2},
+    {0, 0, 1, 0, 0, 0, 0, 3},
+    {-2, 0, -1, 0, 0, 0, 0, 4}};
+#define NUM_GRID (int)(sizeof(grid) / sizeof(grid[0]))
+
 // McLaren car position and physics
 double ferrariX = 4.0;
 double ferrariY = 0.0;
@@ -149,6 +215,20 @@ int zh = 90;                      // Light azimuth
 float ylight = 4;                 // Elevation of light
 unsigned int texture[13];         // Texture names
 unsigned int barricadeTexture[5]; // Barricade Texture names
+int texTrilinear = 1;             // mipmapped textures sampled trilinearly
+float texAniso = 1;               // anisotropy of mipmapped textures
+Scene *circuit = NULL;            // Static circuit baked on first draw
+#define CIRCUIT_CELL 16.0         // Size of the circuit cells culled together
+
+// Grandstands (x, z, rotation)
+const double stand[][3] = {{5, -3.5, 180}, {22, -3.5, 180}, {35, 10, 90}, {35, 25, 90}};
+#define NUM_STANDS (int)(sizeof(stand) / sizeof(stand[0]))
+// Bounding sphere of drawGrandStand in its own coordinates
+#define STAND_X -0.5
+#define STAND_Y 1.5
+#define STAND_Z 2.7
+#define STAND_R 7.8
+CullBounds standBounds = {0}; // Bounding spheres of the placed stands
 
 Mix_Music *rainBG;
 // Mix_Chunk *engineStart;
@@ -186,6 +266,16 @@ void calculateRainPositions()
       rainDrops[i].length = 0.2f + ((float)rand() / RAND_MAX) * 0.6f; // from 0.2 to 0.8 units
    }
 
+   // Same drops as separate arrays for the CPU splash search
+   RainAlloc(&rainSoA, numRainDrops);
+   for (int i = 0; i < numRainDrops; i++)
+   {
+      rainSoA.x[i] = rainDrops[i].xPos;
+      rainSoA.z[i] = rainDrops[i].zPos;
+      rainSoA.speed[i] = rainDrops[i].speed;
+      rainSoA.length[i] = rainDrops[i].length;
+   }
+
    glGenBuffers(1, &rainVBO);                                                                 // Generate VBO for rain drops
    glBindBuffer(GL_ARRAY_BUFFER, rainVBO);                                                    // Select the buffer
    glBufferData(GL_ARRAY_BUFFER, numRainDrops * sizeof(DropData), rainDrops, GL_STATIC_DRAW); // transfer data to GPU
@@ -215,24 +305,8 @@ void checkForSplashes()
    float now = rainTime;
    float before = lastCheckTime;
 
-   for (int i = 0; i < numRainDrops; i++)
-   {
-      float speed = rainDrops[i].speed;
-
-      // position of drop before and now
-      float beforeY = rainHeight - fmod(before * speed, rainHeight);
-      float nowY = rainHeight - fmod(now * speed, rainHeight);
-
-      // if it has crossed the ground level (Y=0) between last check and now
-      if (beforeY > 0.5f && nowY <= 0.5f)
-      { // Register a splash at this drop's X,Z position at current time
-         splashBuffer[splashWriteIndex].xPos = rainDrops[i].xPos;
-         splashBuffer[splashWriteIndex].zPos = rainDrops[i].zPos;
-         splashBuffer[splashWriteIndex].collisionTime = now;
-
-         splashWriteIndex = (splashWriteIndex + 1) % maxSplashes;
-      }
-   }
+   // Register a splash for every drop that passed the ground level since the last check
+   RainSplashes(&rainSoA, before, now, rainHeight, splashBuffer, maxSplashes, &splashWriteIndex, rainSimd);
 
    lastCheckTime = now;
 
@@ -242,52 +316,205 @@ void checkForSplashes()
    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+// Advance the GPU drops to rainTime
+void updateRainParticles()
+{
+   float dt = rainTime - lastRainUpdate;
+   // First update, or rainTime wrapped around
+   if (lastRainUpdate < 0 || dt < 0 || dt > 0.5f)
+      dt = 0.05f;
+   lastRainUpdate = rainTime;
+   ParticleUpdate(rainParticles, rainTime, dt);
+}
+
+// Camera position from the modelview matrix
+void rainCamera()
+{
+   double M[16];
+   glGetDoublev(GL_MODELVIEW_MATRIX, M);
+   for (int i = 0; i < 3; i++)
+      rainEye[i] = -(M[4 * i] * M[12] + M[4 * i + 1] * M[13] + M[4 * i + 2] * M[14]);
+}
+
+// Fraction of the drops kept at distance d from the camera (as in rainproc.vert)
+float rainDensity(float d)
+{
+   float t = (d - rainFalloff[0]) / (rainFalloff[1] - rainFalloff[0]);
+   t = t < 0 ? 0 : t > 1 ? 1 : t;
+   t = t * t * (3 - 2 * t);
+   return 1 + (rainMinDensity - 1) * t;
+}
+
+// Find the visible rain tiles around the camera and how many drops each needs
+void placeRainTiles()
+{
+   unsigned char visible[RAIN_TILES * RAIN_TILES];
+   float half = 0.5f * rainTileSize;
+   // Sphere around a tile and the rain above it
+   float r = sqrt(2 * half * half + 0.25f * rainHeight * rainHeight);
+   CullClear(&rainTileBounds);
+   for (int i = 0; i < RAIN_TILES; i++)
+      for (int j = 0; j < RAIN_TILES; j++)
+         CullAdd(&rainTileBounds, rainEye[0] + (i - RAIN_TILES / 2) * rainTileSize, 0.5f * rainHeight,
+                 rainEye[2] + (j - RAIN_TILES / 2) * rainTileSize, r);
+   CullSpheres(&rainTileBounds, visible);
+
+   rainTilesDrawn = 0;
+   rainActive = 0;
+   rainTotal = RAIN_TILES * RAIN_TILES * rainTileDrops;
+   for (int k = 0; k < rainTileBounds.n; k++)
+   {
+      if (!visible[k])
+         continue;
+      float x = rainTileBounds.x[k];
+      float z = rainTileBounds.z[k];
+      // The nearest point of the tile needs the most drops
+      float dx = fmax(fabs(x - rainEye[0]) - half, 0);
+      float dz = fmax(fabs(z - rainEye[2]) - half, 0);
+      int n = ceil(rainTileDrops * rainDensity(sqrt(dx * dx + dz * dz)));
+      rainTile[rainTilesDrawn][0] = x;
+      rainTile[rainTilesDrawn][1] = z;
+      rainTileCount[rainTilesDrawn] = n;
+      rainTilesDrawn++;
+      rainActive += n;
+   }
+}
+
+// Draw the procedural drops or splashes in the visible tiles
+//    Lines take two vertices per drop
+void drawRainTiles(const ShaderProgram *shader, GLenum prim)
+{
+   int vertices = prim == GL_LINES ? 2 : 1;
+   ShaderSet1f(shader, "tileSize", rainTileSize);
+   ShaderSet3fv(shader, "eye", rainEye);
+   ShaderSet2f(shader, "falloff", rainFalloff[0], rainFalloff[1]);
+   ShaderSet1f(shader, "minDensity", rainMinDensity);
+   ShaderSet1f(shader, "drops", rainTileDrops);
+   int tile = ShaderUniform(shader, "tile");
+   for (int k = 0; k < rainTilesDrawn; k++)
+   {
+      glUniform2fv(tile, 1, rainTile[k]);
+      glDrawArrays(prim, 0, vertices * rainTileCount[k]);
+   }
+}
+
+// Start counting the fragments rain draws
+void beginRainQuery()
+{
+   if (rainStatsQuery)
+      glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, rainQuery[0]);
+   glBeginQuery(GL_SAMPLES_PASSED, rainQuery[1]);
+}
+
+// Fragments rain drew per pixel of the window (waits for the counts)
+void endRainQuery()
+{
+   GLuint shaded = 0, written = 0;
+   int vp[4];
+   if (rainStatsQuery)
+      glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+   glEndQuery(GL_SAMPLES_PASSED);
+   if (rainStatsQuery)
+      glGetQueryObjectuiv(rainQuery[0], GL_QUERY_RESULT, &shaded);
+   glGetQueryObjectuiv(rainQuery[1], GL_QUERY_RESULT, &written);
+   //  Per pixel of the window, so low resolution passes compare with full resolution
+   glGetIntegerv(GL_VIEWPORT, vp);
+   rainShaded = (float)shaded / (vp[2] * vp[3] * rainScale * rainScale);
+   rainWritten = (float)written / (vp[2] * vp[3] * rainScale * rainScale);
+}
+
+// Blend rain over the scene, or into the low resolution target with premultiplied colour
+void rainBlend()
+{
+   StateEnable(GL_BLEND);
+   if (rainScale > 1)
+      StateBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+   else
+      StateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
 void renderRain()
 {
-   glUseProgram(rainShader);
-   // Send uniform variables
-   glUniform1f(glGetUniformLocation(rainShader, "currTime"), rainTime);
-   glUniform1f(glGetUniformLocation(rainShader, "height"), rainHeight);
+   int streaks = rainMode == RAIN_PROCEDURAL && rainStreaks;
+   ShaderProgram *shader = rainMode == RAIN_PARTICLES    ? rainParticleShader
+                           : streaks                     ? rainStreakShader
+                           : rainMode == RAIN_PROCEDURAL ? rainProcShader
+                                                         : rainShader;
+   // Time, height and point scale are shared by all the rain programs
+   ShaderUse(shader);
    // Enable point sprites and point size from shader
    glEnable(GL_POINT_SPRITE);
    glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
    glEnable(GL_POINT_SMOOTH);
    // Enable blending for transparency
-   glEnable(GL_BLEND);
-   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-   // Bind VBO and set vertex attribute
-   glBindBuffer(GL_ARRAY_BUFFER, rainVBO);
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(DropData), (void *)0);
-   glDrawArrays(GL_POINTS, 0, numRainDrops);
-   glDisableVertexAttribArray(0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   rainBlend();
+   if (rainMode == RAIN_PARTICLES)
+      // Drops where the particle update left them
+      ParticleDraw(rainParticles);
+   else if (rainMode == RAIN_PROCEDURAL)
+      // No buffer, the shader makes up the drops
+      drawRainTiles(shader, streaks ? GL_LINES : GL_POINTS);
+   else
+   {
+      // Bind VBO and set vertex attribute
+      int rainData = ShaderAttrib(shader, "rainData");
+      glBindBuffer(GL_ARRAY_BUFFER, rainVBO);
+      glEnableVertexAttribArray(rainData);
+      glVertexAttribPointer(rainData, 4, GL_FLOAT, GL_FALSE, sizeof(DropData), (void *)0);
+      glDrawArrays(GL_POINTS, 0, numRainDrops);
+      glDisableVertexAttribArray(rainData);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
 
    glUseProgram(0);
 }
 
 void renderSplashes()
 {
-   glUseProgram(splashShader);
-   // Send uniform variables
-   glUniform1f(glGetUniformLocation(splashShader, "time"), rainTime);
+   // Splashes left by the GPU drops, made up with the procedural drops,
+   // from the drops themselves or from the splash buffer
+   ShaderProgram *shader = rainMode == RAIN_PARTICLES    ? splashParticleShader
+                           : rainMode == RAIN_PROCEDURAL ? splashProcShader
+                           : splashAnalytic              ? splashDropShader
+                                                         : splashShader;
+   ShaderUse(shader);
    // Enable point sprites and point size from shader
    glEnable(GL_POINT_SPRITE);
    glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 
    // Enable blending for transparency
-   glEnable(GL_BLEND);
-   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   rainBlend();
 
-   // Bind VBO and set vertex attribute
-   glBindBuffer(GL_ARRAY_BUFFER, splashVBO);
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SplashData), (void *)0);
-   glDrawArrays(GL_POINTS, 0, maxSplashes);
-   glDisableVertexAttribArray(0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   if (rainMode == RAIN_PARTICLES)
+      ParticleDraw(rainParticles);
+   else if (rainMode == RAIN_PROCEDURAL)
+      drawRainTiles(shader, GL_POINTS);
+   else
+   {
+      // Bind VBO and set vertex attribute
+      int data;
+      if (splashAnalytic)
+      {
+         // Every drop is a possible splash
+         data = ShaderAttrib(shader, "rainData");
+         glBindBuffer(GL_ARRAY_BUFFER, rainVBO);
+         glEnableVertexAttribArray(data);
+         glVertexAttribPointer(data, 4, GL_FLOAT, GL_FALSE, sizeof(DropData), (void *)0);
+         glDrawArrays(GL_POINTS, 0, numRainDrops);
+      }
+      else
+      {
+         data = ShaderAttrib(shader, "splashData");
+         glBindBuffer(GL_ARRAY_BUFFER, splashVBO);
+         glEnableVertexAttribArray(data);
+         glVertexAttribPointer(data, 3, GL_FLOAT, GL_FALSE, sizeof(SplashData), (void *)0);
+         glDrawArrays(GL_POINTS, 0, maxSplashes);
+      }
+      glDisableVertexAttribArray(data);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
 
    glUseProgram(0);
 }
@@ -299,7 +526,7 @@ void ApplyFog()
       if (!Mix_PlayingMusic())      // Play only once
          Mix_PlayMusic(rainBG, -1); // Loop rain
 
-      glEnable(GL_FOG);
+      StateEnable(GL_FOG);
 
       GLfloat fogColor[4] = {0.65f, 0.70f, 0.75f, 1.0f};
 
@@ -320,107 +547,10 @@ void ApplyFog()
    else // Remove fog in day mode
    {
       Mix_FadeOutMusic(1000); // Fade out rain
-      glDisable(GL_FOG);
+      StateDisable(GL_FOG);
    }
 }
 
-void DrawSkybox(float boxSize, GLuint *skyTextures)
-{
-   glPushMatrix();
-   glScaled(boxSize, boxSize, boxSize);
-   glColor3f(1, 1, 1);
-
-   glPushAttrib(GL_ENABLE_BIT);
-
-   glDisable(GL_FOG);
-   glDisable(GL_LIGHTING);
-   glDisable(GL_CULL_FACE);
-   glDepthMask(GL_FALSE);
-   glEnable(GL_TEXTURE_2D);
-
-   // Side face  +X  px
-   glBindTexture(GL_TEXTURE_2D, skyTextures[0]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(1, 0);
-   glVertex3f(1, -1, -1);
-   glTexCoord2f(0, 0);
-   glVertex3f(1, -1, 1);
-   glTexCoord2f(0, 1);
-   glVertex3f(1, 1, 1);
-   glTexCoord2f(1, 1);
-   glVertex3f(1, 1, -1);
-   glEnd();
-
-   // Side face -X nx
-   glBindTexture(GL_TEXTURE_2D, skyTextures[1]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(1, 0);
-   glVertex3f(-1, -1, 1);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, -1, -1);
-   glTexCoord2f(0, 1);
-   glVertex3f(-1, 1, -1);
-   glTexCoord2f(1, 1);
-   glVertex3f(-1, 1, 1);
-   glEnd();
-
-   // Top face +Y py
-   glBindTexture(GL_TEXTURE_2D, skyTextures[2]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(0, 1);
-   glVertex3f(-1, 1, -1);
-   glTexCoord2f(1, 1);
-   glVertex3f(1, 1, -1);
-   glTexCoord2f(1, 0);
-   glVertex3f(1, 1, 1);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, 1, 1);
-   glEnd();
-
-   // bottom face  -Y ny
-   glBindTexture(GL_TEXTURE_2D, skyTextures[3]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, -1, 1);
-   glTexCoord2f(1, 0);
-   glVertex3f(1, -1, 1);
-   glTexCoord2f(1, 1);
-   glVertex3f(1, -1, -1);
-   glTexCoord2f(0, 1);
-   glVertex3f(-1, -1, -1);
-   glEnd();
-
-   // front face +Z pz
-   glBindTexture(GL_TEXTURE_2D, skyTextures[4]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, -1, 1);
-   glTexCoord2f(1, 0);
-   glVertex3f(1, -1, 1);
-   glTexCoord2f(1, 1);
-   glVertex3f(1, 1, 1);
-   glTexCoord2f(0, 1);
-   glVertex3f(-1, 1, 1);
-   glEnd();
-
-   // back face -Z nz
-   glBindTexture(GL_TEXTURE_2D, skyTextures[5]);
-   glBegin(GL_QUADS);
-   glTexCoord2f(0, 0);
-   glVertex3f(1, -1, -1);
-   glTexCoord2f(1, 0);
-   glVertex3f(-1, -1, -1);
-   glTexCoord2f(1, 1);
-   glVertex3f(-1, 1, -1);
-   glTexCoord2f(0, 1);
-   glVertex3f(1, 1, -1);
-   glEnd();
-
-   glDepthMask(GL_TRUE);
-   glPopAttrib();
-   glPopMatrix();
-}
-
 /*
  *  SDL calls this routine to display the scene
  */
@@ -432,10 +562,14 @@ void display(SDL_Window *window)
    glEnable(GL_DEPTH_TEST);
    //  Undo previous
    glLoadIdentity();
-   glUseProgram(0); // turn off shaders before skybox
+   glUseProgram(0);
+   //  Shapes pick their level of detail again
+   LodFrame();
+   //  Reread state changed outside the state cache since the last frame
+   StateReset();
 
-   // Select skybox based on day/night mode
-   GLuint *currentSky = (dayNightMode == 0) ? mornSky : nightSky;
+   //  Eye the skybox is centred on
+   double eye[3];
 
    //  Set camera based on projection mode
    switch (perspective)
@@ -446,13 +580,9 @@ void display(SDL_Window *window)
       double Ey = +2 * dim * Sin(ph);
       double Ez = +2 * dim * Cos(th) * Cos(ph);
       gluLookAt(Ex, Ey, Ez, 0, 0, 0, 0, Cos(ph), 0);
-
-      // Draw skybox at camera origin
-      glPushMatrix();
-      glTranslatef(Ex, Ey, Ez);
-      if (mode == 0)
-         DrawSkybox(70.0f, currentSky);
-      glPopMatrix();
+      eye[0] = Ex;
+      eye[1] = Ey;
+      eye[2] = Ez;
 
       fogIntensity = 0.04f;
       break;
@@ -464,13 +594,9 @@ void display(SDL_Window *window)
       gluLookAt(12, 4, 3, // camera position
                 0, 0, 0,
                 0, 1, 0);
-
-      // Draw skybox at camera position
-      glPushMatrix();
-      glTranslatef(povX, povY, povZ);
-      if (mode == 0)
-         DrawSkybox(70.0f, currentSky);
-      glPopMatrix();
+      eye[0] = 12;
+      eye[1] = 4;
+      eye[2] = 3;
 
       fogIntensity = 0.12f;
       break;
@@ -478,12 +604,9 @@ void display(SDL_Window *window)
    case 2: // POV view
    {
       gluLookAt(povX, povY, povZ, ferrariX, ferrariY + 0.2, ferrariZ, 0, 1, 0);
-
-      // Draw skybox at camera position
-      glPushMatrix();
-      glTranslatef(povX, povY, povZ);
-      DrawSkybox(70.0f, currentSky);
-      glPopMatrix();
+      eye[0] = povX;
+      eye[1] = povY;
+      eye[2] = povZ;
 
       fogIntensity = 0.12f;
       break;
@@ -510,7 +633,7 @@ void display(SDL_Window *window)
       ball(Position[0], Position[1], Position[2], 0.1);
       //  Enable lighting with normalization
       glEnable(GL_NORMALIZE);
-      glEnable(GL_LIGHTING);
+      StateEnable(GL_LIGHTING);
       //  Location of viewer for specular calculations
       glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, local);
       //  Enable light 0
@@ -522,141 +645,108 @@ void display(SDL_Window *window)
       glLightfv(GL_LIGHT0, GL_POSITION, Position);
    }
    else
-      glDisable(GL_LIGHTING);
+      StateDisable(GL_LIGHTING);
 
    //  Decide what to draw
    switch (mode)
    {
    case 0:
-      // first stand near start line
-      glPushMatrix();
-      glTranslated(5, 0, -3.5);
-      glRotatef(180, 0, 1, 0);
-      glScalef(1.0f, 1.0f, 1.0f);
-      drawGrandStand();
-      glPopMatrix();
-      // second Stand
-      glPushMatrix();
-      glTranslated(22, 0, -3.5);
-      glRotatef(180, 0, 1, 0);
-      glScalef(1.0f, 1.0f, 1.0f);
-      drawGrandStand();
-      glPopMatrix();
-      // 3rd Stand
-      glPushMatrix();
-      glTranslated(35, 0, 10);
-      glRotatef(90, 0, 1, 0);
-      glScalef(1.0f, 1.0f, 1.0f);
-      drawGrandStand();
-      glPopMatrix();
-
-      // 3rd Stand
-      glPushMatrix();
-      glTranslated(35, 0, 25);
-      glRotatef(90, 0, 1, 0);
-      glScalef(1.0f, 1.0f, 1.0f);
-      drawGrandStand();
-      glPopMatrix();
-
-      // support banner with textures
-      glPushMatrix();
-      glTranslated(33, 0, 20);
-      glRotatef(-90, 0, 1, 0);
-      drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[0]);
-      glPopMatrix();
-
-      // support banner with lights
-      glPushMatrix();
-      glTranslated(33, 0, 10);
-      glRotatef(-90, 0, 1, 0);
-      drawSupportBanner(3.0, 6.0, 0.3, 3, barricadeTexture[2]);
-      glPopMatrix();
-
-      // support banner with textures
-      glPushMatrix();
-      glTranslated(20, 0, -3);
-      drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[2]);
-      glPopMatrix();
-
-      // main start light
-      glPushMatrix();
-      glTranslated(12, 0, -3);
-      drawSupportBanner(3.0, 6.0, 0.3, 5, barricadeTexture[2]);
-      glPopMatrix();
-
-      // support banner
-      glPushMatrix();
-      glTranslated(-10, 0, -3);
-      drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[1]);
-      glPopMatrix();
-
-      // Circuit with barricades
-      glPushMatrix();
-      glTranslated(-15, 0, 0);
-      drawCircuit(texture, barricadeTexture, sizeof(barricadeTexture) / sizeof(barricadeTexture[0]), ferrariColors);
-      glPopMatrix();
+      // Grandstands in view
+      if (standBounds.n == 0)
+      {
+         for (int k = 0; k < NUM_STANDS; k++)
+         {
+            //  Stand bounding sphere moved to its place
+            double x = STAND_X * Cos(stand[k][2]) + STAND_Z * Sin(stand[k][2]);
+            double z = -STAND_X * Sin(stand[k][2]) + STAND_Z * Cos(stand[k][2]);
+            CullAdd(&standBounds, stand[k][0] + x, STAND_Y, stand[k][1] + z, STAND_R);
+         }
+      }
+      unsigned char standVisible[NUM_STANDS];
+      CullTest(&standBounds, standVisible);
+      for (int k = 0; k < NUM_STANDS; k++)
+      {
+         if (!standVisible[k])
+            continue;
+         glPushMatrix();
+         glTranslated(stand[k][0], 0, stand[k][1]);
+         glRotatef(stand[k][2], 0, 1, 0);
+         drawGrandStand();
+         glPopMatrix();
+      }
 
-      // start marking 1
-      glPushMatrix();
-      glTranslated(6, 0, -1);
-      squareBracketMarking();
-      glPopMatrix();
-      // car1
-      glPushMatrix();
-      glTranslated(6, 0, -1);
-      glScaled(0.2, 0.2, 0.2);
-      drawF1Car(1, 1, 1, texture, ferrariColors, 0, 0, 0);
-      glPopMatrix();
+      // Support banners and circuit with barricades (recorded once in world space)
+      if (!circuit)
+      {
+         circuit = SceneNew();
+         SceneCells(circuit, CIRCUIT_CELL);
+         glPushMatrix();
+         glLoadIdentity();
+         SceneRecord(circuit);
+
+         // support banner with textures
+         glPushMatrix();
+         glTranslated(33, 0, 20);
+         glRotatef(-90, 0, 1, 0);
+         drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[0]);
+         glPopMatrix();
+
+         // support banner with lights
+         glPushMatrix();
+         glTranslated(33, 0, 10);
+         glRotatef(-90, 0, 1, 0);
+         drawSupportBanner(3.0, 6.0, 0.3, 3, barricadeTexture[2]);
+         glPopMatrix();
+
+         // support banner with textures
+         glPushMatrix();
+         glTranslated(20, 0, -3);
+         drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[2]);
+         glPopMatrix();
+
+         // main start light
+         glPushMatrix();
+         glTranslated(12, 0, -3);
+         drawSupportBanner(3.0, 6.0, 0.3, 5, barricadeTexture[2]);
+         glPopMatrix();
+
+         // support banner
+         glPushMatrix();
+         glTranslated(-10, 0, -3);
+         drawSupportBanner(3.0, 6.0, 0.3, 4, barricadeTexture[1]);
+         glPopMatrix();
+
+         // Circuit with barricades
+         glPushMatrix();
+         glTranslated(-15, 0, 0);
+         drawCircuit(texture, barricadeTexture, sizeof(barricadeTexture) / sizeof(barricadeTexture[0]), ferrariColors);
+         glPopMatrix();
+
+         SceneFinish(circuit);
+         glPopMatrix();
+      }
+      SceneDraw(circuit);
 
-      // start marking 2
-      glPushMatrix();
-      glTranslated(4, 0, 1);
-      squareBracketMarking();
-      glPopMatrix();
+      // Starting grid markings
+      for (int k = 0; k < NUM_GRID; k++)
+      {
+         glPushMatrix();
+         glTranslated(gridSlot[k][0], 0, gridSlot[k][1]);
+         squareBracketMarking();
+         glPopMatrix();
+      }
 
       // McLaren car - moving car
-      glPushMatrix();
-      glTranslated(ferrariX, ferrariY, ferrariZ);
-      glRotated(headingAngle, 0, 1, 0); // heading direction
-      glScaled(0.2, 0.2, 0.2);
-      drawF1Car(1, 1, 1, texture, mclarenColors, steeringAngle, isBraking, carVelocity);
-      glPopMatrix();
+      grid[1].x = ferrariX;
+      grid[1].y = ferrariY;
+      grid[1].z = ferrariZ;
+      grid[1].heading = headingAngle;
+      grid[1].steering = steeringAngle;
+      grid[1].braking = isBraking;
+      grid[1].velocity = carVelocity;
 
-      // start marking 3
-      glPushMatrix();
-      glTranslated(2, 0, -1);
-      squareBracketMarking();
-      glPopMatrix();
-
-      glPushMatrix();
-      glTranslated(2, 0, -1);
-      glScaled(0.2, 0.2, 0.2);
-      drawF1Car(1, 1, 1, texture, mercedesColors, 0, 0, 0);
-      glPopMatrix();
-
-      // start marking 4
-      glPushMatrix();
-      glTranslated(0, 0, 1);
-      squareBracketMarking();
-      glPopMatrix();
-
-      glPushMatrix();
-      glTranslated(0, 0, 1);
-      glScaled(0.2, 0.2, 0.2);
-      drawF1Car(1, 1, 1, texture, redBullColors, 0, 0, 0);
-      glPopMatrix();
-
-      // start marking 5
-      glPushMatrix();
-      glTranslated(-2, 0, -1);
-      squareBracketMarking();
-      glPopMatrix();
-
-      glPushMatrix();
-      glTranslated(-2, 0, -1);
-      glScaled(0.2, 0.2, 0.2);
-      drawF1Car(1, 1, 1, texture, astonMartinColors, 0, 0, 0);
-      glPopMatrix();
+      // All cars at once
+      drawCarFleet(grid, NUM_GRID, liveries, NUM_LIVERIES, texture, 0.2);
 
       break;
    case 1:
@@ -696,16 +786,53 @@ void display(SDL_Window *window)
       break;
    }
 
+   //  Sky where the opaque scene left the depth buffer clear
+   if (mode == 0 || perspective == 2)
+      SkyDraw(dayNightMode == 0 ? mornSky : nightSky, eye, 70);
+
    // Only render rain in night mode
+   rainActive = rainTotal = 0;
    if (dayNightMode == 1)
    {
-      checkForSplashes(); // Detects ground hits
+      // Column drops are only made when first needed
+      if (rainMode == RAIN_COLUMNS && !rainDrops)
+         calculateRainPositions();
+      // Rain follows the camera
+      rainCamera();
+      if (rainMode == RAIN_PARTICLES)
+      {
+         ParticleCentre(rainParticles, rainEye[0], rainEye[2]);
+         updateRainParticles(); // Move the drops on the GPU
+         rainActive = rainTotal = rainCount;
+      }
+      else if (rainMode == RAIN_PROCEDURAL)
+         placeRainTiles(); // Skip tiles out of view
+      else
+      {
+         rainActive = rainTotal = numRainDrops;
+         if (!splashAnalytic)
+            checkForSplashes(); // Detects ground hits
+      }
+      // Uniforms every rain program shares, sent once per frame
+      ShaderShared shared;
+      shared.value[SHADER_TIME] = rainTime;
+      shared.value[SHADER_HEIGHT] = rainHeight;
+      shared.value[SHADER_POINTSCALE] = 1.0f / rainScale;
+      ShaderFrame(&shared);
+      if (rainScale > 1)
+         LowResBegin(rainScale); // Draw into a smaller target
+      if (rainOverdraw)
+         beginRainQuery();
       renderRain();       // Draw rain
       renderSplashes();   // Draw splashes
+      if (rainOverdraw)
+         endRainQuery();
+      if (rainScale > 1)
+         LowResEnd(); // Upsample over the scene
    }
 
    //  Draw axes - no lighting
-   glDisable(GL_LIGHTING);
+   StateDisable(GL_LIGHTING);
    glColor3f(1, 1, 1);
    if (axes)
    {
@@ -731,6 +858,32 @@ void display(SDL_Window *window)
    //  Print the text string
    Print("Angle=%d,%d, Perspective=%s, Mode=%s, Time=%s, Velocity=%.2f, Heading=%.1f, Steering=%.1f",
          th, ph, textPers[perspective], text[mode], textDayNight[dayNightMode], carVelocity, headingAngle, steeringAngle);
+   //  Instanced draw calls this frame
+   int instDraws, instSaved;
+   InstanceStats(&instDraws, &instSaved, 1);
+   //  Objects culled and drawn this frame
+   int culled, drawn;
+   CullStats(&culled, &drawn, 1);
+   glWindowPos2i(5, 25);
+   Print("Instanced draws=%d, Draw calls saved=%d, Culled=%d, Drawn=%d", instDraws, instSaved, culled, drawn);
+   //  State changes dropped by the state cache and textures bound this frame
+   int stateCalls, stateElided, textureBinds = StateTextureBinds();
+   StateStats(&stateCalls, &stateElided, 1);
+   glWindowPos2i(5, 45);
+   Print("State changes=%d, GL calls elided=%d, Texture binds=%d, Textures=%s %gx", stateCalls, stateElided, textureBinds,
+         texTrilinear ? "trilinear" : "bilinear", texAniso);
+   //  Rain drops drawn this frame out of what a full grid would draw
+   glWindowPos2i(5, 65);
+   Print("Rain=%s%s, Drops=%d of %d, Resolution=1/%d", textRain[rainMode], rainMode == RAIN_PROCEDURAL && rainStreaks ? " streaks" : "", rainActive, rainTotal, rainScale);
+   //  Rain fragments per pixel
+   if (rainOverdraw)
+   {
+      glWindowPos2i(5, 85);
+      if (rainStatsQuery)
+         Print("Rain fragments per pixel: shaded=%.3f, written=%.3f", rainShaded, rainWritten);
+      else
+         Print("Rain fragments per pixel: written=%.3f", rainWritten);
+   }
 
    ErrCheck("display");
    glFlush();
@@ -960,6 +1113,77 @@ int key()
    //  Toggle axes
    else if (keys[SDL_SCANCODE_Q])
       axes = 1 - axes;
+   //  Toggle engine cover profile curve
+   else if (keys[SDL_SCANCODE_B])
+      bezierDebug = 1 - bezierDebug;
+   //  Toggle adaptive engine cover subdivision
+   else if (keys[SDL_SCANCODE_V])
+      bezierAdaptive = 1 - bezierAdaptive;
+   //  Toggle splashes computed in the shader or on the CPU
+   else if (keys[SDL_SCANCODE_X])
+   {
+      splashAnalytic = 1 - splashAnalytic;
+      lastCheckTime = -1; // CPU search starts again from now
+   }
+   //  Toggle vector or scalar CPU splash search
+   else if (keys[SDL_SCANCODE_C])
+      rainSimd = 1 - rainSimd;
+   //  Cycle rain columns, GPU particles and procedural drops
+   else if (keys[SDL_SCANCODE_G] && rainModern)
+      rainMode = (rainMode + 1) % 3;
+   //  Toggle procedural drops as lines or point sprites
+   else if (keys[SDL_SCANCODE_L])
+      rainStreaks = 1 - rainStreaks;
+   //  Cycle rain drawn at full, half and quarter resolution
+   else if (keys[SDL_SCANCODE_H] && rainModern)
+      rainScale = rainScale == 4 ? 1 : 2 * rainScale;
+   //  Toggle trilinear mipmapped textures
+   else if (keys[SDL_SCANCODE_T])
+   {
+      texTrilinear = 1 - texTrilinear;
+      TexFiltering(texTrilinear, texAniso);
+   }
+   //  Cycle texture anisotropy 1x up to what the driver allows
+   else if (keys[SDL_SCANCODE_F])
+   {
+      texAniso = 2 * texAniso > TexMaxAnisotropy() ? 1 : 2 * texAniso;
+      TexFiltering(texTrilinear, texAniso);
+   }
+   //  Toggle rain overdraw measurement
+   else if (keys[SDL_SCANCODE_O])
+   {
+      rainOverdraw = 1 - rainOverdraw;
+      rainShaded = rainWritten = 0;
+   }
+   //  Fewer/more procedural drops per tile or GPU drops
+   else if (keys[SDL_SCANCODE_MINUS] && rainMode == RAIN_PROCEDURAL)
+      rainTileDrops = rainTileDrops > 50 ? rainTileDrops / 2 : 25;
+   else if (keys[SDL_SCANCODE_EQUALS] && rainMode == RAIN_PROCEDURAL)
+   {
+      int most = maxRainDrops / (RAIN_TILES * RAIN_TILES);
+      rainTileDrops = rainTileDrops < most / 2 ? rainTileDrops * 2 : most;
+   }
+   else if (keys[SDL_SCANCODE_MINUS] && rainMode == RAIN_PARTICLES)
+   {
+      rainCount = rainCount > 2000 ? rainCount / 2 : 1000;
+      ParticleCount(rainParticles, rainCount);
+   }
+   else if (keys[SDL_SCANCODE_EQUALS] && rainMode == RAIN_PARTICLES)
+   {
+      rainCount = rainCount < maxRainDrops / 2 ? rainCount * 2 : maxRainDrops;
+      ParticleCount(rainParticles, rainCount);
+   }
+   //  Wind blowing towards -x/+x
+   else if (keys[SDL_SCANCODE_COMMA] && rainParticles)
+   {
+      rainWind = rainWind > -10 ? rainWind - 1 : -10;
+      ParticleWind(rainParticles, rainWind, 0);
+   }
+   else if (keys[SDL_SCANCODE_PERIOD] && rainParticles)
+   {
+      rainWind = rainWind < 10 ? rainWind + 1 : 10;
+      ParticleWind(rainParticles, rainWind, 0);
+   }
    //  Increase/decrease light height
    else if (keys[SDL_SCANCODE_LEFTBRACKET])
       ylight -= 0.1;
@@ -1004,8 +1228,28 @@ int main(int argc, char *argv[])
    int run = 1;
    double t0 = 0;
 
+   //  Time the CPU splash search and exit
+   if (argc > 1 && !strcmp(argv[1], "-rainbench"))
+   {
+      RainBenchmark();
+      return 0;
+   }
+   //  Time the texture pixel conversions on the BMP files given and exit
+   if (argc > 1 && !strcmp(argv[1], "-pixelbench"))
+   {
+      PixelBenchmark(argc - 2, argv + 2);
+      return 0;
+   }
+   if (argc > 1 && !strcmp(argv[1], "-texcook"))
+   {
+      TexCook(argc - 2, argv + 2);
+      return 0;
+   }
+
    //  Initialize SDL
    SDL_Init(SDL_INIT_VIDEO);
+   //  Start of the time to the first frame
+   Uint64 launch = SDL_GetPerformanceCounter();
    //  Set size, resizable and double buffering
    SDL_Window *window = SDL_CreateWindow("Darshan Vijayaraghavan F1", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 600, 600, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
    if (!window)
@@ -1019,46 +1263,67 @@ int main(int argc, char *argv[])
    //  Set screen size
    reshape(window);
 
-   texture[0] = LoadTexBMP("asphalt.bmp");                      // Track texture
-   texture[1] = LoadTexBMP("concrete.bmp");                     // Building texture
-   texture[2] = LoadTexBMP("grass.bmp");                        // grass texture
-   texture[3] = LoadTexBMP("curb.bmp");                         // curb texture
-   texture[4] = LoadTexBMP("bark.bmp");                         // bark texture
-   texture[5] = LoadTexBMP("bush.bmp");                         // bush texture
-   texture[6] = LoadTexBMP("yellowside.bmp");                   // yellow side texture
-   texture[7] = LoadTexBMP("violetside.bmp");                   // violet side texture
-   texture[8] = LoadTexBMP("fireside.bmp");                     // fire side texture
-   texture[9] = LoadTexBMP("carbonFiber.bmp");                  // carbon Fibre Texture
-   texture[10] = LoadTexBMP("tireTex.bmp");                     // Tire Texture
-   texture[11] = LoadTexBMP("tireRim.bmp");                     // Tire Side Texture
-   texture[12] = LoadTexBMPTransparent("redbullBlack.bmp", 50); // logo Texture
-
-   barricadeTexture[0] = LoadTexBMP("pirelli.bmp"); // pirelli texture
-   barricadeTexture[1] = LoadTexBMP("redbull.bmp"); // redbull texture
-   barricadeTexture[2] = LoadTexBMP("nvidia.bmp");  // nvidia texture
-
-   // Day skybox
-   mornSky[0] = LoadTexBMP("pxMorn.bmp"); // right
-   mornSky[1] = LoadTexBMP("nxMorn.bmp"); // left
-   mornSky[2] = LoadTexBMP("pyMorn.bmp"); // top
-   mornSky[3] = LoadTexBMP("nyMorn.bmp"); // bottom
-   mornSky[4] = LoadTexBMP("pzMorn.bmp"); // front
-   mornSky[5] = LoadTexBMP("nzMorn.bmp"); // back
-
-   // Night skybox
-   nightSky[0] = LoadTexBMP("pxNight.bmp"); // right
-   nightSky[1] = LoadTexBMP("nxNight.bmp"); // left
-   nightSky[2] = LoadTexBMP("pyNight.bmp"); // top
-   nightSky[3] = LoadTexBMP("nyNight.bmp"); // bottom
-   nightSky[4] = LoadTexBMP("pzNight.bmp"); // front
-   nightSky[5] = LoadTexBMP("nzNight.bmp"); // back
-
-   // Initialize rain system
-   calculateRainPositions();
+   //  Textures are decoded in parallel and uploaded as each one is ready
+   TexBatch *textures = TexBatchNew();
+   TexBatchAdd(textures, "asphalt.bmp", -1, TEX_MIPMAP, &texture[0]);       // Track texture
+   TexBatchAdd(textures, "concrete.bmp", -1, TEX_MIPMAP, &texture[1]);      // Building texture
+   TexBatchAdd(textures, "grass.bmp", -1, TEX_MIPMAP, &texture[2]);         // grass texture
+   TexBatchAdd(textures, "curb.bmp", -1, TEX_MIPMAP, &texture[3]);          // curb texture
+   TexBatchAdd(textures, "bark.bmp", -1, TEX_MIPMAP, &texture[4]);          // bark texture
+   TexBatchAdd(textures, "bush.bmp", -1, TEX_MIPMAP, &texture[5]);          // bush texture
+   TexBatchAdd(textures, "yellowside.bmp", -1, TEX_MIPMAP, &texture[6]);    // yellow side texture
+   TexBatchAdd(textures, "violetside.bmp", -1, TEX_MIPMAP, &texture[7]);    // violet side texture
+   TexBatchAdd(textures, "fireside.bmp", -1, TEX_MIPMAP, &texture[8]);      // fire side texture
+   TexBatchAdd(textures, "carbonFiber.bmp", -1, TEX_MIPMAP, &texture[9]);   // carbon Fibre Texture
+   TexBatchAdd(textures, "tireTex.bmp", -1, TEX_MIPMAP, &texture[10]);      // Tire Texture
+   TexBatchAdd(textures, "tireRim.bmp", -1, TEX_MIPMAP, &texture[11]);      // Tire Side Texture
+   TexBatchAdd(textures, "redbullBlack.bmp", 50, TEX_MIPMAP, &texture[12]); // logo Texture
+
+   TexBatchAdd(textures, "pirelli.bmp", -1, TEX_MIPMAP, &barricadeTexture[0]); // pirelli texture
+   TexBatchAdd(textures, "redbull.bmp", -1, TEX_MIPMAP, &barricadeTexture[1]); // redbull texture
+   TexBatchAdd(textures, "nvidia.bmp", -1, TEX_MIPMAP, &barricadeTexture[2]);  // nvidia texture
+
+   // Day and night skyboxes, faces in cube map order (+X, -X, +Y, -Y, +Z, -Z)
+   const char *mornFaces[6] = {"pxMorn.bmp", "nxMorn.bmp", "pyMorn.bmp", "nyMorn.bmp", "pzMorn.bmp", "nzMorn.bmp"};
+   const char *nightFaces[6] = {"pxNight.bmp", "nxNight.bmp", "pyNight.bmp", "nyNight.bmp", "pzNight.bmp", "nzNight.bmp"};
+   TexBatchAddCube(textures, mornFaces, &mornSky);
+   TexBatchAddCube(textures, nightFaces, &nightSky);
+   TexBatchLoad(textures, 0);
+
+   //  Sponsor boards, team sides and the car logo share one atlas so baked
+   //  scenes draw them without switching textures
+   unsigned int decals[7] = {barricadeTexture[0], barricadeTexture[1], barricadeTexture[2],
+                             texture[6], texture[7], texture[8], texture[12]};
+   AtlasPack(decals, 7);
 
    // Create rain shader and splash shader
-   rainShader = CreateShaderProg("rain.vert", "rain.frag");
-   splashShader = CreateShaderProg("splash.vert", "splash.frag");
+   rainShader = ShaderNew("rain.vert", "rain.frag");
+   splashShader = ShaderNew("splash.vert", "splash.frag");
+   splashDropShader = ShaderNew("splashdrop.vert", "splash.frag");
+   // Drops advanced on the GPU or made up in the shader with OpenGL 3.0
+   rainModern = ParticleSupported();
+   if (rainModern)
+   {
+      rainParticles = ParticleNew(maxRainDrops, rainArea, rainHeight);
+      ParticleCount(rainParticles, rainCount);
+      rainParticleShader = ShaderReflect(ParticleShader("rainparticle.vert", "rain.frag"));
+      splashParticleShader = ShaderReflect(ParticleShader("splashparticle.vert", "splash.frag"));
+      rainProcShader = ShaderNew("rainproc.vert", "rain.frag");
+      splashProcShader = ShaderNew("rainproc.vert", "splash.frag");
+      rainStreakShader = ShaderNew("rainproc.vert", "rainline.frag");
+      // The procedural programs only differ in what they draw
+      glUseProgram(splashProcShader->id);
+      ShaderSet1i(splashProcShader, "splash", 1);
+      glUseProgram(rainStreakShader->id);
+      ShaderSet1i(rainStreakShader, "streak", 1);
+      glUseProgram(0);
+   }
+   else
+      rainMode = RAIN_COLUMNS;
+   // Queries for the rain overdraw measurement
+   const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+   rainStatsQuery = ext && strstr(ext, "GL_ARB_pipeline_statistics_query");
+   glGenQueries(2, rainQuery);
    ErrCheck("init");
 
    //  Initialize audio
@@ -1115,6 +1380,15 @@ int main(int argc, char *argv[])
       update();
       //  Display
       display(window);
+      //  Time to the first frame, with the shader cache cold or warm
+      if (launch)
+      {
+         int fromCache, fromText;
+         ShaderCacheStats(&fromCache, &fromText);
+         printf("First frame after %.0f ms, shaders: %d from cache, %d compiled\n",
+                1000.0 * (SDL_GetPerformanceCounter() - launch) / SDL_GetPerformanceFrequency(), fromCache, fromText);
+         launch = 0;
+      }
       //  Slow down display rate to about 100 fps by sleeping 5ms
       SDL_Delay(5);
    }
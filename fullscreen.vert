@@ -0,0 +1,10 @@
+#version 120
+
+// Quad covering the viewport, given in clip coordinates
+varying vec2 uv;  // 0 to 1 across the viewport
+
+void main()
+{
+    uv = gl_Vertex.xy * 0.5 + 0.5;
+    gl_Position = gl_Vertex;
+}
@@ -0,0 +1,337 @@
+//  Instanced drawing
+//
+//  An instance set draws one mesh (or an index range of a mesh) many times,
+//  each with its own model matrix, material ambient/diffuse colour, texture
+//  layer and texture coordinate rectangle (the part of an atlas it uses).
+//  When the driver has ARB_instanced_arrays and ARB_draw_instanced the
+//  whole set is a single glDrawElementsInstancedARB call through
+//  instance.vert/instance.frag, which light and fog the same way as the
+//  fixed function pipeline does with light 0.  Otherwise every instance is
+//  drawn in turn with the fixed function pipeline.
+#include "CSCIx229.h"
+
+struct InstanceSet
+{
+   const Mesh *mesh;       // mesh to draw
+   int first, count;       // index range
+   Instance *inst;         // instances
+   int n, max;             // number of instances and allocated size
+   unsigned int vbo;       // instance buffer
+   unsigned int *layerTex; // texture of each layer
+   int nlayers;            // number of layers
+   unsigned int texArray;  // texture array of the layers
+};
+
+static int supported = -1;   //  Instancing available (-1 = not checked)
+static ShaderProgram *shader; //  Instancing shader
+static int drawCalls = 0;    //  Draw calls this frame
+static int savedCalls = 0;   //  Draw calls saved by instancing this frame
+
+//
+//  Check for the extensions instancing needs
+//
+static int InstanceSupported(void)
+{
+   if (supported < 0)
+   {
+      const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+      supported = ext &&
+                  strstr(ext, "GL_ARB_instanced_arrays") &&
+                  strstr(ext, "GL_ARB_draw_instanced") &&
+                  strstr(ext, "GL_EXT_texture_array");
+      if (supported)
+         shader = ShaderNew("instance.vert", "instance.frag");
+   }
+   return supported;
+}
+
+/*
+ *  Create an empty instance set for count indices of mesh starting at first
+ */
+InstanceSet *InstanceNew(const Mesh *mesh, int first, int count)
+{
+   InstanceSet *set = (InstanceSet *)calloc(1, sizeof(InstanceSet));
+   if (!set)
+      Fatal("Cannot allocate instance set\n");
+   set->mesh = mesh;
+   set->first = first;
+   set->count = count;
+   return set;
+}
+
+/*
+ *  Delete an instance set and its buffers
+ */
+void InstanceFree(InstanceSet *set)
+{
+   if (!set)
+      return;
+   if (set->vbo)
+      glDeleteBuffers(1, &set->vbo);
+   if (set->texArray)
+      glDeleteTextures(1, &set->texArray);
+   free(set->inst);
+   free(set->layerTex);
+   free(set);
+}
+
+/*
+ *  Add an instance
+ *     matrix is the column major model matrix
+ *     layer is the index into the textures given to InstanceLayers
+ *     uv maps texture coordinates to u0 + s * du, v0 + t * dv (NULL for none)
+ */
+void InstanceAdd(InstanceSet *set, const double matrix[16], const float ambient[4], const float diffuse[4], int layer, const float uv[4])
+{
+   static const float whole[4] = {0, 0, 1, 1};
+   if (set->n == set->max)
+   {
+      set->max = set->max ? 2 * set->max : 64;
+      set->inst = (Instance *)realloc(set->inst, set->max * sizeof(Instance));
+      if (!set->inst)
+         Fatal("Cannot allocate %d instances\n", set->max);
+   }
+   Instance *inst = set->inst + set->n++;
+   double nmat[9];
+   NormalMatrix(matrix, nmat);
+   for (int k = 0; k < 16; k++)
+      inst->matrix[k] = matrix[k];
+   for (int k = 0; k < 9; k++)
+      inst->normal[k] = nmat[k];
+   memcpy(inst->ambient, ambient, sizeof(inst->ambient));
+   memcpy(inst->diffuse, diffuse, sizeof(inst->diffuse));
+   inst->layer = layer;
+   memcpy(inst->uv, uv ? uv : whole, sizeof(inst->uv));
+}
+
+/*
+ *  Remove all instances to add them again
+ */
+void InstanceClear(InstanceSet *set)
+{
+   set->n = 0;
+}
+
+/*
+ *  Set the textures selected by the instance layers
+ *     Without layers the currently bound texture (if enabled) is used
+ */
+void InstanceLayers(InstanceSet *set, const unsigned int tex[], int n)
+{
+   set->layerTex = (unsigned int *)realloc(set->layerTex, n * sizeof(unsigned int));
+   if (n && !set->layerTex)
+      Fatal("Cannot allocate %d instance layers\n", n);
+   memcpy(set->layerTex, tex, n * sizeof(unsigned int));
+   set->nlayers = n;
+}
+
+//
+//  Copy textures into the layers of a texture array
+//     Layers are scaled to the size of the largest texture
+//
+static unsigned int TextureArray(const unsigned int tex[], int n)
+{
+   int width = 0, height = 0;
+   for (int k = 0; k < n; k++)
+   {
+      int w, h;
+      StateBindTexture(tex[k]);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+      if (w > width)
+         width = w;
+      if (h > height)
+         height = h;
+   }
+
+   unsigned int array;
+   glGenTextures(1, &array);
+   glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, array);
+   glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, GL_RGBA, width, height, n, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+   unsigned char *image = (unsigned char *)malloc(4 * width * height);
+   unsigned char *scaled = (unsigned char *)malloc(4 * width * height);
+   if (!image || !scaled)
+      Fatal("Cannot allocate %dx%d texture layer\n", width, height);
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   for (int k = 0; k < n; k++)
+   {
+      int w, h;
+      StateBindTexture(tex[k]);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+      unsigned char *layer = image;
+      if (w != width || h != height)
+      {
+         gluScaleImage(GL_RGBA, w, h, GL_UNSIGNED_BYTE, image, width, height, GL_UNSIGNED_BYTE, scaled);
+         layer = scaled;
+      }
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, k, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer);
+   }
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   free(image);
+   free(scaled);
+   //  Mipmaps of every layer
+   TexFilter(GL_TEXTURE_2D_ARRAY_EXT, TEX_MIPMAP);
+   glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+   StateBindTexture(0);
+   return array;
+}
+
+/*
+ *  Copy instances (and layer textures) to the GPU
+ */
+void InstanceUpload(InstanceSet *set)
+{
+   if (!InstanceSupported())
+      return;
+   if (!set->vbo)
+      glGenBuffers(1, &set->vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, set->vbo);
+   glBufferData(GL_ARRAY_BUFFER, set->n * sizeof(Instance), set->inst, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   if (set->nlayers > 1 && !set->texArray)
+      set->texArray = TextureArray(set->layerTex, set->nlayers);
+}
+
+//
+//  Draw one instance at a time with the fixed function pipeline
+//
+static void InstanceDrawEach(const InstanceSet *set)
+{
+   for (int k = 0; k < set->n; k++)
+   {
+      const Instance *inst = set->inst + k;
+      StateMaterialfv(GL_AMBIENT, inst->ambient);
+      StateMaterialfv(GL_DIFFUSE, inst->diffuse);
+      if (set->nlayers)
+      {
+         StateEnable(GL_TEXTURE_2D);
+         StateBindTexture(set->layerTex[(int)inst->layer]);
+         glMatrixMode(GL_TEXTURE);
+         glPushMatrix();
+         glTranslatef(inst->uv[0], inst->uv[1], 0);
+         glScalef(inst->uv[2], inst->uv[3], 1);
+         glMatrixMode(GL_MODELVIEW);
+      }
+      glPushMatrix();
+      glMultMatrixf(inst->matrix);
+      MeshDrawRange(set->mesh, set->first, set->count);
+      glPopMatrix();
+      if (set->nlayers)
+      {
+         glMatrixMode(GL_TEXTURE);
+         glPopMatrix();
+         glMatrixMode(GL_MODELVIEW);
+      }
+      drawCalls++;
+   }
+}
+
+/*
+ *  Draw all instances
+ *     Specular, emission and shininess come from the current material
+ */
+void InstanceDraw(const InstanceSet *set)
+{
+   if (set->n == 0)
+      return;
+   if (!InstanceSupported())
+   {
+      InstanceDrawEach(set);
+      return;
+   }
+
+   //  Texturing: layers, the bound texture or none
+   int texMode = 0;
+   if (set->nlayers > 1)
+   {
+      //  Samplers of different types need their own texture units
+      texMode = 2;
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, set->texArray);
+      glActiveTexture(GL_TEXTURE0);
+   }
+   else if (set->nlayers == 1)
+   {
+      texMode = 1;
+      StateBindTexture(set->layerTex[0]);
+   }
+   else if (glIsEnabled(GL_TEXTURE_2D))
+      texMode = 1;
+
+   //  Fog mode of the fixed function pipeline
+   int fogMode = 0;
+   if (glIsEnabled(GL_FOG))
+   {
+      int mode;
+      glGetIntegerv(GL_FOG_MODE, &mode);
+      fogMode = mode == GL_LINEAR ? 1 : mode == GL_EXP ? 2 : 3;
+   }
+
+   glUseProgram(shader->id);
+   ShaderSet1i(shader, "texMode", texMode);
+   ShaderSet1i(shader, "fogMode", fogMode);
+   ShaderSet1i(shader, "tex", 0);
+   ShaderSet1i(shader, "texArray", 1);
+
+   //  Per instance attributes
+   int matrix = ShaderAttrib(shader, "instMatrix");
+   int normal = ShaderAttrib(shader, "instNormal");
+   int ambient = ShaderAttrib(shader, "instAmbient");
+   int diffuse = ShaderAttrib(shader, "instDiffuse");
+   int layer = ShaderAttrib(shader, "instLayer");
+   int uv = ShaderAttrib(shader, "instUV");
+   //  Matrices take one attribute per column, unused attributes are -1
+   int loc[11] = {matrix, matrix + 1, matrix + 2, matrix + 3, normal, normal + 1, normal + 2, ambient, diffuse, layer, uv};
+   int size[11] = {4, 4, 4, 4, 3, 3, 3, 4, 4, 1, 4};
+   size_t offset[11] = {0, 4, 8, 12, 16, 19, 22, 25, 29, 33, 34};
+   if (matrix < 0)
+      loc[1] = loc[2] = loc[3] = -1;
+   if (normal < 0)
+      loc[5] = loc[6] = -1;
+   MeshBind(set->mesh);
+   glBindBuffer(GL_ARRAY_BUFFER, set->vbo);
+   for (int k = 0; k < 11; k++)
+   {
+      if (loc[k] < 0)
+         continue;
+      glEnableVertexAttribArray(loc[k]);
+      glVertexAttribPointer(loc[k], size[k], GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)(offset[k] * sizeof(float)));
+      glVertexAttribDivisorARB(loc[k], 1);
+   }
+
+   glDrawElementsInstancedARB(set->mesh->prim, set->count, GL_UNSIGNED_INT, (void *)(set->first * sizeof(unsigned int)), set->n);
+   drawCalls++;
+   savedCalls += set->n - 1;
+
+   for (int k = 0; k < 11; k++)
+   {
+      if (loc[k] < 0)
+         continue;
+      glVertexAttribDivisorARB(loc[k], 0);
+      glDisableVertexAttribArray(loc[k]);
+   }
+   MeshUnbind(set->mesh);
+   if (texMode == 2)
+   {
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+      glActiveTexture(GL_TEXTURE0);
+   }
+   glUseProgram(0);
+}
+
+/*
+ *  Instanced draw calls made and draw calls saved since the last reset
+ */
+void InstanceStats(int *draws, int *saved, int reset)
+{
+   *draws = drawCalls;
+   *saved = savedCalls;
+   if (reset)
+      drawCalls = savedCalls = 0;
+}
@@ -0,0 +1,31 @@
+#version 120
+#extension GL_EXT_texture_array : enable
+
+uniform int texMode;             // 0 = none, 1 = texture, 2 = texture array
+uniform int fogMode;             // 0 = none, 1 = linear, 2 = exp, 3 = exp2
+uniform sampler2D tex;
+uniform sampler2DArray texArray;
+
+void main()
+{
+    vec4 color = gl_Color;
+
+    // Modulate by the texture
+    if (texMode == 1)
+        color *= texture2D(tex, gl_TexCoord[0].st);
+    else if (texMode == 2)
+        color *= texture2DArray(texArray, gl_TexCoord[0].stp);
+
+    // Fog
+    float c = gl_FogFragCoord;
+    float f = 1.0;
+    if (fogMode == 1)
+        f = (gl_Fog.end - c) * gl_Fog.scale;
+    else if (fogMode == 2)
+        f = exp(-gl_Fog.density * c);
+    else if (fogMode == 3)
+        f = exp(-gl_Fog.density * gl_Fog.density * c * c);
+    color.rgb = mix(gl_Fog.color.rgb, color.rgb, clamp(f, 0.0, 1.0));
+
+    gl_FragColor = color;
+}
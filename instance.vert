@@ -0,0 +1,36 @@
+#version 120
+
+// Per instance data
+attribute mat4 instMatrix;   // model matrix
+attribute mat3 instNormal;   // normal matrix of the model matrix
+attribute vec4 instAmbient;  // material ambient
+attribute vec4 instDiffuse;  // material diffuse
+attribute float instLayer;   // texture array layer
+attribute vec4 instUV;       // texture coordinates offset (xy) and scale (zw)
+
+void main()
+{
+    // Eye coordinates of the vertex and normal
+    vec4 P = gl_ModelViewMatrix * (instMatrix * gl_Vertex);
+    vec3 N = normalize(gl_NormalMatrix * (instNormal * gl_Normal));
+
+    // Same lighting as the fixed function pipeline with light 0
+    vec3 L = gl_LightSource[0].position.w == 0.0
+                 ? normalize(gl_LightSource[0].position.xyz)
+                 : normalize(gl_LightSource[0].position.xyz - P.xyz);
+    vec3 V = normalize(-P.xyz);
+    float Id = max(dot(N, L), 0.0);
+    float Is = Id > 0.0 ? pow(max(dot(N, normalize(L + V)), 0.0), gl_FrontMaterial.shininess) : 0.0;
+
+    vec4 color = gl_FrontMaterial.emission
+               + gl_LightModel.ambient * instAmbient
+               + gl_LightSource[0].ambient * instAmbient
+               + Id * gl_LightSource[0].diffuse * instDiffuse
+               + Is * gl_LightSource[0].specular * gl_FrontMaterial.specular;
+    gl_FrontColor = vec4(clamp(color.rgb, 0.0, 1.0), instDiffuse.a);
+
+    // Texture coordinates with the layer, fog distance and position
+    gl_TexCoord[0] = vec4(instUV.xy + instUV.zw * gl_MultiTexCoord0.st, instLayer, 1.0);
+    gl_FogFragCoord = abs(P.z);
+    gl_Position = gl_ProjectionMatrix * P;
+}
@@ -1,6 +1,12 @@
 //  CSCIx229 library
 //  Willem A. (Vlakkies) Schreuder
 #include "CSCIx229.h"
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 //
 //  Load texture from BMP file
@@ -20,28 +26,167 @@ static void Reverse(void *x, const int n)
    }
 }
 
+//  Image decoded from a BMP file or mapped from a cooked one, ready to upload
+typedef struct
+{
+   const unsigned char *pixels; // Level 0 and, for cooked files, the levels after it
+   unsigned int format;         // GL_BGR rows in the file, GL_RGBA or DXT1 blocks
+   unsigned int dx, dy;         // Image dimensions
+   int alpha;                   // Black pixels made transparent
+   void *map;                   // Mapped file
+   size_t size;                 // Bytes mapped
+   unsigned char *mipmaps;      // Box filtered levels 1 and up one after the other (NULL for none)
+   int levels;                  // Levels including level 0
+   int cooked;                  // Mapped from file.tex
+   size_t bytes;                // Bytes uploaded
+} BMPImage;
+
+//  Header of a cooked texture, followed by its levels largest first
+#define TEX_MAGIC 0x31584554 // TEX1
+typedef struct
+{
+   unsigned int magic;  // TEX_MAGIC in the byte order it was cooked in
+   unsigned int format; // GL_BGR, GL_RGBA or DXT1 with or without alpha
+   unsigned int dx, dy; // Size of level 0
+   unsigned int levels; // Levels stored
+   int blackThreshold;  // Colour key it was cooked with (-1 for none)
+} TexHeader;
+
 //
-//  Load texture from BMP file
+//  Bytes in a w x h level with rows padded to 4 bytes
 //
-unsigned int LoadTexBMP(const char *file)
+static size_t LevelSize(int w, int h, int bpp)
+{
+   return (size_t)((bpp * w + 3) & ~3) * h;
+}
+
+//
+//  Bytes in a w x h level in format
+//
+static size_t LevelBytes(unsigned int format, int w, int h)
+{
+   if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT)
+      return (size_t)8 * ((w + 3) / 4) * ((h + 3) / 4);
+   return LevelSize(w, h, format == GL_RGBA ? 4 : 3);
+}
+
+//
+//  Build levels 1 and up of a decoded image with a box filter
+//
+static void MipmapBMP(BMPImage *img)
 {
-   //  Open file
+   int bpp = img->alpha ? 4 : 3;
+   int w = img->dx, h = img->dy;
+   size_t size = 0;
+   img->levels = 1;
+   while (w > 1 || h > 1)
+   {
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+      size += LevelSize(w, h, bpp);
+      img->levels++;
+   }
+   if (!size)
+      return;
+   img->mipmaps = (unsigned char *)malloc(size);
+   if (!img->mipmaps)
+      Fatal("Cannot allocate %d bytes of mipmaps\n", (int)size);
+
+   const unsigned char *src = img->pixels;
+   unsigned char *dst = img->mipmaps;
+   w = img->dx;
+   h = img->dy;
+   for (int level = 1; level < img->levels; level++)
+   {
+      PixelHalve(dst, src, w, h, bpp);
+      src = dst;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+      dst += LevelSize(w, h, bpp);
+   }
+}
+
+//
+//  Map a whole file as private memory
+//
+static unsigned char *MapBMP(const char *file, size_t *size)
+{
+#ifdef _WIN32
+   //  No mmap, read the file instead
    FILE *f = fopen(file, "rb");
    if (!f)
       Fatal("Cannot open file %s\n", file);
+   fseek(f, 0, SEEK_END);
+   *size = ftell(f);
+   rewind(f);
+   void *map = malloc(*size);
+   if (!map || fread(map, *size, 1, f) != 1)
+      Fatal("Cannot read %d bytes from %s\n", (int)*size, file);
+   fclose(f);
+#else
+   int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      Fatal("Cannot open file %s\n", file);
+   struct stat st;
+   if (fstat(fd, &st))
+      Fatal("Cannot get size of %s\n", file);
+   *size = st.st_size;
+   //  Private pages are only copied if a top down image is flipped in place
+   void *map = *size ? mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+   if (map == MAP_FAILED)
+      Fatal("Cannot map %s\n", file);
+   close(fd);
+#endif
+   return (unsigned char *)map;
+}
+
+//
+//  Release a mapped file
+//
+static void UnmapBMP(void *map, size_t size)
+{
+#ifdef _WIN32
+   free(map);
+#else
+   munmap(map, size);
+#endif
+}
+
+//
+//  Copy n bytes at offset off of a mapped file
+//
+static void ReadBMP(void *x, const unsigned char *map, size_t size, size_t off, int n, const char *file)
+{
+   if (off + n > size)
+      Fatal("Cannot read header from %s\n", file);
+   memcpy(x, map + off, n);
+}
+
+//
+//  Map and check a BMP file without touching OpenGL (safe on any thread)
+//     Plain images are left in the mapped file as BGR rows for GL_BGR.
+//     A blackThreshold of 0 or more makes an RGBA copy where pixels
+//     darker than the threshold are transparent.  TEX_MIPMAP also builds
+//     the smaller levels.
+//
+static void DecodeBMP(const char *file, int blackThreshold, int filter, BMPImage *img)
+{
+   size_t size;
+   unsigned char *map = MapBMP(file, &size);
    //  Check image magic
    unsigned short magic;
-   if (fread(&magic, 2, 1, f) != 1)
-      Fatal("Cannot read magic from %s\n", file);
+   ReadBMP(&magic, map, size, 0, 2, file);
    if (magic != 0x4D42 && magic != 0x424D)
       Fatal("Image magic not BMP in %s\n", file);
    //  Read header
    unsigned int dx, dy, off, k; // Image dimensions, offset and compression
    unsigned short nbp, bpp;     // Planes and bits per pixel
-   if (fseek(f, 8, SEEK_CUR) || fread(&off, 4, 1, f) != 1 ||
-       fseek(f, 4, SEEK_CUR) || fread(&dx, 4, 1, f) != 1 || fread(&dy, 4, 1, f) != 1 ||
-       fread(&nbp, 2, 1, f) != 1 || fread(&bpp, 2, 1, f) != 1 || fread(&k, 4, 1, f) != 1)
-      Fatal("Cannot read header from %s\n", file);
+   ReadBMP(&off, map, size, 10, 4, file);
+   ReadBMP(&dx, map, size, 18, 4, file);
+   ReadBMP(&dy, map, size, 22, 4, file);
+   ReadBMP(&nbp, map, size, 26, 2, file);
+   ReadBMP(&bpp, map, size, 28, 2, file);
+   ReadBMP(&k, map, size, 30, 4, file);
    //  Reverse bytes on big endian hardware (detected by backwards magic)
    if (magic == 0x424D)
    {
@@ -52,13 +197,15 @@ unsigned int LoadTexBMP(const char *file)
       Reverse(&bpp, 2);
       Reverse(&k, 4);
    }
-   //  Check image parameters
-   unsigned int max;
-   glGetIntegerv(GL_MAX_TEXTURE_SIZE, (int *)&max);
-   if (dx < 1 || dx > max)
-      Fatal("%s image width %d out of range 1-%d\n", file, dx, max);
-   if (dy < 1 || dy > max)
-      Fatal("%s image height %d out of range 1-%d\n", file, dy, max);
+   //  Negative height means the rows are stored top down
+   int topDown = (int)dy < 0;
+   if (topDown)
+      dy = -(int)dy;
+   //  Check image parameters (the size limit is checked on upload)
+   if (dx < 1)
+      Fatal("%s image width %d out of range\n", file, dx);
+   if (dy < 1)
+      Fatal("%s image height %d out of range\n", file, dy);
    if (nbp != 1)
       Fatal("%s bit planes is not 1: %d\n", file, nbp);
    if (bpp != 24)
@@ -77,179 +224,542 @@ unsigned int LoadTexBMP(const char *file)
       Fatal("%s image height not a power of two: %d\n", file, dy);
 #endif
 
-   //  Allocate image memory
-   unsigned int size = 3 * dx * dy;
-   unsigned char *image = (unsigned char *)malloc(size);
-   if (!image)
-      Fatal("Cannot allocate %d bytes of memory for image %s\n", size, file);
-   //  Seek to and read image
-   if (fseek(f, off, SEEK_SET) || fread(image, size, 1, f) != 1)
+   //  Rows are padded to 4 bytes
+   size_t row = (3 * (size_t)dx + 3) & ~(size_t)3;
+   if (off > size || row * dy > size - off)
       Fatal("Error reading data from image %s\n", file);
-   fclose(f);
-   //  Reverse colors (BGR -> RGB)
-   for (k = 0; k < size; k += 3)
+   img->dx = dx;
+   img->dy = dy;
+   img->alpha = blackThreshold >= 0;
+   img->format = img->alpha ? GL_RGBA : GL_BGR;
+   img->map = map;
+   img->size = size;
+   img->pixels = map + off;
+   img->mipmaps = NULL;
+   img->levels = 1;
+   img->cooked = 0;
+   if (topDown)
+      PixelFlipRows(map + off, dy, row, 1);
+   if (!img->alpha)
    {
-      unsigned char temp = image[k];
-      image[k] = image[k + 2];
-      image[k + 2] = temp;
+      if (filter == TEX_MIPMAP)
+         MipmapBMP(img);
+      return;
    }
 
+   //  Allocate RGBA image (with alpha channel)
+   unsigned int sizeRGBA = 4 * dx * dy;
+   unsigned char *imageRGBA = (unsigned char *)malloc(sizeRGBA);
+   if (!imageRGBA)
+      Fatal("Cannot allocate %d bytes for RGBA image %s\n", sizeRGBA, file);
+
+   //  Convert BGR to RGBA and make black pixels transparent, a row at a time
+   for (unsigned int j = 0; j < dy; j++)
+      PixelBGRtoRGBA(imageRGBA + 4 * j * dx, map + off + j * row, dx, blackThreshold, 1);
+
+   //  The file is no longer needed
+   UnmapBMP(img->map, img->size);
+   img->map = NULL;
+   img->pixels = imageRGBA;
+   if (filter == TEX_MIPMAP)
+      MipmapBMP(img);
+}
+
+//
+//  Release the memory of a decoded image
+//
+static void FreeBMP(BMPImage *img)
+{
+   if (img->map)
+      UnmapBMP(img->map, img->size);
+   else
+      free((void *)img->pixels);
+   free(img->mipmaps);
+   img->pixels = img->mipmaps = NULL;
+   img->map = NULL;
+}
+
+//
+//  Name of the cooked texture of file.bmp, returns 0 for other files
+//
+static int CookedName(const char *file, char *cooked, size_t size)
+{
+   size_t n = strlen(file);
+   if (n < 4 || n >= size || strcmp(file + n - 4, ".bmp"))
+      return 0;
+   memcpy(cooked, file, n - 4);
+   strcpy(cooked + n - 4, ".tex");
+   return 1;
+}
+
+//
+//  Map file.tex in place of file.bmp when it is up to date and was cooked
+//  with the same colour key, returns 0 to decode the BMP file instead.
+//  DXT1 files are only used when the driver takes them (compressed).
+//
+static int MapCooked(const char *file, int blackThreshold, int filter, int compressed, BMPImage *img)
+{
+   char cooked[1024];
+   struct stat bmp, tex;
+   if (!CookedName(file, cooked, sizeof(cooked)) || stat(cooked, &tex) || (!stat(file, &bmp) && bmp.st_mtime > tex.st_mtime))
+      return 0;
+
+   size_t size;
+   unsigned char *map = MapBMP(cooked, &size);
+   TexHeader head;
+   memset(&head, 0, sizeof(head));
+   if (size >= sizeof(head))
+      memcpy(&head, map, sizeof(head));
+   int dxt = head.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || head.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+   int ok = head.magic == TEX_MAGIC && head.blackThreshold == blackThreshold && (!dxt || compressed) &&
+            (dxt || head.format == (blackThreshold >= 0 ? GL_RGBA : GL_BGR)) &&
+            head.dx >= 1 && head.dx <= 65536 && head.dy >= 1 && head.dy <= 65536 && head.levels >= 1 && head.levels <= 17;
+   //  A single level cannot be mipmapped by glGenerateMipmap when compressed
+   if (filter == TEX_MIPMAP && head.levels == 1 && (head.dx > 1 || head.dy > 1))
+      ok = 0;
+   //  Every level must be in the file
+   size_t bytes = sizeof(head);
+   for (unsigned int level = 0, w = head.dx, h = head.dy; ok && level < head.levels; level++)
+   {
+      bytes += LevelBytes(head.format, w, h);
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+   }
+   if (!ok || bytes > size)
+   {
+      UnmapBMP(map, size);
+      return 0;
+   }
+
+   img->pixels = map + sizeof(head);
+   img->format = head.format;
+   img->dx = head.dx;
+   img->dy = head.dy;
+   img->alpha = blackThreshold >= 0;
+   img->map = map;
+   img->size = size;
+   img->mipmaps = NULL;
+   img->levels = head.levels;
+   img->cooked = 1;
+   return 1;
+}
+
+//
+//  Cooked texture if there is one, the BMP file otherwise (safe on any thread)
+//
+static void DecodeTexture(const char *file, int blackThreshold, int filter, int compressed, BMPImage *img)
+{
+   if (!MapCooked(file, blackThreshold, filter, compressed, img))
+      DecodeBMP(file, blackThreshold, filter, img);
+}
+
+//
+//  Copy every level of a decoded image to target of the bound texture
+//     target is GL_TEXTURE_2D or a face of a cube map
+//
+static void UploadLevels(const char *file, GLenum target, BMPImage *img)
+{
+   //  Check image size
+   unsigned int max;
+   glGetIntegerv(target == GL_TEXTURE_2D ? GL_MAX_TEXTURE_SIZE : GL_MAX_CUBE_MAP_TEXTURE_SIZE, (int *)&max);
+   if (img->dx > max)
+      Fatal("%s image width %d out of range 1-%d\n", file, img->dx, max);
+   if (img->dy > max)
+      Fatal("%s image height %d out of range 1-%d\n", file, img->dy, max);
+
+   //  Copy image, BMP rows straight from the file are BGR padded to 4 bytes
+   int align;
+   glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   int w = img->dx, h = img->dy;
+   const unsigned char *pixels = img->pixels;
+   img->bytes = 0;
+   for (int level = 0; level < img->levels; level++)
+   {
+      size_t bytes = LevelBytes(img->format, w, h);
+      if (img->format == GL_RGBA)
+         glTexImage2D(target, level, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+      else if (img->format == GL_BGR)
+         glTexImage2D(target, level, GL_RGB, w, h, 0, GL_BGR, GL_UNSIGNED_BYTE, pixels);
+      else
+         glCompressedTexImage2D(target, level, img->format, w, h, 0, bytes, pixels);
+      img->bytes += bytes;
+      //  Next level from the box filtered levels or the cooked file
+      pixels = level || !img->mipmaps ? pixels + bytes : img->mipmaps;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+   }
+   glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+   if (glGetError())
+      Fatal("Error in glTexImage2D %s %dx%d\n", file, img->dx, img->dy);
+}
+
+//
+//  Make a texture from a decoded image and release the image (GL thread only)
+//
+static unsigned int UploadBMP(const char *file, BMPImage *img, int filter)
+{
    //  Sanity check
-   ErrCheck("LoadTexBMP");
+   ErrCheck(img->alpha ? "LoadTexBMPTransparent" : "LoadTexBMP");
    //  Generate 2D texture
    unsigned int texture;
    glGenTextures(1, &texture);
    glBindTexture(GL_TEXTURE_2D, texture);
-   //  Copy image
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, dx, dy, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-   if (glGetError())
-      Fatal("Error in glTexImage2D %s %dx%d\n", file, dx, dy);
-   //  Scale linearly when image size doesn't match
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   UploadLevels(file, GL_TEXTURE_2D, img);
+   //  Trilinear for textures that get minified, linear otherwise
+   TexFilter(GL_TEXTURE_2D, filter);
+   //  Important: Use GL_CLAMP to avoid edge artifacts with transparency
+   if (img->alpha)
+   {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+   }
 
-   //  Free image memory
-   free(image);
+   //  Release image memory
+   FreeBMP(img);
    //  Return texture name
    return texture;
 }
 
+//
+//  Copy a decoded image to a face of a cube map and release the image
+//  (GL thread only).  The first face uploaded makes the cube map.
+//
+static void UploadFace(const char *file, BMPImage *img, int face, unsigned int *texture)
+{
+   ErrCheck("LoadTexCube");
+   if (!*texture)
+   {
+      glGenTextures(1, texture);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, *texture);
+      //  Faces are only drawn near their own size, clamped so the seams do not show
+      TexFilter(GL_TEXTURE_CUBE_MAP, TEX_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+   }
+   else
+      glBindTexture(GL_TEXTURE_CUBE_MAP, *texture);
+   UploadLevels(file, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, img);
+   FreeBMP(img);
+}
+
+//
+//  Load texture from BMP file
+//
+unsigned int LoadTexBMP(const char *file)
+{
+   return LoadTexBMPFilter(file, TEX_MIPMAP);
+}
+
+//
+//  Load texture from BMP file with TEX_MIPMAP or TEX_LINEAR filtering
+//
+unsigned int LoadTexBMPFilter(const char *file, int filter)
+{
+   BMPImage img;
+   DecodeTexture(file, -1, filter, TexCompressed(), &img);
+   return UploadBMP(file, &img, filter);
+}
+
 // This function changes are AI generated
 // Load texture from BMP file and add an alpha channel
 unsigned int LoadTexBMPTransparent(const char *file, int blackThreshold)
 {
-   //  Open file
-   FILE *f = fopen(file, "rb");
-   if (!f)
-      Fatal("Cannot open file %s\n", file);
+   BMPImage img;
+   DecodeTexture(file, blackThreshold, TEX_MIPMAP, TexCompressed(), &img);
+   return UploadBMP(file, &img, TEX_MIPMAP);
+}
 
-   //  Check image magic
-   unsigned short magic;
-   if (fread(&magic, 2, 1, f) != 1)
-      Fatal("Cannot read magic from %s\n", file);
-   if (magic != 0x4D42 && magic != 0x424D)
-      Fatal("Image magic not BMP in %s\n", file);
+//
+//  Wall clock time in milliseconds
+//
+static double Milliseconds(void)
+{
+#ifdef SDL2
+   return 1000.0 * SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+#else
+   return 1000.0 * clock() / CLOCKS_PER_SEC;
+#endif
+}
 
-   //  Read header
-   unsigned int dx, dy, off, k; // Image dimensions, offset and compression
-   unsigned short nbp, bpp;     // Planes and bits per pixel
-   if (fseek(f, 8, SEEK_CUR) || fread(&off, 4, 1, f) != 1 ||
-       fseek(f, 4, SEEK_CUR) || fread(&dx, 4, 1, f) != 1 || fread(&dy, 4, 1, f) != 1 ||
-       fread(&nbp, 2, 1, f) != 1 || fread(&bpp, 2, 1, f) != 1 || fread(&k, 4, 1, f) != 1)
-      Fatal("Cannot read header from %s\n", file);
+//  A texture waiting to be loaded
+typedef struct
+{
+   const char *file;      // BMP file
+   int blackThreshold;    // -1 for no alpha channel
+   int filter;            // TEX_MIPMAP or TEX_LINEAR
+   int face;              // Cube map face (0 to 5 for +X, -X, +Y, -Y, +Z, -Z), -1 for a 2D texture
+   unsigned int *texture; // Where the texture name goes
+   BMPImage image;        // Decoded image
+   double decode, upload; // Milliseconds spent on each stage
+} TexBatchItem;
 
-   //  Reverse bytes on big endian hardware (detected by backwards magic)
-   if (magic == 0x424D)
+struct TexBatch
+{
+   TexBatchItem *item; // Textures in the order they were added
+   int n, max;         // Number and allocated size
+   int next;           // Next texture to decode
+   int *done;          // Decoded textures in the order they finished
+   int ndone;          // Number decoded
+   int compressed;     // Driver takes cooked DXT1 textures
+#ifdef SDL2
+   SDL_mutex *lock; // Guards next, done and ndone
+   SDL_cond *ready; // Signalled when a texture is decoded
+#endif
+};
+
+/*
+ *  Create an empty batch of textures to load together
+ */
+TexBatch *TexBatchNew(void)
+{
+   TexBatch *batch = (TexBatch *)calloc(1, sizeof(TexBatch));
+   if (!batch)
+      Fatal("Cannot allocate texture batch\n");
+   return batch;
+}
+
+/*
+ *  Add a BMP file to the batch, its texture name is stored in *texture by TexBatchLoad
+ *     A blackThreshold of 0 or more loads it like LoadTexBMPTransparent,
+ *     filter is TEX_MIPMAP or TEX_LINEAR
+ */
+void TexBatchAdd(TexBatch *batch, const char *file, int blackThreshold, int filter, unsigned int *texture)
+{
+   if (batch->n == batch->max)
    {
-      Reverse(&off, 4);
-      Reverse(&dx, 4);
-      Reverse(&dy, 4);
-      Reverse(&nbp, 2);
-      Reverse(&bpp, 2);
-      Reverse(&k, 4);
+      batch->max = batch->max ? 2 * batch->max : 32;
+      batch->item = (TexBatchItem *)realloc(batch->item, batch->max * sizeof(TexBatchItem));
+      if (!batch->item)
+         Fatal("Cannot allocate %d textures in batch\n", batch->max);
    }
+   TexBatchItem *item = batch->item + batch->n++;
+   memset(item, 0, sizeof(TexBatchItem));
+   item->file = file;
+   item->blackThreshold = blackThreshold;
+   item->filter = filter;
+   item->face = -1;
+   item->texture = texture;
+}
 
-   //  Check image parameters
-   unsigned int max;
-   glGetIntegerv(GL_MAX_TEXTURE_SIZE, (int *)&max);
-   if (dx < 1 || dx > max)
-      Fatal("%s image width %d out of range 1-%d\n", file, dx, max);
-   if (dy < 1 || dy > max)
-      Fatal("%s image height %d out of range 1-%d\n", file, dy, max);
-   if (nbp != 1)
-      Fatal("%s bit planes is not 1: %d\n", file, nbp);
-   if (bpp != 24)
-      Fatal("%s bits per pixel is not 24: %d\n", file, bpp);
-   if (k != 0)
-      Fatal("%s compressed files not supported\n", file);
-#ifndef GL_VERSION_2_0
-   //  OpenGL 2.0 lifts the restriction that texture size must be a power of two
-   for (k = 1; k < dx; k *= 2)
-      ;
-   if (k != dx)
-      Fatal("%s image width not a power of two: %d\n", file, dx);
-   for (k = 1; k < dy; k *= 2)
-      ;
-   if (k != dy)
-      Fatal("%s image height not a power of two: %d\n", file, dy);
+/*
+ *  Add the six faces of a cube map to the batch (+X, -X, +Y, -Y, +Z, -Z),
+ *  its texture name is stored in *texture by TexBatchLoad
+ *     Faces are filtered like TEX_LINEAR and clamped to their edges.
+ *     BMP rows go bottom up, so every face is upside down compared to the
+ *     usual top down cube map images: look them up with y negated.  That
+ *     also swaps up and down, so the +Y image goes in the -Y face and the
+ *     -Y image in the +Y face.
+ */
+void TexBatchAddCube(TexBatch *batch, const char *files[6], unsigned int *texture)
+{
+   *texture = 0;
+   for (int face = 0; face < 6; face++)
+   {
+      TexBatchAdd(batch, files[face], -1, TEX_LINEAR, texture);
+      batch->item[batch->n - 1].face = (face == 2 || face == 3) ? 5 - face : face;
+   }
+}
+
+//
+//  Decode the next texture, returns 0 when none are left
+//
+static int TexBatchDecode(TexBatch *batch)
+{
+#ifdef SDL2
+   SDL_LockMutex(batch->lock);
+#endif
+   int k = batch->next < batch->n ? batch->next++ : -1;
+#ifdef SDL2
+   SDL_UnlockMutex(batch->lock);
 #endif
+   if (k < 0)
+      return 0;
 
-   //  Allocate image memory for RGB
-   unsigned int sizeRGB = 3 * dx * dy;
-   unsigned char *imageRGB = (unsigned char *)malloc(sizeRGB);
-   if (!imageRGB)
-      Fatal("Cannot allocate %d bytes of memory for image %s\n", sizeRGB, file);
+   TexBatchItem *item = batch->item + k;
+   double t0 = Milliseconds();
+   DecodeTexture(item->file, item->blackThreshold, item->filter, batch->compressed, &item->image);
+   item->decode = Milliseconds() - t0;
 
-   //  Seek to and read image
-   if (fseek(f, off, SEEK_SET) || fread(imageRGB, sizeRGB, 1, f) != 1)
-      Fatal("Error reading data from image %s\n", file);
-   fclose(f);
+#ifdef SDL2
+   SDL_LockMutex(batch->lock);
+#endif
+   batch->done[batch->ndone++] = k;
+#ifdef SDL2
+   SDL_CondSignal(batch->ready);
+   SDL_UnlockMutex(batch->lock);
+#endif
+   return 1;
+}
+
+#ifdef SDL2
+//
+//  Worker thread decoding textures until none are left
+//
+static int TexBatchWorker(void *data)
+{
+   while (TexBatchDecode((TexBatch *)data))
+      ;
+   return 0;
+}
+#endif
+
+/*
+ *  Load every texture in the batch and free the batch
+ *     Files are decoded by up to threads worker threads (0 for one per CPU)
+ *     and uploaded on this thread as they finish.  Prints the time taken.
+ */
+void TexBatchLoad(TexBatch *batch, int threads)
+{
+   double t0 = Milliseconds();
+   batch->done = (int *)malloc(batch->n * sizeof(int));
+   if (!batch->done)
+      Fatal("Cannot allocate texture batch\n");
+   //  The workers cannot ask OpenGL
+   batch->compressed = TexCompressed();
+#ifdef SDL2
+   if (threads <= 0)
+      threads = SDL_GetCPUCount();
+   if (threads > batch->n)
+      threads = batch->n;
+   batch->lock = SDL_CreateMutex();
+   batch->ready = SDL_CreateCond();
+   SDL_Thread *worker[threads];
+   for (int k = 0; k < threads; k++)
+      worker[k] = SDL_CreateThread(TexBatchWorker, "TexBatch", batch);
+#else
+   threads = 0;
+#endif
 
-   //  Reverse colors (BGR -> RGB)
-   for (k = 0; k < sizeRGB; k += 3)
+   //  Upload in the order textures finish decoding
+   double decode = 0, upload = 0, bytes = 0;
+   int cooked = 0;
+   for (int k = 0; k < batch->n; k++)
    {
-      unsigned char temp = imageRGB[k];
-      imageRGB[k] = imageRGB[k + 2];
-      imageRGB[k + 2] = temp;
+#ifdef SDL2
+      SDL_LockMutex(batch->lock);
+      while (batch->ndone <= k)
+         SDL_CondWait(batch->ready, batch->lock);
+      SDL_UnlockMutex(batch->lock);
+#else
+      TexBatchDecode(batch);
+#endif
+      TexBatchItem *item = batch->item + batch->done[k];
+      double t1 = Milliseconds();
+      if (item->face < 0)
+         *item->texture = UploadBMP(item->file, &item->image, item->filter);
+      else
+         UploadFace(item->file, &item->image, item->face, item->texture);
+      item->upload = Milliseconds() - t1;
+      decode += item->decode;
+      upload += item->upload;
+      bytes += item->image.bytes;
+      cooked += item->image.cooked;
    }
 
-   //  Allocate RGBA image (with alpha channel)
-   unsigned int sizeRGBA = 4 * dx * dy;
-   unsigned char *imageRGBA = (unsigned char *)malloc(sizeRGBA);
-   if (!imageRGBA)
-      Fatal("Cannot allocate %d bytes for RGBA image %s\n", sizeRGBA, file);
+#ifdef SDL2
+   for (int k = 0; k < threads; k++)
+      SDL_WaitThread(worker[k], NULL);
+   SDL_DestroyCond(batch->ready);
+   SDL_DestroyMutex(batch->lock);
+#endif
+   for (int k = 0; k < batch->n; k++)
+      printf("%-20s %-6s decode %6.1f ms, upload %6.1f ms\n", batch->item[k].file, batch->item[k].image.cooked ? "cooked" : "bmp",
+             batch->item[k].decode, batch->item[k].upload);
+   printf("Loaded %d textures (%d cooked, %.1f MB) in %.1f ms with %d decode threads (decode %.1f ms, upload %.1f ms one at a time)\n",
+          batch->n, cooked, bytes / (1 << 20), Milliseconds() - t0, threads, decode, upload);
+   free(batch->done);
+   free(batch->item);
+   free(batch);
+}
 
-   //  Convert RGB to RGBA and make black pixels transparent
-   for (unsigned int i = 0; i < dx * dy; i++)
-   {
-      unsigned char r = imageRGB[i * 3 + 0];
-      unsigned char g = imageRGB[i * 3 + 1];
-      unsigned char b = imageRGB[i * 3 + 2];
+//
+//  Cook one BMP file into file.tex
+//
+static void TexCookFile(const char *file, int blackThreshold, int filter, int compress)
+{
+   char cooked[1024];
+   if (!CookedName(file, cooked, sizeof(cooked)))
+      Fatal("Cannot cook %s, not a .bmp file\n", file);
+   BMPImage img;
+   DecodeBMP(file, blackThreshold, filter, &img);
+   TexHeader head = {TEX_MAGIC, img.format, img.dx, img.dy, img.levels, blackThreshold};
+   if (compress)
+      head.format = img.alpha ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
 
-      // Copy RGB values
-      imageRGBA[i * 4 + 0] = r;
-      imageRGBA[i * 4 + 1] = g;
-      imageRGBA[i * 4 + 2] = b;
+   //  RGBA copy and DXT1 blocks of a level, big enough for level 0
+   unsigned char *rgba = NULL, *dxt = NULL;
+   if (compress)
+   {
+      rgba = (unsigned char *)malloc(4 * (size_t)img.dx * img.dy);
+      dxt = (unsigned char *)malloc(LevelBytes(head.format, img.dx, img.dy));
+      if (!rgba || !dxt)
+         Fatal("Cannot allocate %dx%d image to compress %s\n", img.dx, img.dy, file);
+   }
 
-      // Set alpha based on darkness
-      // If all RGB components are below threshold, make transparent
-      if (r <= blackThreshold && g <= blackThreshold && b <= blackThreshold)
+   FILE *f = fopen(cooked, "wb");
+   if (!f || fwrite(&head, sizeof(head), 1, f) != 1)
+      Fatal("Cannot write %s\n", cooked);
+   size_t bytes = sizeof(head);
+   const unsigned char *pixels = img.pixels;
+   int w = img.dx, h = img.dy;
+   for (int level = 0; level < img.levels; level++)
+   {
+      size_t size = LevelBytes(img.format, w, h);
+      const unsigned char *out = pixels;
+      size_t n = size;
+      if (compress)
       {
-         imageRGBA[i * 4 + 3] = 0; // Fully transparent
+         //  BGR rows padded to 4 bytes become opaque RGBA
+         if (img.format == GL_BGR)
+         {
+            for (int j = 0; j < h; j++)
+               PixelBGRtoRGBA(rgba + 4 * (size_t)j * w, pixels + j * LevelSize(w, 1, 3), w, -1, 1);
+         }
+         PixelDXT1(dxt, img.format == GL_BGR ? rgba : pixels, w, h);
+         out = dxt;
+         n = LevelBytes(head.format, w, h);
       }
-      else
+      if (fwrite(out, n, 1, f) != 1)
+         Fatal("Cannot write %s\n", cooked);
+      bytes += n;
+      pixels = level || !img.mipmaps ? pixels + size : img.mipmaps;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+   }
+   if (fclose(f))
+      Fatal("Cannot write %s\n", cooked);
+   printf("%-20s %4dx%-4d %-4s %2d levels %8d bytes\n", cooked, img.dx, img.dy,
+          compress ? "DXT1" : img.alpha ? "RGBA" : "BGR", img.levels, (int)bytes);
+   free(rgba);
+   free(dxt);
+   FreeBMP(&img);
+}
+
+/*
+ *  Cook BMP files into file.tex next to them, loaded in place of the BMP
+ *     file while it is not newer.  Options apply to the files after them:
+ *       -c     compress to DXT1 (drivers without S3TC load the BMP file)
+ *       -l     no mipmaps, for textures loaded with TEX_LINEAR
+ *       -k N   colour key, for LoadTexBMPTransparent(file, N)
+ */
+void TexCook(int argc, char *argv[])
+{
+   int compress = 0, filter = TEX_MIPMAP, blackThreshold = -1;
+   for (int k = 0; k < argc; k++)
+   {
+      if (!strcmp(argv[k], "-c"))
+         compress = 1;
+      else if (!strcmp(argv[k], "-l"))
+         filter = TEX_LINEAR;
+      else if (!strcmp(argv[k], "-k"))
       {
-         imageRGBA[i * 4 + 3] = 255; // Fully opaque
+         if (k + 1 == argc)
+            Fatal("-k needs a black threshold\n");
+         blackThreshold = atoi(argv[++k]);
       }
+      else
+         TexCookFile(argv[k], blackThreshold, filter, compress);
    }
-
-   //  Free RGB image (no longer needed)
-   free(imageRGB);
-
-   //  Sanity check
-   ErrCheck("LoadTexBMPTransparent");
-
-   //  Generate 2D texture
-   unsigned int texture;
-   glGenTextures(1, &texture);
-   glBindTexture(GL_TEXTURE_2D, texture);
-
-   //  Copy RGBA image with alpha channel
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dx, dy, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageRGBA);
-   if (glGetError())
-      Fatal("Error in glTexImage2D %s %dx%d\n", file, dx, dy);
-
-   //  Scale linearly when image size doesn't match
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-   //  Important: Use GL_CLAMP to avoid edge artifacts with transparency
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-   //  Free RGBA image memory
-   free(imageRGBA);
-
-   //  Return texture name
-   return texture;
 }
@@ -0,0 +1,175 @@
+//  Low resolution offscreen pass
+//
+//  Soft transparent effects (rain and splashes) can be drawn into a colour
+//  target 1/2 or 1/4 the size of the window.  LowResBegin copies the scene
+//  depth, keeps the nearest depth of each block of pixels as the depth of
+//  the small target and makes it the render target, cleared to transparent.
+//  Effects drawn until LowResEnd should blend colour with SRC_ALPHA,
+//  ONE_MINUS_SRC_ALPHA and alpha with ONE, ONE_MINUS_SRC_ALPHA so the target
+//  holds premultiplied colour.  LowResEnd composites the target over the
+//  window with a bilateral upsample: each pixel mixes the four nearest
+//  texels, weighted by how close their depth is to the depth of the pixel,
+//  so effects do not bleed across the edges of nearer objects.
+#include "CSCIx229.h"
+
+#define LOWRES_UNIT 2 //  First texture unit used (units 2 to 4)
+
+static unsigned int fbo = 0;        //  Framebuffer of the small target
+static unsigned int colourTex = 0;  //  Its colour
+static unsigned int depthTex = 0;   //  Its depth
+static unsigned int sceneTex = 0;   //  Depth of the scene at full resolution
+static int width, height, factor;   //  Window size and scale the textures were made for
+static int lowWidth, lowHeight;     //  Size of the small target
+static ShaderProgram *downShader;   //  Nearest depth of each block
+static ShaderProgram *upShader;     //  Bilateral upsample
+static int viewport[4];             //  Window viewport
+static float proj[3];               //  Projection matrix [10], [14] and [11]
+static float clearColour[4];        //  Clear colour of the window
+static int depthFunc;               //  Depth function of the scene
+static int window;                  //  Framebuffer the scene is drawn into
+
+//
+//  Make a nearest filtered texture
+//
+static unsigned int LowResTexture(GLenum internal, int w, int h, GLenum format, GLenum type)
+{
+   unsigned int tex;
+   glGenTextures(1, &tex);
+   glBindTexture(GL_TEXTURE_2D, tex);
+   glTexImage2D(GL_TEXTURE_2D, 0, internal, w, h, 0, format, type, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   return tex;
+}
+
+//
+//  Make the textures and framebuffer for a w x h window at scale
+//
+static void LowResSize(int w, int h, int scale)
+{
+   if (fbo && w == width && h == height && scale == factor)
+      return;
+   if (fbo)
+   {
+      glDeleteFramebuffers(1, &fbo);
+      unsigned int tex[3] = {colourTex, depthTex, sceneTex};
+      glDeleteTextures(3, tex);
+   }
+   else
+   {
+      downShader = ShaderNew("fullscreen.vert", "depthdown.frag");
+      upShader = ShaderNew("fullscreen.vert", "upsample.frag");
+   }
+   width = w;
+   height = h;
+   factor = scale;
+   lowWidth = (w + scale - 1) / scale;
+   lowHeight = (h + scale - 1) / scale;
+
+   //  Textures live on the units this pass owns, not the one the state cache tracks
+   glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT);
+   sceneTex = LowResTexture(GL_DEPTH_COMPONENT24, w, h, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+   colourTex = LowResTexture(GL_RGBA8, lowWidth, lowHeight, GL_RGBA, GL_UNSIGNED_BYTE);
+   depthTex = LowResTexture(GL_DEPTH_COMPONENT24, lowWidth, lowHeight, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glActiveTexture(GL_TEXTURE0);
+
+   glGenFramebuffers(1, &fbo);
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colourTex, 0);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTex, 0);
+   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      Fatal("Cannot create %dx%d offscreen target\n", lowWidth, lowHeight);
+   glBindFramebuffer(GL_FRAMEBUFFER, window);
+}
+
+//
+//  Draw a quad covering the viewport
+//
+static void LowResQuad(void)
+{
+   glBegin(GL_QUADS);
+   glVertex2f(-1, -1);
+   glVertex2f(+1, -1);
+   glVertex2f(+1, +1);
+   glVertex2f(-1, +1);
+   glEnd();
+}
+
+/*
+ *  Start drawing into a target 1/scale the size of the window
+ *     Call after the opaque scene is drawn
+ */
+void LowResBegin(int scale)
+{
+   float P[16];
+   glGetIntegerv(GL_VIEWPORT, viewport);
+   glGetFloatv(GL_PROJECTION_MATRIX, P);
+   glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColour);
+   glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+   glGetIntegerv(GL_FRAMEBUFFER_BINDING, &window);
+   proj[0] = P[10];
+   proj[1] = P[14];
+   proj[2] = P[11];
+   LowResSize(viewport[2], viewport[3], scale);
+
+   //  Copy the scene depth
+   glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT);
+   glBindTexture(GL_TEXTURE_2D, sceneTex);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], width, height);
+   glActiveTexture(GL_TEXTURE0);
+
+   //  Nearest depth of each block becomes the depth of the small target
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   glViewport(0, 0, lowWidth, lowHeight);
+   glUseProgram(downShader->id);
+   ShaderSet1i(downShader, "sceneDepth", LOWRES_UNIT);
+   ShaderSet1i(downShader, "scale", factor);
+   ShaderSet2f(downShader, "texel", 1.0f / width, 1.0f / height);
+   glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+   glDepthFunc(GL_ALWAYS);
+   LowResQuad();
+   glDepthFunc(depthFunc);
+   glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+   glUseProgram(0);
+
+   //  Start transparent
+   glClearColor(0, 0, 0, 0);
+   glClear(GL_COLOR_BUFFER_BIT);
+   glClearColor(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+}
+
+/*
+ *  Composite the small target over the window
+ */
+void LowResEnd(void)
+{
+   glBindFramebuffer(GL_FRAMEBUFFER, window);
+   glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+   glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT + 1);
+   glBindTexture(GL_TEXTURE_2D, colourTex);
+   glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT + 2);
+   glBindTexture(GL_TEXTURE_2D, depthTex);
+   glActiveTexture(GL_TEXTURE0);
+
+   glUseProgram(upShader->id);
+   ShaderSet1i(upShader, "sceneDepth", LOWRES_UNIT);
+   ShaderSet1i(upShader, "colour", LOWRES_UNIT + 1);
+   ShaderSet1i(upShader, "lowDepth", LOWRES_UNIT + 2);
+   ShaderSet2f(upShader, "lowSize", lowWidth, lowHeight);
+   ShaderSet2f(upShader, "scale", (float)width / (factor * lowWidth), (float)height / (factor * lowHeight));
+   ShaderSet3fv(upShader, "proj", proj);
+
+   //  Premultiplied colour over the scene, depth already tested
+   int depthTest = glIsEnabled(GL_DEPTH_TEST);
+   glDisable(GL_DEPTH_TEST);
+   StateEnable(GL_BLEND);
+   StateBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+   LowResQuad();
+   if (depthTest)
+      glEnable(GL_DEPTH_TEST);
+   glUseProgram(0);
+}
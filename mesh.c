@@ -0,0 +1,430 @@
+//  Cached meshes
+//
+//  Shapes are generated once into a vertex/index buffer pair and then
+//  drawn with a single glDrawElements call.  Meshes are built with an
+//  immediate mode style interface (MeshBegin/MeshNormal3f/MeshVertex3f/
+//  MeshEnd) so the generators read like the glBegin/glEnd code they replace.
+#include "CSCIx229.h"
+
+#define MESH_CACHE_SIZE 512 //  Hash table slots (power of two)
+
+typedef struct
+{
+   MeshKey key;
+   Mesh *mesh;
+} MeshCacheEntry;
+
+static MeshCacheEntry meshCache[MESH_CACHE_SIZE];
+static int meshCacheCount = 0;
+
+/*
+ *  Create an empty mesh
+ */
+Mesh *MeshNew(void)
+{
+   Mesh *mesh = (Mesh *)calloc(1, sizeof(Mesh));
+   if (!mesh)
+      Fatal("Cannot allocate mesh\n");
+   mesh->prim = GL_TRIANGLES;
+   mesh->normal[2] = 1;
+   mesh->nparts = 1;
+   return mesh;
+}
+
+/*
+ *  Free mesh and its buffers
+ */
+void MeshFree(Mesh *mesh)
+{
+   if (!mesh)
+      return;
+   if (mesh->vbo)
+      glDeleteBuffers(1, &mesh->vbo);
+   if (mesh->ibo)
+      glDeleteBuffers(1, &mesh->ibo);
+   free(mesh->vert);
+   free(mesh->index);
+   free(mesh);
+}
+
+//
+//  Grow arrays as needed
+//
+static void MeshReserve(Mesh *mesh, int nvert, int nindex)
+{
+   if (mesh->nvert + nvert > mesh->maxvert)
+   {
+      int n = mesh->maxvert ? 2 * mesh->maxvert : 64;
+      while (n < mesh->nvert + nvert)
+         n *= 2;
+      mesh->vert = (MeshVert *)realloc(mesh->vert, n * sizeof(MeshVert));
+      if (!mesh->vert)
+         Fatal("Cannot allocate %d mesh vertices\n", n);
+      mesh->maxvert = n;
+   }
+   if (mesh->nindex + nindex > mesh->maxindex)
+   {
+      int n = mesh->maxindex ? 2 * mesh->maxindex : 128;
+      while (n < mesh->nindex + nindex)
+         n *= 2;
+      mesh->index = (unsigned int *)realloc(mesh->index, n * sizeof(unsigned int));
+      if (!mesh->index)
+         Fatal("Cannot allocate %d mesh indices\n", n);
+      mesh->maxindex = n;
+   }
+}
+
+//
+//  Append one index
+//
+static void MeshIndex(Mesh *mesh, int k)
+{
+   mesh->index[mesh->nindex++] = mesh->first + k;
+}
+
+/*
+ *  Start a primitive (same modes as glBegin)
+ */
+void MeshBegin(Mesh *mesh, GLenum mode)
+{
+   //  Lines and triangles cannot share an index buffer
+   int lines = (mode == GL_LINES || mode == GL_LINE_STRIP || mode == GL_LINE_LOOP);
+   if (mesh->nindex == 0)
+      mesh->prim = lines ? GL_LINES : GL_TRIANGLES;
+   else if (lines != (mesh->prim == GL_LINES))
+      Fatal("Cannot mix lines and polygons in one mesh\n");
+   mesh->mode = mode;
+   mesh->first = mesh->nvert;
+}
+
+/*
+ *  Set current normal
+ */
+void MeshNormal3f(Mesh *mesh, double nx, double ny, double nz)
+{
+   mesh->normal[0] = nx;
+   mesh->normal[1] = ny;
+   mesh->normal[2] = nz;
+}
+
+/*
+ *  Set current texture coordinate
+ */
+void MeshTexCoord2f(Mesh *mesh, double s, double t)
+{
+   mesh->tex[0] = s;
+   mesh->tex[1] = t;
+}
+
+/*
+ *  Add vertex using the current normal and texture coordinate
+ */
+void MeshVertex3f(Mesh *mesh, double x, double y, double z)
+{
+   MeshReserve(mesh, 1, 0);
+   MeshVert *v = mesh->vert + mesh->nvert++;
+   v->x = x;
+   v->y = y;
+   v->z = z;
+   v->nx = mesh->normal[0];
+   v->ny = mesh->normal[1];
+   v->nz = mesh->normal[2];
+   v->s = mesh->tex[0];
+   v->t = mesh->tex[1];
+}
+
+/*
+ *  End a primitive and convert it to triangles (or line segments)
+ */
+void MeshEnd(Mesh *mesh)
+{
+   int n = mesh->nvert - mesh->first;
+   int k;
+   switch (mesh->mode)
+   {
+   case GL_TRIANGLES:
+   case GL_LINES:
+      MeshReserve(mesh, 0, n);
+      for (k = 0; k < n; k++)
+         MeshIndex(mesh, k);
+      break;
+   case GL_QUADS:
+      //  Split along the 1-3 diagonal like Mesa so interpolated lighting
+      //  and fog on large quads match glBegin(GL_QUADS)
+      MeshReserve(mesh, 0, 6 * (n / 4));
+      for (k = 0; k + 3 < n; k += 4)
+      {
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k + 1);
+         MeshIndex(mesh, k + 3);
+         MeshIndex(mesh, k + 1);
+         MeshIndex(mesh, k + 2);
+         MeshIndex(mesh, k + 3);
+      }
+      break;
+   case GL_QUAD_STRIP:
+      MeshReserve(mesh, 0, 6 * (n / 2));
+      for (k = 0; k + 3 < n; k += 2)
+      {
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k + 1);
+         MeshIndex(mesh, k + 3);
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k + 3);
+         MeshIndex(mesh, k + 2);
+      }
+      break;
+   case GL_TRIANGLE_STRIP:
+      MeshReserve(mesh, 0, 3 * n);
+      for (k = 0; k + 2 < n; k++)
+      {
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k % 2 ? k + 2 : k + 1);
+         MeshIndex(mesh, k % 2 ? k + 1 : k + 2);
+      }
+      break;
+   case GL_TRIANGLE_FAN:
+   case GL_POLYGON:
+      MeshReserve(mesh, 0, 3 * n);
+      for (k = 1; k + 1 < n; k++)
+      {
+         MeshIndex(mesh, 0);
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k + 1);
+      }
+      break;
+   case GL_LINE_STRIP:
+   case GL_LINE_LOOP:
+      MeshReserve(mesh, 0, 2 * n);
+      for (k = 0; k + 1 < n; k++)
+      {
+         MeshIndex(mesh, k);
+         MeshIndex(mesh, k + 1);
+      }
+      if (mesh->mode == GL_LINE_LOOP && n > 2)
+      {
+         MeshIndex(mesh, n - 1);
+         MeshIndex(mesh, 0);
+      }
+      break;
+   default:
+      Fatal("Unsupported mesh primitive %d\n", mesh->mode);
+   }
+}
+
+/*
+ *  Start a new part of the mesh that can be drawn separately
+ */
+void MeshPart(Mesh *mesh)
+{
+   if (mesh->nparts >= MESH_MAXPARTS)
+      Fatal("Too many mesh parts\n");
+   mesh->part[mesh->nparts++] = mesh->nindex;
+}
+
+/*
+ *  Normal matrix (inverse transpose of the upper 3x3) of a column major matrix
+ *     The columns are a1xa2, a2xa0 and a0xa1 divided by the determinant
+ */
+void NormalMatrix(const double mat[16], double nmat[9])
+{
+   const double *a0 = mat, *a1 = mat + 4, *a2 = mat + 8;
+   nmat[0] = a1[1] * a2[2] - a1[2] * a2[1];
+   nmat[1] = a1[2] * a2[0] - a1[0] * a2[2];
+   nmat[2] = a1[0] * a2[1] - a1[1] * a2[0];
+   nmat[3] = a2[1] * a0[2] - a2[2] * a0[1];
+   nmat[4] = a2[2] * a0[0] - a2[0] * a0[2];
+   nmat[5] = a2[0] * a0[1] - a2[1] * a0[0];
+   nmat[6] = a0[1] * a1[2] - a0[2] * a1[1];
+   nmat[7] = a0[2] * a1[0] - a0[0] * a1[2];
+   nmat[8] = a0[0] * a1[1] - a0[1] * a1[0];
+   double det = a0[0] * nmat[0] + a0[1] * nmat[1] + a0[2] * nmat[2];
+   for (int k = 0; k < 9; k++)
+      nmat[k] /= det;
+}
+
+/*
+ *  Append count indices of src starting at first, transformed by the
+ *  column major matrix mat.  If src has no texture coordinates tex is used.
+ */
+void MeshAppend(Mesh *mesh, const Mesh *src, int first, int count, const double mat[16], const float tex[2])
+{
+   if (count <= 0)
+      return;
+   if (mesh->nindex == 0)
+      mesh->prim = src->prim;
+   else if (mesh->prim != src->prim)
+      Fatal("Cannot mix lines and polygons in one mesh\n");
+
+   //  Only copy the vertices the range refers to
+   unsigned int lo = src->index[first];
+   unsigned int hi = lo;
+   for (int k = first; k < first + count; k++)
+   {
+      if (src->index[k] < lo)
+         lo = src->index[k];
+      if (src->index[k] > hi)
+         hi = src->index[k];
+   }
+   int n = hi - lo + 1;
+   MeshReserve(mesh, n, count);
+
+   double nmat[9];
+   NormalMatrix(mat, nmat);
+
+   int base = mesh->nvert;
+   for (int k = 0; k < n; k++)
+   {
+      const MeshVert *s = src->vert + lo + k;
+      MeshVert *v = mesh->vert + mesh->nvert++;
+      v->x = mat[0] * s->x + mat[4] * s->y + mat[8] * s->z + mat[12];
+      v->y = mat[1] * s->x + mat[5] * s->y + mat[9] * s->z + mat[13];
+      v->z = mat[2] * s->x + mat[6] * s->y + mat[10] * s->z + mat[14];
+      double nx = nmat[0] * s->nx + nmat[3] * s->ny + nmat[6] * s->nz;
+      double ny = nmat[1] * s->nx + nmat[4] * s->ny + nmat[7] * s->nz;
+      double nz = nmat[2] * s->nx + nmat[5] * s->ny + nmat[8] * s->nz;
+      double len = sqrt(nx * nx + ny * ny + nz * nz);
+      if (len > 0)
+         len = 1 / len;
+      v->nx = nx * len;
+      v->ny = ny * len;
+      v->nz = nz * len;
+      v->s = src->texCoords ? s->s : tex[0];
+      v->t = src->texCoords ? s->t : tex[1];
+   }
+   for (int k = first; k < first + count; k++)
+      mesh->index[mesh->nindex++] = base + src->index[k] - lo;
+}
+
+/*
+ *  Copy mesh to buffer objects
+ */
+void MeshUpload(Mesh *mesh)
+{
+   if (!mesh->vbo)
+      glGenBuffers(1, &mesh->vbo);
+   if (!mesh->ibo)
+      glGenBuffers(1, &mesh->ibo);
+   glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+   glBufferData(GL_ARRAY_BUFFER, mesh->nvert * sizeof(MeshVert), mesh->vert, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->nindex * sizeof(unsigned int), mesh->index, GL_STATIC_DRAW);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   //  Close the last part
+   mesh->part[mesh->nparts] = mesh->nindex;
+}
+
+/*
+ *  Bind mesh buffers and set vertex, normal and texture coordinate arrays
+ */
+void MeshBind(const Mesh *mesh)
+{
+   glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_NORMAL_ARRAY);
+   glVertexPointer(3, GL_FLOAT, sizeof(MeshVert), (void *)0);
+   glNormalPointer(GL_FLOAT, sizeof(MeshVert), (void *)(3 * sizeof(float)));
+   //  Without texture coordinates the current texture coordinate is used
+   if (mesh->texCoords)
+   {
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer(2, GL_FLOAT, sizeof(MeshVert), (void *)(6 * sizeof(float)));
+   }
+}
+
+/*
+ *  Undo MeshBind
+ */
+void MeshUnbind(const Mesh *mesh)
+{
+   if (mesh->texCoords)
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+   glDisableClientState(GL_NORMAL_ARRAY);
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+ *  Draw count indices starting at first
+ */
+void MeshDrawRange(const Mesh *mesh, int first, int count)
+{
+   if (count <= 0)
+      return;
+   //  While a scene is being recorded the mesh is baked instead of drawn
+   if (!SceneAddMesh(mesh, first, count))
+   {
+      MeshBind(mesh);
+      glDrawElements(mesh->prim, count, GL_UNSIGNED_INT, (void *)(first * sizeof(unsigned int)));
+      MeshUnbind(mesh);
+   }
+   //  Current normal and texture coordinate are undefined after drawing arrays,
+   //  so leave them as glBegin/glEnd code would for callers that rely on them
+   const MeshVert *last = mesh->vert + mesh->nvert - 1;
+   DrawNormal3f(last->nx, last->ny, last->nz);
+   if (mesh->texCoords)
+      DrawTexCoord2f(last->s, last->t);
+}
+
+/*
+ *  Draw whole mesh
+ */
+void MeshDraw(const Mesh *mesh)
+{
+   MeshDrawRange(mesh, 0, mesh->nindex);
+}
+
+/*
+ *  Draw one part of a mesh
+ */
+void MeshDrawPart(const Mesh *mesh, int part)
+{
+   MeshDrawRange(mesh, mesh->part[part], mesh->part[part + 1] - mesh->part[part]);
+}
+
+//
+//  FNV-1a hash of the key
+//
+static unsigned int MeshHash(const MeshKey *key)
+{
+   const unsigned char *p = (const unsigned char *)key;
+   unsigned int h = 2166136261u;
+   for (unsigned int k = 0; k < sizeof(MeshKey); k++)
+      h = (h ^ p[k]) * 16777619u;
+   return h;
+}
+
+/*
+ *  Look up a cached mesh
+ *     Returns NULL if the key has not been built yet
+ */
+Mesh *MeshCacheFind(const MeshKey *key)
+{
+   unsigned int k = MeshHash(key) & (MESH_CACHE_SIZE - 1);
+   while (meshCache[k].mesh)
+   {
+      if (!memcmp(&meshCache[k].key, key, sizeof(MeshKey)))
+         return meshCache[k].mesh;
+      k = (k + 1) & (MESH_CACHE_SIZE - 1);
+   }
+   return NULL;
+}
+
+/*
+ *  Add an empty mesh to the cache under key
+ */
+Mesh *MeshCacheAdd(const MeshKey *key)
+{
+   if (meshCacheCount >= MESH_CACHE_SIZE / 2)
+      Fatal("Mesh cache full\n");
+   unsigned int k = MeshHash(key) & (MESH_CACHE_SIZE - 1);
+   while (meshCache[k].mesh)
+      k = (k + 1) & (MESH_CACHE_SIZE - 1);
+   meshCache[k].key = *key;
+   meshCache[k].mesh = MeshNew();
+   meshCacheCount++;
+   return meshCache[k].mesh;
+}
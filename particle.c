@@ -0,0 +1,225 @@
+//  GPU rain particles
+//
+//  Every drop has a position, velocity and last splash kept in a buffer
+//  object.  Each frame rainupdate.vert advances the drops with transform
+//  feedback from one buffer into the other, blowing them with the wind and
+//  respawning drops that reach the ground at a random place at the top,
+//  leaving a splash behind.  The CPU never touches the drops after the
+//  buffers are created: even the first drops are spawned by the shader.
+//  Changing the number of drops only changes how many are updated and drawn.
+//  The square the drops fall on is centred on a point that can follow the
+//  camera; drops left behind wrap around to the other side.
+#include "CSCIx229.h"
+
+//  State of a drop as stored in the buffers
+typedef struct
+{
+   float pos[4];    // x, y, z, streak length
+   float vel[4];    // velocity (w unused)
+   float splash[4]; // x, z and time of the last splash (w unused)
+} Particle;
+
+struct ParticleSystem
+{
+   unsigned int buf[2]; // drop state, read from one and written to the other
+   int cur;             // buffer holding the current state
+   int max, n;          // allocated and active drops
+   float area, height;  // size of the square drops fall on and height they fall from
+   float wind[2];       // wind velocity in x and z
+   float centre[2];     // centre of the square in x and z
+   int frame;           // updates so far (seeds the random numbers)
+};
+
+static int supported = -1; //  Transform feedback available (-1 = not checked)
+static ShaderProgram *program = NULL; //  Update program
+
+//
+//  Link a program with the drop state at fixed attribute locations
+//
+static void ParticleLink(int prog)
+{
+   glBindAttribLocation(prog, 0, "dropPos");
+   glBindAttribLocation(prog, 1, "dropVel");
+   glBindAttribLocation(prog, 2, "dropSplash");
+   glLinkProgram(prog);
+   PrintProgramLog(prog);
+}
+
+/*
+ *  Check for transform feedback (OpenGL 3.0)
+ */
+int ParticleSupported(void)
+{
+   if (supported < 0)
+   {
+      const char *version = (const char *)glGetString(GL_VERSION);
+      int major = 0;
+      supported = version && sscanf(version, "%d", &major) == 1 && major >= 3;
+      if (supported)
+      {
+         const char *varyings[] = {"outPos", "outVel", "outSplash"};
+         int prog = glCreateProgram();
+         int vert = CreateShader(GL_VERTEX_SHADER, "rainupdate.vert");
+         glAttachShader(prog, vert);
+         glTransformFeedbackVaryings(prog, 3, varyings, GL_INTERLEAVED_ATTRIBS);
+         ParticleLink(prog);
+         glDeleteShader(vert);
+         program = ShaderReflect(prog);
+      }
+   }
+   return supported;
+}
+
+/*
+ *  Create a program that draws drops from their state
+ *     The shader reads attributes dropPos, dropVel and dropSplash
+ */
+int ParticleShader(char *VertFile, char *FragFile)
+{
+   int prog = glCreateProgram();
+   int vert = CreateShader(GL_VERTEX_SHADER, VertFile);
+   int frag = CreateShader(GL_FRAGMENT_SHADER, FragFile);
+   glAttachShader(prog, vert);
+   glAttachShader(prog, frag);
+   ParticleLink(prog);
+   glDeleteShader(vert);
+   glDeleteShader(frag);
+   return prog;
+}
+
+/*
+ *  Create room for max drops falling from height on a square of side area
+ */
+ParticleSystem *ParticleNew(int max, float area, float height)
+{
+   if (!ParticleSupported())
+      Fatal("Transform feedback not supported\n");
+   ParticleSystem *ps = (ParticleSystem *)calloc(1, sizeof(ParticleSystem));
+   if (!ps)
+      Fatal("Cannot allocate particle system\n");
+   ps->max = ps->n = max;
+   ps->area = area;
+   ps->height = height;
+   ps->frame = -1; //  Nothing spawned yet
+   glGenBuffers(2, ps->buf);
+   for (int k = 0; k < 2; k++)
+   {
+      glBindBuffer(GL_ARRAY_BUFFER, ps->buf[k]);
+      glBufferData(GL_ARRAY_BUFFER, max * sizeof(Particle), NULL, GL_DYNAMIC_COPY);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   return ps;
+}
+
+/*
+ *  Free the drop buffers
+ */
+void ParticleFree(ParticleSystem *ps)
+{
+   if (!ps)
+      return;
+   glDeleteBuffers(2, ps->buf);
+   free(ps);
+}
+
+/*
+ *  Set the number of active drops
+ */
+void ParticleCount(ParticleSystem *ps, int n)
+{
+   ps->n = n < 0 ? 0 : n > ps->max ? ps->max : n;
+}
+
+/*
+ *  Number of active drops
+ */
+int ParticleActive(const ParticleSystem *ps)
+{
+   return ps->n;
+}
+
+/*
+ *  Set the wind velocity
+ */
+void ParticleWind(ParticleSystem *ps, float wx, float wz)
+{
+   ps->wind[0] = wx;
+   ps->wind[1] = wz;
+}
+
+/*
+ *  Centre the square the drops fall on
+ */
+void ParticleCentre(ParticleSystem *ps, float x, float z)
+{
+   ps->centre[0] = x;
+   ps->centre[1] = z;
+}
+
+//
+//  Point the drop state attributes at a buffer
+//
+static void ParticleBind(unsigned int buf)
+{
+   glBindBuffer(GL_ARRAY_BUFFER, buf);
+   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)0);
+   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)(4 * sizeof(float)));
+   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)(8 * sizeof(float)));
+   for (int k = 0; k < 3; k++)
+      glEnableVertexAttribArray(k);
+}
+
+static void ParticleUnbind(void)
+{
+   for (int k = 0; k < 3; k++)
+      glDisableVertexAttribArray(k);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+ *  Advance the active drops dt seconds to time
+ *     The first update spawns every drop
+ */
+void ParticleUpdate(ParticleSystem *ps, float time, float dt)
+{
+   int spawn = ps->frame < 0;
+   //  Spawn all drops so ones activated later are already falling
+   int n = spawn ? ps->max : ps->n;
+   ps->frame++;
+   if (!n)
+      return;
+
+   glUseProgram(program->id);
+   ShaderSet1f(program, "time", time);
+   ShaderSet1f(program, "dt", dt);
+   ShaderSet1f(program, "area", ps->area);
+   ShaderSet1f(program, "height", ps->height);
+   ShaderSet2f(program, "wind", ps->wind[0], ps->wind[1]);
+   ShaderSet2f(program, "centre", ps->centre[0], ps->centre[1]);
+   ShaderSet1i(program, "frame", ps->frame);
+   ShaderSet1i(program, "spawn", spawn);
+
+   //  Read the current state and write the next, nothing is rasterized
+   ParticleBind(ps->buf[ps->cur]);
+   glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, ps->buf[1 - ps->cur]);
+   glEnable(GL_RASTERIZER_DISCARD);
+   glBeginTransformFeedback(GL_POINTS);
+   glDrawArrays(GL_POINTS, 0, n);
+   glEndTransformFeedback();
+   glDisable(GL_RASTERIZER_DISCARD);
+   glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+   ParticleUnbind();
+   glUseProgram(0);
+   ps->cur = 1 - ps->cur;
+}
+
+/*
+ *  Draw the active drops as points with the current program
+ *     The program should come from ParticleShader
+ */
+void ParticleDraw(const ParticleSystem *ps)
+{
+   ParticleBind(ps->buf[ps->cur]);
+   glDrawArrays(GL_POINTS, 0, ps->n);
+   ParticleUnbind();
+}
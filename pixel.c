@@ -0,0 +1,580 @@
+//  Pixel conversion kernels for the texture loaders
+//
+//  BMP files hold BGR rows.  These kernels swap them to RGB, expand them to
+//  RGBA with black pixels made transparent, and flip rows in place for
+//  images stored top down.  The x86 conversions use SSSE3 byte shuffles on 4
+//  pixels per register (8 with AVX2): each step loads 16 bytes, converts
+//  the 12 bytes of whole pixels and moves on by 12, so a store may run into
+//  the next pixel but that pixel is written again by the next step.  The
+//  x86 kernels are compiled for their own instruction set and picked at run
+//  time from what the CPU supports, so a plain build still uses them.
+//  NEON deinterleaves 16 pixels at a time.  Plain SSE2 only has the row
+//  flip.  The scalar loops give the same result and are used for the tail,
+//  without SIMD, or when selected at run time.  Halving and DXT1
+//  compression make the mipmaps and cooked textures.
+#include "CSCIx229.h"
+#include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef PIXEL_X86
+//  Byte order of 4 BGR pixels as RGB, last 4 bytes left alone
+#define PIXEL_RGB 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15
+//  4 BGR pixels as RGB with a zero byte after each one
+#define PIXEL_RGB0 2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128
+
+//  Instruction sets the CPU supports, best last
+enum {PIXEL_NONE, PIXEL_SSE2, PIXEL_SSSE3, PIXEL_AVX2};
+
+//
+//  Best instruction set of this CPU, checked once
+//
+static int PixelLevel(void)
+{
+   static int level = -1;
+   if (level < 0)
+   {
+      __builtin_cpu_init();
+      level = __builtin_cpu_supports("avx2")    ? PIXEL_AVX2
+              : __builtin_cpu_supports("ssse3") ? PIXEL_SSSE3
+              : __builtin_cpu_supports("sse2")  ? PIXEL_SSE2
+                                                : PIXEL_NONE;
+   }
+   return level;
+}
+
+//
+//  AVX2 BGR to RGB, 8 pixels from two 16 byte loads 12 bytes apart
+//     Returns the pixels done
+//
+__attribute__((target("avx2"))) static int PixelRGBAVX2(unsigned char *dst, const unsigned char *src, int n)
+{
+   const __m256i order = _mm256_setr_epi8(PIXEL_RGB, PIXEL_RGB);
+   int k = 0;
+   for (; 3 * k + 28 <= 3 * n; k += 8)
+   {
+      __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + 3 * k))),
+                                          _mm_loadu_si128((const __m128i *)(src + 3 * k + 12)), 1);
+      v = _mm256_shuffle_epi8(v, order);
+      _mm_storeu_si128((__m128i *)(dst + 3 * k), _mm256_castsi256_si128(v));
+      _mm_storeu_si128((__m128i *)(dst + 3 * k + 12), _mm256_extracti128_si256(v, 1));
+   }
+   return k;
+}
+
+//
+//  SSSE3 BGR to RGB, returns the pixels done
+//
+__attribute__((target("ssse3"))) static int PixelRGBSSSE3(unsigned char *dst, const unsigned char *src, int n)
+{
+   const __m128i order = _mm_setr_epi8(PIXEL_RGB);
+   int k = 0;
+   for (; 3 * k + 16 <= 3 * n; k += 4)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * k));
+      _mm_storeu_si128((__m128i *)(dst + 3 * k), _mm_shuffle_epi8(v, order));
+   }
+   return k;
+}
+
+//
+//  AVX2 BGR to RGBA keyed on threshold t, returns the pixels done
+//     Components above the threshold survive a saturating subtract,
+//     so a pixel is black when its whole RGB0 word becomes zero
+//
+__attribute__((target("avx2"))) static int PixelRGBAAVX2(unsigned char *dst, const unsigned char *src, int n, unsigned char t)
+{
+   const __m256i order = _mm256_setr_epi8(PIXEL_RGB0, PIXEL_RGB0);
+   const __m256i thresh = _mm256_set1_epi8((char)t);
+   const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+   int k = 0;
+   for (; 3 * k + 28 <= 3 * n; k += 8)
+   {
+      __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + 3 * k))),
+                                          _mm_loadu_si128((const __m128i *)(src + 3 * k + 12)), 1);
+      v = _mm256_shuffle_epi8(v, order);
+      __m256i black = _mm256_cmpeq_epi32(_mm256_subs_epu8(v, thresh), _mm256_setzero_si256());
+      v = _mm256_or_si256(v, _mm256_andnot_si256(black, alpha));
+      _mm256_storeu_si256((__m256i *)(dst + 4 * k), v);
+   }
+   return k;
+}
+
+//
+//  SSSE3 BGR to RGBA keyed on threshold t, returns the pixels done
+//
+__attribute__((target("ssse3"))) static int PixelRGBASSSE3(unsigned char *dst, const unsigned char *src, int n, unsigned char t)
+{
+   const __m128i order = _mm_setr_epi8(PIXEL_RGB0);
+   const __m128i thresh = _mm_set1_epi8((char)t);
+   const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+   int k = 0;
+   for (; 3 * k + 16 <= 3 * n; k += 4)
+   {
+      __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 3 * k)), order);
+      __m128i black = _mm_cmpeq_epi32(_mm_subs_epu8(v, thresh), _mm_setzero_si128());
+      v = _mm_or_si128(v, _mm_andnot_si128(black, alpha));
+      _mm_storeu_si128((__m128i *)(dst + 4 * k), v);
+   }
+   return k;
+}
+
+//
+//  AVX2 swap of two rows, returns the bytes done
+//
+__attribute__((target("avx2"))) static int PixelSwapAVX2(unsigned char *a, unsigned char *b, int rowBytes)
+{
+   int k = 0;
+   for (; k + 32 <= rowBytes; k += 32)
+   {
+      __m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+      __m256i vb = _mm256_loadu_si256((const __m256i *)(b + k));
+      _mm256_storeu_si256((__m256i *)(a + k), vb);
+      _mm256_storeu_si256((__m256i *)(b + k), va);
+   }
+   return k;
+}
+
+//
+//  SSE2 swap of two rows, returns the bytes done
+//
+__attribute__((target("sse2"))) static int PixelSwapSSE2(unsigned char *a, unsigned char *b, int rowBytes)
+{
+   int k = 0;
+   for (; k + 16 <= rowBytes; k += 16)
+   {
+      __m128i va = _mm_loadu_si128((const __m128i *)(a + k));
+      __m128i vb = _mm_loadu_si128((const __m128i *)(b + k));
+      _mm_storeu_si128((__m128i *)(a + k), vb);
+      _mm_storeu_si128((__m128i *)(b + k), va);
+   }
+   return k;
+}
+#endif
+
+//
+//  Scalar BGR to RGB of pixels first to n
+//
+static void PixelRGBScalar(unsigned char *dst, const unsigned char *src, int first, int n)
+{
+   for (int k = 3 * first; k < 3 * n; k += 3)
+   {
+      unsigned char b = src[k];
+      dst[k] = src[k + 2];
+      dst[k + 1] = src[k + 1];
+      dst[k + 2] = b;
+   }
+}
+
+//
+//  Scalar BGR to RGBA of pixels first to n
+//
+static void PixelRGBAScalar(unsigned char *dst, const unsigned char *src, int first, int n, int blackThreshold)
+{
+   for (int k = first; k < n; k++)
+   {
+      unsigned char r = src[3 * k + 2];
+      unsigned char g = src[3 * k + 1];
+      unsigned char b = src[3 * k];
+      dst[4 * k] = r;
+      dst[4 * k + 1] = g;
+      dst[4 * k + 2] = b;
+      //  Transparent when every component is at or below the threshold
+      dst[4 * k + 3] = (r <= blackThreshold && g <= blackThreshold && b <= blackThreshold) ? 0 : 255;
+   }
+}
+
+/*
+ *  Swap n BGR pixels to RGB (dst may be src)
+ *     simd selects the best vector kernel the CPU supports
+ */
+void PixelBGRtoRGB(unsigned char *dst, const unsigned char *src, int n, int simd)
+{
+   int k = 0;
+   if (simd)
+   {
+#if defined(PIXEL_X86)
+      if (PixelLevel() == PIXEL_AVX2)
+         k = PixelRGBAVX2(dst, src, n);
+      else if (PixelLevel() == PIXEL_SSSE3)
+         k = PixelRGBSSSE3(dst, src, n);
+#elif defined(__ARM_NEON)
+      for (; k + 16 <= n; k += 16)
+      {
+         uint8x16x3_t v = vld3q_u8(src + 3 * k);
+         uint8x16_t b = v.val[0];
+         v.val[0] = v.val[2];
+         v.val[2] = b;
+         vst3q_u8(dst + 3 * k, v);
+      }
+#endif
+   }
+   PixelRGBScalar(dst, src, k, n);
+}
+
+/*
+ *  Expand n BGR pixels to RGBA, transparent where every component is at or
+ *  below blackThreshold
+ *     simd selects the best vector kernel the CPU supports
+ */
+void PixelBGRtoRGBA(unsigned char *dst, const unsigned char *src, int n, int blackThreshold, int simd)
+{
+   int k = 0;
+   //  Thresholds outside 0-255 make every pixel opaque or transparent
+   if (simd && blackThreshold >= 0 && blackThreshold <= 255)
+   {
+      unsigned char t = blackThreshold;
+#if defined(PIXEL_X86)
+      if (PixelLevel() == PIXEL_AVX2)
+         k = PixelRGBAAVX2(dst, src, n, t);
+      else if (PixelLevel() == PIXEL_SSSE3)
+         k = PixelRGBASSSE3(dst, src, n, t);
+#elif defined(__ARM_NEON)
+      //  Opaque where the brightest component is above the threshold
+      const uint8x16_t thresh = vdupq_n_u8(t);
+      for (; k + 16 <= n; k += 16)
+      {
+         uint8x16x3_t v = vld3q_u8(src + 3 * k);
+         uint8x16x4_t out;
+         out.val[0] = v.val[2];
+         out.val[1] = v.val[1];
+         out.val[2] = v.val[0];
+         out.val[3] = vcgtq_u8(vmaxq_u8(vmaxq_u8(v.val[0], v.val[1]), v.val[2]), thresh);
+         vst4q_u8(dst + 4 * k, out);
+      }
+#else
+      (void)t;
+#endif
+   }
+   PixelRGBAScalar(dst, src, k, n, blackThreshold);
+}
+
+/*
+ *  Flip an image of rows rows of rowBytes bytes upside down in place
+ *     simd selects the best vector kernel the CPU supports
+ */
+void PixelFlipRows(unsigned char *image, int rows, int rowBytes, int simd)
+{
+   for (int j = 0; j < rows / 2; j++)
+   {
+      unsigned char *a = image + (size_t)j * rowBytes;
+      unsigned char *b = image + (size_t)(rows - 1 - j) * rowBytes;
+      int k = 0;
+      if (simd)
+      {
+#if defined(PIXEL_X86)
+         if (PixelLevel() == PIXEL_AVX2)
+            k = PixelSwapAVX2(a, b, rowBytes);
+         else if (PixelLevel() >= PIXEL_SSE2)
+            k = PixelSwapSSE2(a, b, rowBytes);
+#elif defined(__ARM_NEON)
+         for (; k + 16 <= rowBytes; k += 16)
+         {
+            uint8x16_t va = vld1q_u8(a + k);
+            uint8x16_t vb = vld1q_u8(b + k);
+            vst1q_u8(a + k, vb);
+            vst1q_u8(b + k, va);
+         }
+#endif
+      }
+      for (; k < rowBytes; k++)
+      {
+         unsigned char tmp = a[k];
+         a[k] = b[k];
+         b[k] = tmp;
+      }
+   }
+}
+
+/*
+ *  Halve an image of w x h pixels of bpp bytes with a 2x2 box filter
+ *     Rows of both images are padded to 4 bytes, odd sizes drop the last
+ *     row or column, dst is max(1, w/2) x max(1, h/2)
+ */
+void PixelHalve(unsigned char *dst, const unsigned char *src, int w, int h, int bpp)
+{
+   int dw = w > 1 ? w / 2 : 1, dh = h > 1 ? h / 2 : 1;
+   int srow = (bpp * w + 3) & ~3, drow = (bpp * dw + 3) & ~3;
+   //  Second pixel and row of each box (the same one at a 1 pixel edge)
+   int dx = w > 1 ? bpp : 0, dy = h > 1 ? srow : 0;
+   for (int j = 0; j < dh; j++)
+   {
+      const unsigned char *s = src + (size_t)2 * j * srow;
+      unsigned char *d = dst + (size_t)j * drow;
+      for (int i = 0; i < bpp * dw; i += bpp)
+      {
+         for (int c = 0; c < bpp; c++)
+            d[i + c] = (s[2 * i + c] + s[2 * i + dx + c] + s[2 * i + dy + c] + s[2 * i + dx + dy + c] + 2) >> 2;
+      }
+   }
+}
+
+//
+//  Colour as 5:6:5 bits
+//
+static int Pixel565(const int c[3])
+{
+   return (c[0] * 31 + 127) / 255 << 11 | (c[1] * 63 + 127) / 255 << 5 | (c[2] * 31 + 127) / 255;
+}
+
+//
+//  5:6:5 bits back to 8 bit components
+//
+static void PixelUnpack565(int v, int c[3])
+{
+   int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+   c[0] = r << 3 | r >> 2;
+   c[1] = g << 2 | g >> 4;
+   c[2] = b << 3 | b >> 2;
+}
+
+//
+//  Compress one block of 16 RGBA pixels into 8 bytes of DXT1
+//
+static void PixelDXT1Block(unsigned char *dst, const unsigned char px[16][4])
+{
+   int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+   int opaque = 0;
+   for (int k = 0; k < 16; k++)
+   {
+      if (px[k][3] < 128)
+         continue;
+      opaque++;
+      for (int c = 0; c < 3; c++)
+      {
+         if (px[k][c] < lo[c])
+            lo[c] = px[k][c];
+         if (px[k][c] > hi[c])
+            hi[c] = px[k][c];
+      }
+   }
+   //  Nothing to see: 3 colour mode with every index transparent
+   if (!opaque)
+   {
+      memset(dst, 0, 4);
+      memset(dst + 4, 0xFF, 4);
+      return;
+   }
+
+   //  End points on the diagonal of the box that follows green and blue
+   //  against red, moved in by 1/16 of the range to skip outliers
+   int cov[3] = {0, 0, 0};
+   for (int k = 0; k < 16; k++)
+   {
+      if (px[k][3] < 128)
+         continue;
+      for (int c = 1; c < 3; c++)
+         cov[c] += (2 * px[k][0] - lo[0] - hi[0]) * (2 * px[k][c] - lo[c] - hi[c]);
+   }
+   for (int c = 0; c < 3; c++)
+   {
+      if (cov[c] < 0)
+      {
+         int tmp = lo[c];
+         lo[c] = hi[c];
+         hi[c] = tmp;
+      }
+      int inset = (hi[c] - lo[c]) / 16;
+      hi[c] -= inset;
+      lo[c] += inset;
+   }
+
+   //  4 colours needs c0 > c1, 3 colours and transparent needs c0 <= c1
+   int c0 = Pixel565(hi), c1 = Pixel565(lo);
+   int four = opaque == 16 && c0 != c1;
+   if (four ? c0 < c1 : c0 > c1)
+   {
+      int tmp = c0;
+      c0 = c1;
+      c1 = tmp;
+   }
+   int pal[4][3];
+   PixelUnpack565(c0, pal[0]);
+   PixelUnpack565(c1, pal[1]);
+   for (int c = 0; c < 3; c++)
+   {
+      if (four)
+      {
+         pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+         pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+      }
+      else
+         pal[2][c] = (pal[0][c] + pal[1][c]) / 2;
+   }
+
+   //  Nearest palette colour of each pixel, 2 bits each from the first pixel up
+   unsigned int index = 0;
+   for (int k = 0; k < 16; k++)
+   {
+      int best = 3;
+      if (px[k][3] >= 128)
+      {
+         int dist = 1 << 30;
+         for (int i = 0; i < (four ? 4 : 3); i++)
+         {
+            int dr = px[k][0] - pal[i][0], dg = px[k][1] - pal[i][1], db = px[k][2] - pal[i][2];
+            int d = dr * dr + dg * dg + db * db;
+            if (d < dist)
+            {
+               dist = d;
+               best = i;
+            }
+         }
+      }
+      index |= (unsigned int)best << 2 * k;
+   }
+   unsigned char block[8] = {c0 & 0xFF, c0 >> 8, c1 & 0xFF, c1 >> 8,
+                             index & 0xFF, index >> 8 & 0xFF, index >> 16 & 0xFF, index >> 24};
+   memcpy(dst, block, 8);
+}
+
+/*
+ *  Compress a w x h RGBA image into DXT1 (BC1) blocks of 8 bytes
+ *     Pixels with alpha below 128 become transparent.  Blocks at the
+ *     right and bottom edges repeat the last column and row.
+ */
+void PixelDXT1(unsigned char *dst, const unsigned char *rgba, int w, int h)
+{
+   for (int j = 0; j < h; j += 4)
+   {
+      for (int i = 0; i < w; i += 4)
+      {
+         unsigned char px[16][4];
+         for (int k = 0; k < 16; k++)
+         {
+            int x = i + k % 4 < w ? i + k % 4 : w - 1;
+            int y = j + k / 4 < h ? j + k / 4 : h - 1;
+            memcpy(px[k], rgba + 4 * ((size_t)y * w + x), 4);
+         }
+         PixelDXT1Block(dst, px);
+         dst += 8;
+      }
+   }
+}
+
+/*
+ *  Name of the vector kernels this CPU uses
+ */
+const char *PixelKernel(void)
+{
+#if defined(PIXEL_X86)
+   const char *name[] = {"none", "SSE2 (row flip only)", "SSSE3", "AVX2"};
+   return name[PixelLevel()];
+#elif defined(__ARM_NEON)
+   return "NEON";
+#else
+   return "none";
+#endif
+}
+
+//
+//  Read the pixels of a 24 bit BMP file (NULL if it is not one)
+//
+static unsigned char *PixelReadBMP(const char *file, int *w, int *h)
+{
+   unsigned char head[54];
+   FILE *f = fopen(file, "rb");
+   if (!f)
+      return NULL;
+   unsigned char *image = NULL;
+   if (fread(head, 54, 1, f) == 1 && head[0] == 'B' && head[1] == 'M' && head[28] == 24)
+   {
+      unsigned int off = head[10] | head[11] << 8 | head[12] << 16 | (unsigned)head[13] << 24;
+      *w = (int)(head[18] | head[19] << 8 | head[20] << 16 | (unsigned)head[21] << 24);
+      *h = abs((int)(head[22] | head[23] << 8 | head[24] << 16 | (unsigned)head[25] << 24));
+      size_t size = (size_t)((3 * *w + 3) & ~3) * *h;
+      image = (unsigned char *)malloc(size);
+      if (image && (fseek(f, off, SEEK_SET) || fread(image, size, 1, f) != 1))
+      {
+         free(image);
+         image = NULL;
+      }
+   }
+   fclose(f);
+   return image;
+}
+
+/*
+ *  Time the scalar and vector pixel kernels on BMP files
+ */
+void PixelBenchmark(int nfiles, char *files[])
+{
+   const int repeat = 20;
+   const char *name[3] = {"BGR to RGB", "BGR to RGBA key", "flip rows"};
+   double bytes = 0, seconds[3][2] = {{0}};
+   int differ[3] = {0};
+
+   printf("Pixel conversion, %d passes per file, vector kernel %s\n", repeat, PixelKernel());
+   for (int f = 0; f < nfiles; f++)
+   {
+      int w, h;
+      unsigned char *image = PixelReadBMP(files[f], &w, &h);
+      if (!image)
+      {
+         printf("%s: not a 24 bit BMP, skipped\n", files[f]);
+         continue;
+      }
+      int row = (3 * w + 3) & ~3;
+      size_t size = (size_t)row * h;
+      unsigned char *out[2];
+      for (int simd = 0; simd < 2; simd++)
+      {
+         out[simd] = (unsigned char *)malloc(4 * (size_t)w * h + size);
+         if (!out[simd])
+            Fatal("Cannot allocate %d bytes for %s\n", (int)(4 * w * h + size), files[f]);
+      }
+      bytes += size;
+
+      for (int kernel = 0; kernel < 3; kernel++)
+      {
+         for (int simd = 0; simd < 2; simd++)
+         {
+            clock_t t0 = clock();
+            for (int r = 0; r < repeat; r++)
+            {
+               if (kernel == 2)
+               {
+                  if (!r)
+                     memcpy(out[simd], image, size);
+                  PixelFlipRows(out[simd], h, row, simd);
+               }
+               else
+                  for (int j = 0; j < h; j++)
+                  {
+                     if (kernel == 0)
+                        PixelBGRtoRGB(out[simd] + (size_t)j * row, image + (size_t)j * row, w, simd);
+                     else
+                        PixelBGRtoRGBA(out[simd] + 4 * (size_t)j * w, image + (size_t)j * row, w, 50, simd);
+                  }
+            }
+            seconds[kernel][simd] += (double)(clock() - t0) / CLOCKS_PER_SEC;
+         }
+         //  Only the pixels of each row, the RGB row padding is not written
+         int same = 1;
+         if (kernel == 0)
+            for (int j = 0; j < h; j++)
+               same &= !memcmp(out[0] + (size_t)j * row, out[1] + (size_t)j * row, 3 * (size_t)w);
+         else
+            same = !memcmp(out[0], out[1], kernel == 1 ? 4 * (size_t)w * h : size);
+         if (!same)
+            differ[kernel]++;
+      }
+      free(out[0]);
+      free(out[1]);
+      free(image);
+   }
+
+   double mb = repeat * bytes / 1e6;
+   printf("%.1f MB of BGR pixels\n", bytes / 1e6);
+   printf("%-16s %12s %12s %8s\n", "kernel", "scalar MB/s", "vector MB/s", "speedup");
+   for (int kernel = 0; kernel < 3; kernel++)
+      printf("%-16s %12.0f %12.0f %7.1fx%s\n", name[kernel],
+             seconds[kernel][0] > 0 ? mb / seconds[kernel][0] : 0.0,
+             seconds[kernel][1] > 0 ? mb / seconds[kernel][1] : 0.0,
+             seconds[kernel][1] > 0 ? seconds[kernel][0] / seconds[kernel][1] : 0.0,
+             differ[kernel] ? " (scalar differs)" : "");
+}
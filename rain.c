@@ -0,0 +1,278 @@
+//  CPU rain splashes
+//
+//  Drops are kept as a structure of arrays (x, z, speed and length in
+//  separate aligned float arrays) so the test for drops passing the splash
+//  height between two times can run on 8 drops at a time with AVX or 4 with
+//  SSE2.  Drops that splash are compacted from the comparison mask straight
+//  into the splash ring buffer.  The scalar loop gives the same result and
+//  is used for the tail, without SIMD, or when selected at run time.  The
+//  AVX kernel is compiled for AVX alone and only used when the CPU has it.
+#include "CSCIx229.h"
+#include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAIN_X86
+#include <immintrin.h>
+#endif
+
+#define RAIN_ALIGN 32 //  Alignment of the drop arrays (one AVX register)
+
+//
+//  Allocate an aligned float array
+//
+static float *RainArray(int n)
+{
+   void *p = NULL;
+#ifdef _WIN32
+   p = _aligned_malloc(n * sizeof(float), RAIN_ALIGN);
+#else
+   if (posix_memalign(&p, RAIN_ALIGN, n * sizeof(float)))
+      p = NULL;
+#endif
+   if (!p)
+      Fatal("Cannot allocate %d rain drops\n", n);
+   return (float *)p;
+}
+
+static void RainArrayFree(float *p)
+{
+#ifdef _WIN32
+   _aligned_free(p);
+#else
+   free(p);
+#endif
+}
+
+/*
+ *  Allocate n drops
+ */
+void RainAlloc(RainDrops *rain, int n)
+{
+   //  Round up so whole vectors can be read past the last drop
+   int size = (n + 7) & ~7;
+   rain->x = RainArray(size);
+   rain->z = RainArray(size);
+   rain->speed = RainArray(size);
+   rain->length = RainArray(size);
+   rain->n = n;
+}
+
+/*
+ *  Free the drop arrays
+ */
+void RainFree(RainDrops *rain)
+{
+   RainArrayFree(rain->x);
+   RainArrayFree(rain->z);
+   RainArrayFree(rain->speed);
+   RainArrayFree(rain->length);
+   memset(rain, 0, sizeof(RainDrops));
+}
+
+//
+//  Add a splash of drop k to the ring
+//
+static void RainSplash(const RainDrops *rain, int k, float now, SplashData ring[], int size, int *next)
+{
+   ring[*next].xPos = rain->x[k];
+   ring[*next].zPos = rain->z[k];
+   ring[*next].collisionTime = now;
+   *next = (*next + 1) % size;
+}
+
+//
+//  Distance fallen mod height
+//     Same float operations as the vector kernels so both find the same drops
+//
+static float RainMod(float f, float height, float hinv)
+{
+   return f - height * floorf(f * hinv);
+}
+
+//
+//  Drops first to last-1 one at a time
+//
+static int RainScalar(const RainDrops *rain, int first, int last, float before, float now, float height, SplashData ring[], int size, int *next)
+{
+   int hits = 0;
+   float hinv = 1 / height;
+   for (int k = first; k < last; k++)
+   {
+      float speed = rain->speed[k];
+      //  Height of the drop before and now
+      float beforeY = height - RainMod(before * speed, height, hinv);
+      float nowY = height - RainMod(now * speed, height, hinv);
+      //  Passed the splash height between the two times
+      if (beforeY > 0.5f && nowY <= 0.5f)
+      {
+         RainSplash(rain, k, now, ring, size, next);
+         hits++;
+      }
+   }
+   return hits;
+}
+
+#ifdef RAIN_X86
+//  Instruction sets the CPU supports, best last
+enum {RAIN_NONE, RAIN_SSE2, RAIN_AVX};
+
+//
+//  Best instruction set of this CPU, checked once
+//
+static int RainLevel(void)
+{
+   static int level = -1;
+   if (level < 0)
+   {
+      __builtin_cpu_init();
+      level = __builtin_cpu_supports("avx")    ? RAIN_AVX
+              : __builtin_cpu_supports("sse2") ? RAIN_SSE2
+                                               : RAIN_NONE;
+   }
+   return level;
+}
+
+//
+//  AVX search of 8 drops at a time, returns the drops done
+//     Drop falls t*speed mod height, t*speed >= 0 so truncating is floor
+//
+__attribute__((target("avx"))) static int RainAVX(const RainDrops *rain, float before, float now, float height, SplashData ring[], int size, int *next, int *hits)
+{
+   const __m256 h = _mm256_set1_ps(height);
+   const __m256 hinv = _mm256_set1_ps(1 / height);
+   const __m256 level = _mm256_set1_ps(0.5f);
+   const __m256 tb = _mm256_set1_ps(before);
+   const __m256 tn = _mm256_set1_ps(now);
+   int k = 0;
+   for (; k + 8 <= rain->n; k += 8)
+   {
+      __m256 speed = _mm256_load_ps(rain->speed + k);
+      __m256 fb = _mm256_mul_ps(tb, speed);
+      __m256 fn = _mm256_mul_ps(tn, speed);
+      fb = _mm256_sub_ps(fb, _mm256_mul_ps(h, _mm256_floor_ps(_mm256_mul_ps(fb, hinv))));
+      fn = _mm256_sub_ps(fn, _mm256_mul_ps(h, _mm256_floor_ps(_mm256_mul_ps(fn, hinv))));
+      __m256 yb = _mm256_sub_ps(h, fb);
+      __m256 yn = _mm256_sub_ps(h, fn);
+      int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(yb, level, _CMP_GT_OQ), _mm256_cmp_ps(yn, level, _CMP_LE_OQ)));
+      //  Compact the drops that splashed
+      while (mask)
+      {
+         int i = __builtin_ctz(mask);
+         RainSplash(rain, k + i, now, ring, size, next);
+         mask &= mask - 1;
+         (*hits)++;
+      }
+   }
+   return k;
+}
+
+//
+//  SSE2 search of 4 drops at a time, returns the drops done
+//
+__attribute__((target("sse2"))) static int RainSSE2(const RainDrops *rain, float before, float now, float height, SplashData ring[], int size, int *next, int *hits)
+{
+   const __m128 h = _mm_set1_ps(height);
+   const __m128 hinv = _mm_set1_ps(1 / height);
+   const __m128 level = _mm_set1_ps(0.5f);
+   const __m128 tb = _mm_set1_ps(before);
+   const __m128 tn = _mm_set1_ps(now);
+   int k = 0;
+   for (; k + 4 <= rain->n; k += 4)
+   {
+      __m128 speed = _mm_load_ps(rain->speed + k);
+      __m128 fb = _mm_mul_ps(tb, speed);
+      __m128 fn = _mm_mul_ps(tn, speed);
+      fb = _mm_sub_ps(fb, _mm_mul_ps(h, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(fb, hinv)))));
+      fn = _mm_sub_ps(fn, _mm_mul_ps(h, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(fn, hinv)))));
+      __m128 yb = _mm_sub_ps(h, fb);
+      __m128 yn = _mm_sub_ps(h, fn);
+      int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(yb, level), _mm_cmple_ps(yn, level)));
+      //  Compact the drops that splashed
+      while (mask)
+      {
+         int i = __builtin_ctz(mask);
+         RainSplash(rain, k + i, now, ring, size, next);
+         mask &= mask - 1;
+         (*hits)++;
+      }
+   }
+   return k;
+}
+#endif
+
+/*
+ *  Add a splash to the ring for every drop that passed the splash height
+ *  between before and now
+ *     simd selects the best vector kernel the CPU supports
+ *     Returns the number of splashes
+ */
+int RainSplashes(const RainDrops *rain, float before, float now, float height, SplashData ring[], int size, int *next, int simd)
+{
+   int k = 0, hits = 0;
+#ifdef RAIN_X86
+   if (simd && RainLevel() == RAIN_AVX)
+      k = RainAVX(rain, before, now, height, ring, size, next, &hits);
+   else if (simd && RainLevel() == RAIN_SSE2)
+      k = RainSSE2(rain, before, now, height, ring, size, next, &hits);
+#else
+   (void)simd;
+#endif
+   return hits + RainScalar(rain, k, rain->n, before, now, height, ring, size, next);
+}
+
+/*
+ *  Name of the vector kernel this CPU uses
+ */
+const char *RainKernel(void)
+{
+#ifdef RAIN_X86
+   const char *name[] = {"none", "SSE2", "AVX"};
+   return name[RainLevel()];
+#else
+   return "none";
+#endif
+}
+
+/*
+ *  Time the scalar and vector splash search at 7k, 100k and 1M drops
+ */
+void RainBenchmark(void)
+{
+   const int sizes[] = {7000, 100000, 1000000};
+   const int frames = 100;
+   const float height = 30;
+   int ringSize = 300;
+   SplashData *ring = (SplashData *)malloc(ringSize * sizeof(SplashData));
+   if (!ring)
+      Fatal("Cannot allocate splash ring\n");
+
+   printf("Rain splash search, %d frames, vector kernel %s\n", frames, RainKernel());
+   printf("%10s %12s %12s %8s %10s\n", "drops", "scalar ms", "vector ms", "speedup", "splashes");
+   for (int s = 0; s < 3; s++)
+   {
+      RainDrops rain;
+      RainAlloc(&rain, sizes[s]);
+      for (int k = 0; k < rain.n; k++)
+      {
+         rain.x[k] = 120 * ((float)rand() / RAND_MAX - 0.5f);
+         rain.z[k] = 120 * ((float)rand() / RAND_MAX - 0.5f);
+         rain.speed[k] = 8.0f + ((float)rand() / RAND_MAX) * 6.0f;
+         rain.length[k] = 0.2f + ((float)rand() / RAND_MAX) * 0.6f;
+      }
+
+      double ms[2];
+      int hits[2];
+      for (int simd = 0; simd < 2; simd++)
+      {
+         int next = 0;
+         hits[simd] = 0;
+         clock_t t0 = clock();
+         for (int f = 0; f < frames; f++)
+            hits[simd] += RainSplashes(&rain, 0.05f * f, 0.05f * (f + 1), height, ring, ringSize, &next, simd);
+         ms[simd] = 1000.0 * (clock() - t0) / CLOCKS_PER_SEC / frames;
+      }
+      printf("%10d %12.3f %12.3f %7.1fx %10d%s\n", rain.n, ms[0], ms[1], ms[1] > 0 ? ms[0] / ms[1] : 0.0,
+             hits[1], hits[0] == hits[1] ? "" : " (scalar differs)");
+      RainFree(&rain);
+   }
+   free(ring);
+}
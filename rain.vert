@@ -2,8 +2,9 @@
 
 attribute vec4 rainData;  // (xPos, yPos, speed, length)
 
-uniform float currTime;
+uniform float time;
 uniform float height;
+uniform float pointScale;  // pixels of the target per pixel of the window
 
 void main()
 {
@@ -13,7 +14,7 @@ void main()
     float length  = rainData.w;
 
     // Calculate fall
-    float fall = mod(currTime * speed, height);
+    float fall = mod(time * speed, height);
     float y = height - fall;
 
     // get the position
@@ -23,7 +24,7 @@ void main()
     //calculate the position of the drop
     gl_Position = gl_ModelViewProjectionMatrix * vec4(pos, 1.0);
     //get the sprite square width using pointSize
-    gl_PointSize = 30.0 + length * 50.0;
+    gl_PointSize = (30.0 + length * 50.0) * pointScale;
     // set the alpha and color, to be available for frag shader
     gl_FrontColor = vec4(1.0, 1.0, 1.0, 0.7);
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 130
+
+in float tail;  // 0 at the top of the streak, 1 at the bottom
+
+void main()
+{
+    // The line is the centre stripe of the point sprite in rain.frag,
+    // so every fragment is kept and only the top of the drop fades
+    float alpha = smoothstep(0.0, 0.4, tail) * gl_Color.a;
+
+    //output the color for the pixel
+    vec3 rainColor = vec3(0.9, 0.90, 1.0);
+    gl_FragColor = vec4(rainColor, alpha * 0.8);
+}
@@ -0,0 +1,15 @@
+#version 120
+
+attribute vec4 dropPos;  // (x, y, z, length) of the drop
+
+uniform float pointScale;  // pixels of the target per pixel of the window
+
+void main()
+{
+    // position comes from the particle state
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(dropPos.xyz, 1.0);
+    //get the sprite square width using pointSize
+    gl_PointSize = (30.0 + dropPos.w * 50.0) * pointScale;
+    // set the alpha and color, to be available for frag shader
+    gl_FrontColor = vec4(1.0, 1.0, 1.0, 0.7);
+}
@@ -0,0 +1,103 @@
+#version 130
+
+// Drops made up from gl_VertexID, drawn without any vertex buffer.
+// Speed and start of the fall belong to the drop; where it falls and its
+// length are picked again for every fall from a hash of the drop and the
+// number of falls so far.
+// The drops fill one square tile around the camera.  Drops are placed in
+// world space and wrapped into the tile, so the pattern repeats every
+// tileSize and stays put while the tiles follow the camera.  Drops further
+// from the eye are thinned out: drop k is kept while k < drops * density.
+// Drawn as lines, vertices 2k and 2k+1 are the top and bottom of the streak
+// of drop k, sized to the streak in world space instead of a point sprite.
+
+uniform float time;      // current time
+uniform float height;    // height drops fall from
+uniform float tileSize;  // width of a tile
+uniform vec2 tile;       // centre of this tile in x and z
+uniform vec3 eye;        // camera position
+uniform vec2 falloff;    // density falls from 1 at falloff.x to minDensity at falloff.y
+uniform float minDensity;
+uniform float drops;     // drops in a tile at full density
+uniform bool splash;     // draw the last splash of the drop instead of the drop
+uniform bool streak;     // draw the drop as a line
+uniform float pointScale; // pixels of the target per pixel of the window
+
+out float tail;          // 0 at the top of a streak, 1 at the bottom
+
+// Integer hash so every drop and fall gets its own random numbers
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Random number from 0 to 1
+float random(inout uint seed)
+{
+    seed = hash(seed);
+    return float(seed >> 8) / 16777216.0;
+}
+
+void main()
+{
+    int id = streak ? gl_VertexID / 2 : gl_VertexID;
+    uint seed = hash(uint(id));
+    float speed = 8.0 + random(seed) * 6.0;          // from 8 to 14 units/sec
+    float fall = time * speed + random(seed) * height; // distance fallen since time 0
+
+    // Splashes happen when the drop passes 0.5 above the ground
+    float since = mod(fall - (height - 0.5), height);
+    if (splash)
+        fall -= since;
+
+    // Place and length of this fall, wrapped into the tile
+    seed = hash(seed ^ uint(floor(fall / height)));
+    vec2 corner = tile - 0.5 * tileSize;
+    float xPos = corner.x + mod(random(seed) * tileSize - corner.x, tileSize);
+    float zPos = corner.y + mod(random(seed) * tileSize - corner.y, tileSize);
+    float length = 0.2 + random(seed) * 0.6;        // from 0.2 to 0.8 units
+
+    // Fewer drops far away
+    float density = mix(1.0, minDensity, smoothstep(falloff.x, falloff.y, distance(vec2(xPos, zPos), eye.xz)));
+    if (float(id) >= drops * density)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);  // outside the view
+        gl_PointSize = 0.0;
+        return;
+    }
+
+    if (splash)
+    {
+        float age = since / speed;
+        // if greater than 0.4, means the entire animation of it growing has completed
+        if (age > 0.4) {
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);  // outside the view
+            gl_PointSize = 0.0;
+            return;
+        }
+        // Splash generated just above ground
+        gl_Position = gl_ModelViewProjectionMatrix * vec4(xPos, 0.05, zPos, 1.0);
+        // small to big
+        float progress = age / 0.4;  // 0 to 1
+        gl_PointSize = (5.0 + progress * 30.0) * pointScale;
+        gl_FrontColor = vec4(1.0, 1.0, 1.0, 1.0 - progress);  // Fades out
+        return;
+    }
+
+    float y = height - mod(fall, height);
+    if (streak)
+    {
+        // Top of the streak trails above the drop
+        tail = float(gl_VertexID - 2 * id);
+        y += (1.0 - tail) * (0.3 + length * 1.2);
+    }
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(xPos, y, zPos, 1.0);
+    //get the sprite square width using pointSize
+    gl_PointSize = (30.0 + length * 50.0) * pointScale;
+    gl_FrontColor = vec4(1.0, 1.0, 1.0, 0.7);
+}
@@ -0,0 +1,83 @@
+#version 130
+
+in vec4 dropPos;     // (x, y, z, length) of the drop
+in vec4 dropVel;     // velocity of the drop
+in vec4 dropSplash;  // (x, z, time) of its last splash
+
+uniform float time;    // current time
+uniform float dt;      // time since the last update
+uniform float area;    // drops fall on a square area wide
+uniform vec2 centre;   // centred here in x and z
+uniform float height;  // height drops fall from
+uniform vec2 wind;     // wind velocity in x and z
+uniform int frame;     // update number, changes the random numbers
+uniform bool spawn;    // create every drop from scratch
+
+out vec4 outPos;
+out vec4 outVel;
+out vec4 outSplash;
+
+// Integer hash so every drop and update gets its own random numbers
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Random number from 0 to 1
+float random(inout uint seed)
+{
+    seed = hash(seed);
+    return float(seed >> 8) / 16777216.0;
+}
+
+// New drop at a random place at height y
+void newDrop(inout uint seed, float y)
+{
+    outPos = vec4(centre.x + (random(seed) - 0.5) * area, y,
+                  centre.y + (random(seed) - 0.5) * area,
+                  0.2 + random(seed) * 0.6);          // from 0.2 to 0.8 units
+    outVel = vec4(wind.x, -(8.0 + random(seed) * 6.0), // from 8 to 14 units/sec
+                  wind.y, 0.0);
+}
+
+void main()
+{
+    uint seed = hash(uint(gl_VertexID) ^ hash(uint(frame)));
+    gl_Position = vec4(0.0);  // nothing is rasterized
+
+    if (spawn)
+    {
+        // Spread over the whole fall so drops don't arrive together
+        newDrop(seed, 0.5 + random(seed) * height);
+        outSplash = vec4(0.0, 0.0, -999.0, 0.0);
+        return;
+    }
+
+    vec4 pos = dropPos;
+    vec4 vel = dropVel;
+    outSplash = dropSplash;
+
+    // Drag pulls the drop towards the wind
+    vel.xz += (wind - vel.xz) * min(2.0 * dt, 1.0);
+    pos.xyz += vel.xyz * dt;
+
+    if (pos.y <= 0.5)
+    {
+        // Splash where and when the drop passed 0.5 above the ground
+        float since = (0.5 - pos.y) / -vel.y;
+        outSplash = vec4(pos.xz - vel.xz * since, time - since, 0.0);
+        // Start again from the top, keeping what it fell past the splash
+        newDrop(seed, pos.y + height);
+        return;
+    }
+
+    // Drops blown or left out of the area come back in on the other side
+    pos.xz = centre + mod(pos.xz - centre + 0.5 * area, area) - 0.5 * area;
+    outPos = pos;
+    outVel = vel;
+}
@@ -0,0 +1,791 @@
+//  Baked scenes
+//
+//  Static geometry is recorded once by running the normal drawing code
+//  while a scene is recording.  Immediate mode primitives (DrawBegin/
+//  DrawVertex3f/DrawEnd) and cached meshes are flattened into world space
+//  using the current modelview matrix and merged into one vertex buffer per
+//  combination of material, texture and other render state.  Each frame the
+//  batches are drawn in state order with a single glDrawElements each.
+//
+//  Meshes drawn many times with the same state apart from material colour
+//  and texture (tires, barricades, frame boxes) are kept as instance sets
+//  instead, so the copies share one mesh and one instanced draw call.
+//
+//  A whole scene can also be drawn many times (a field of cars) with one
+//  instanced draw call per batch.  Batches recorded under a tag take their
+//  material colour from each copy so the copies can differ in colour.
+//
+//  Scenes split into cells keep a bounding sphere for every batch and
+//  instance set of a cell so the parts outside the view are not drawn.
+#include "CSCIx229.h"
+
+#define SCENE_MININSTANCES 8 //  Copies of a mesh needed to draw it instanced
+
+//  Render state that splits batches
+typedef struct
+{
+   float ambient[4], diffuse[4], specular[4], emission[4];
+   float shininess;
+   float color[4];      // only used when lighting is off
+   unsigned int texture; // 0 when texturing is off
+   int texEnv;
+   int lighting;
+   int blend, blendSrc, blendDst;
+   int offset;
+   float offsetFactor, offsetUnits;
+   float lineWidth;
+   int lines;
+   int tag;             // material replaced by copies (0 = none)
+   int cell;            // cell of the geometry (see SceneCells)
+} SceneState;
+
+typedef struct
+{
+   SceneState state;
+   Mesh *mesh;
+   int order;           // order of first use while recording
+   InstanceSet *copies; // copies drawn by SceneDrawCopies
+} SceneBatch;
+
+//  Mesh draw waiting to be merged or instanced
+typedef struct
+{
+   const Mesh *mesh;
+   int first, count;
+   SceneState state;
+   double matrix[16];
+   float tex[2];
+   float uv[4];         // part of the atlas its texture is in
+   int order;
+} SceneMesh;
+
+typedef struct
+{
+   SceneState state; // state without material colour and texture
+   InstanceSet *set;
+   float box[6];     // bounds of all instances
+} SceneInstances;
+
+struct Scene
+{
+   SceneBatch *batch;   // batches sorted by state
+   int nbatch, maxbatch;
+   SceneInstances *inst; // instanced meshes
+   int ninst;
+   SceneMesh *pending;  // mesh draws while recording
+   int npending, maxpending;
+   int merge;           // merge repeated meshes instead of instancing them
+   double cellSize;     // size of the cells batches are split into (0 = none)
+   CullBounds bounds;   // bounding spheres of batches then instance sets
+   unsigned char *visible; // batches and instance sets in view
+   SceneState final;    // state left behind by the recorded drawing
+   float normal[3];     // current normal left behind
+   float tex[2];        // current texture coordinate left behind
+};
+
+static Scene *recording = NULL; //  Scene being recorded
+static Mesh *prim = NULL;       //  Immediate mode primitive being recorded
+static int tag = 0;             //  Tag of the drawing being recorded
+
+//
+//  Read the current render state
+//
+static void SceneQuery(SceneState *state, int lines)
+{
+   int val;
+   memset(state, 0, sizeof(SceneState));
+   glGetMaterialfv(GL_FRONT, GL_AMBIENT, state->ambient);
+   glGetMaterialfv(GL_FRONT, GL_DIFFUSE, state->diffuse);
+   glGetMaterialfv(GL_FRONT, GL_SPECULAR, state->specular);
+   glGetMaterialfv(GL_FRONT, GL_EMISSION, state->emission);
+   glGetMaterialfv(GL_FRONT, GL_SHININESS, &state->shininess);
+   state->lighting = glIsEnabled(GL_LIGHTING);
+   //  Without color material the color only matters when unlit
+   if (!state->lighting)
+      glGetFloatv(GL_CURRENT_COLOR, state->color);
+   state->texEnv = GL_MODULATE;
+   if (glIsEnabled(GL_TEXTURE_2D))
+   {
+      glGetIntegerv(GL_TEXTURE_BINDING_2D, &val);
+      state->texture = val;
+      glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &state->texEnv);
+   }
+   state->blend = glIsEnabled(GL_BLEND);
+   if (state->blend)
+   {
+      glGetIntegerv(GL_BLEND_SRC, &state->blendSrc);
+      glGetIntegerv(GL_BLEND_DST, &state->blendDst);
+   }
+   state->offset = glIsEnabled(GL_POLYGON_OFFSET_FILL);
+   if (state->offset)
+   {
+      glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &state->offsetFactor);
+      glGetFloatv(GL_POLYGON_OFFSET_UNITS, &state->offsetUnits);
+   }
+   state->lineWidth = 1;
+   state->lines = lines;
+   if (lines)
+      glGetFloatv(GL_LINE_WIDTH, &state->lineWidth);
+   state->tag = tag;
+}
+
+//
+//  Grow a bounding box (xmin,ymin,zmin,xmax,ymax,zmax) by count indices of
+//  a mesh transformed by mat
+//
+static void SceneBox(float box[6], const Mesh *mesh, int first, int count, const double mat[16])
+{
+   for (int k = first; k < first + count; k++)
+   {
+      const MeshVert *v = mesh->vert + mesh->index[k];
+      float p[3];
+      for (int i = 0; i < 3; i++)
+         p[i] = mat[i] * v->x + mat[4 + i] * v->y + mat[8 + i] * v->z + mat[12 + i];
+      for (int i = 0; i < 3; i++)
+      {
+         if (p[i] < box[i])
+            box[i] = p[i];
+         if (p[i] > box[3 + i])
+            box[3 + i] = p[i];
+      }
+   }
+}
+
+//
+//  Empty bounding box
+//
+static void SceneBoxEmpty(float box[6])
+{
+   box[0] = box[1] = box[2] = 1e30;
+   box[3] = box[4] = box[5] = -1e30;
+}
+
+//
+//  Cell of the centre of count indices of a mesh transformed by mat
+//
+static int SceneCell(const Mesh *mesh, int first, int count, const double mat[16])
+{
+   float box[6];
+   SceneBoxEmpty(box);
+   SceneBox(box, mesh, first, count, mat);
+   int i = (int)floor(0.5 * (box[0] + box[3]) / recording->cellSize);
+   int k = (int)floor(0.5 * (box[2] + box[5]) / recording->cellSize);
+   return 1024 * i + k;
+}
+
+//
+//  Can drawing with this state be instanced
+//     Only lit, opaque, modulated triangles
+//
+static int SceneInstanced(const SceneState *state)
+{
+   return !state->lines && !state->blend && state->lighting && state->texEnv == GL_MODULATE;
+}
+
+//
+//  Set render state
+//
+static void SceneApply(const SceneState *state)
+{
+   StateMaterialfv(GL_AMBIENT, state->ambient);
+   StateMaterialfv(GL_DIFFUSE, state->diffuse);
+   StateMaterialfv(GL_SPECULAR, state->specular);
+   StateMaterialfv(GL_EMISSION, state->emission);
+   StateMaterialf(GL_SHININESS, state->shininess);
+   if (state->lighting)
+      StateEnable(GL_LIGHTING);
+   else
+   {
+      StateDisable(GL_LIGHTING);
+      glColor4fv(state->color);
+   }
+   if (state->texture)
+   {
+      StateEnable(GL_TEXTURE_2D);
+      StateBindTexture(state->texture);
+   }
+   else
+      StateDisable(GL_TEXTURE_2D);
+   StateTexEnv(state->texEnv);
+   if (state->blend)
+   {
+      StateEnable(GL_BLEND);
+      StateBlendFunc(state->blendSrc, state->blendDst);
+   }
+   else
+      StateDisable(GL_BLEND);
+   if (state->offset)
+   {
+      StateEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(state->offsetFactor, state->offsetUnits);
+   }
+   else
+      StateDisable(GL_POLYGON_OFFSET_FILL);
+   glLineWidth(state->lineWidth);
+}
+
+//
+//  Draw a texture packed into the atlas from the atlas
+//     Only when count indices of mesh keep their texture coordinates (or
+//     tex without them) within 0 to 1.  uv is the part of the atlas the
+//     texture is in, the whole texture if it stays as it is.
+//
+static void SceneAtlas(SceneState *state, const Mesh *mesh, int first, int count, const float tex[2], float uv[4])
+{
+   static const float whole[4] = {0, 0, 1, 1};
+   memcpy(uv, whole, sizeof(whole));
+   float rect[4];
+   unsigned int atlas = state->texture ? AtlasRect(state->texture, rect) : 0;
+   if (!atlas)
+      return;
+   for (int k = first; k < first + count; k++)
+   {
+      const MeshVert *v = mesh->vert + mesh->index[k];
+      float s = mesh->texCoords ? v->s : tex[0];
+      float t = mesh->texCoords ? v->t : tex[1];
+      if (s < 0 || s > 1 || t < 0 || t > 1)
+         return;
+   }
+   state->texture = atlas;
+   memcpy(uv, rect, sizeof(rect));
+}
+
+//
+//  Find or create the batch for a render state
+//
+static Mesh *SceneBatchMesh(const SceneState *state)
+{
+   for (int k = 0; k < recording->nbatch; k++)
+      if (!memcmp(&recording->batch[k].state, state, sizeof(SceneState)))
+         return recording->batch[k].mesh;
+   if (recording->nbatch == recording->maxbatch)
+   {
+      recording->maxbatch = recording->maxbatch ? 2 * recording->maxbatch : 32;
+      recording->batch = (SceneBatch *)realloc(recording->batch, recording->maxbatch * sizeof(SceneBatch));
+      if (!recording->batch)
+         Fatal("Cannot allocate %d scene batches\n", recording->maxbatch);
+   }
+   SceneBatch *batch = recording->batch + recording->nbatch;
+   batch->state = *state;
+   batch->mesh = MeshNew();
+   batch->mesh->texCoords = 1;
+   batch->order = recording->nbatch++;
+   batch->copies = NULL;
+   return batch->mesh;
+}
+
+//
+//  Merge count indices of a mesh into the batch for a render state
+//     Texture coordinates are moved into the part of the atlas in uv
+//
+static void SceneAppend(const SceneState *state, const Mesh *mesh, int first, int count, const double mat[16], const float tex[2], const float uv[4])
+{
+   Mesh *batch = SceneBatchMesh(state);
+   int from = batch->nvert;
+   MeshAppend(batch, mesh, first, count, mat, tex);
+   for (int k = from; k < batch->nvert; k++)
+   {
+      batch->vert[k].s = uv[0] + uv[2] * batch->vert[k].s;
+      batch->vert[k].t = uv[1] + uv[3] * batch->vert[k].t;
+   }
+}
+
+//
+//  Sort opaque batches by texture then material, blended batches
+//  after them in the order they were drawn
+//
+static int SceneCompare(const void *a, const void *b)
+{
+   const SceneBatch *A = (const SceneBatch *)a;
+   const SceneBatch *B = (const SceneBatch *)b;
+   if (A->state.blend != B->state.blend)
+      return A->state.blend - B->state.blend;
+   if (!A->state.blend)
+   {
+      if (A->state.texture != B->state.texture)
+         return A->state.texture < B->state.texture ? -1 : 1;
+      int cmp = memcmp(&A->state, &B->state, sizeof(SceneState));
+      if (cmp)
+         return cmp;
+   }
+   return A->order - B->order;
+}
+
+//
+//  State shared by the instances of a mesh
+//     Material colours become per instance and textures become layers
+//
+static void SceneInstanceKey(const SceneMesh *draw, SceneState *key)
+{
+   *key = draw->state;
+   memset(key->ambient, 0, sizeof(key->ambient));
+   memset(key->diffuse, 0, sizeof(key->diffuse));
+   key->texture = key->texture != 0;
+}
+
+//
+//  Order pending mesh draws so copies of the same instance are adjacent
+//
+static int SceneMeshCompare(const void *a, const void *b)
+{
+   const SceneMesh *A = (const SceneMesh *)a;
+   const SceneMesh *B = (const SceneMesh *)b;
+   if (A->mesh != B->mesh)
+      return A->mesh < B->mesh ? -1 : 1;
+   if (A->first != B->first)
+      return A->first - B->first;
+   if (A->count != B->count)
+      return A->count - B->count;
+   SceneState keyA, keyB;
+   SceneInstanceKey(A, &keyA);
+   SceneInstanceKey(B, &keyB);
+   int cmp = memcmp(&keyA, &keyB, sizeof(SceneState));
+   if (cmp)
+      return cmp;
+   return A->order - B->order;
+}
+
+//
+//  Turn pending mesh draws into instance sets or merge them into batches
+//
+static void SceneInstance(Scene *scene)
+{
+   qsort(scene->pending, scene->npending, sizeof(SceneMesh), SceneMeshCompare);
+   int i = 0;
+   while (i < scene->npending)
+   {
+      //  Copies are pending[i] to pending[j-1]
+      SceneMesh *draw = scene->pending + i;
+      SceneState key;
+      SceneInstanceKey(draw, &key);
+      int j = i + 1;
+      while (j < scene->npending && scene->pending[j].mesh == draw->mesh &&
+             scene->pending[j].first == draw->first && scene->pending[j].count == draw->count)
+      {
+         SceneState copy;
+         SceneInstanceKey(scene->pending + j, &copy);
+         if (memcmp(&key, &copy, sizeof(SceneState)))
+            break;
+         j++;
+      }
+
+      //  Too few copies to be worth a set
+      if (j - i < SCENE_MININSTANCES)
+      {
+         for (; i < j; i++)
+         {
+            draw = scene->pending + i;
+            SceneAppend(&draw->state, draw->mesh, draw->first, draw->count, draw->matrix, draw->mesh->texCoords ? NULL : draw->tex, draw->uv);
+         }
+         continue;
+      }
+
+      //  Collect the copies with their textures as layers
+      InstanceSet *set = InstanceNew(draw->mesh, draw->first, draw->count);
+      unsigned int layers[16];
+      int nlayers = 0;
+      float box[6];
+      SceneBoxEmpty(box);
+      for (; i < j; i++)
+      {
+         SceneMesh *copy = scene->pending + i;
+         if (scene->cellSize)
+            SceneBox(box, copy->mesh, copy->first, copy->count, copy->matrix);
+         int layer = 0;
+         if (copy->state.texture)
+         {
+            while (layer < nlayers && layers[layer] != copy->state.texture)
+               layer++;
+            if (layer == nlayers)
+            {
+               if (nlayers == 16)
+                  Fatal("Too many instance layers\n");
+               layers[nlayers++] = copy->state.texture;
+            }
+         }
+         InstanceAdd(set, copy->matrix, copy->state.ambient, copy->state.diffuse, layer, copy->uv);
+      }
+      InstanceLayers(set, layers, nlayers);
+      InstanceUpload(set);
+      scene->inst = (SceneInstances *)realloc(scene->inst, (scene->ninst + 1) * sizeof(SceneInstances));
+      if (!scene->inst)
+         Fatal("Cannot allocate %d instance sets\n", scene->ninst + 1);
+      scene->inst[scene->ninst].state = key;
+      scene->inst[scene->ninst].state.texture = 0;
+      scene->inst[scene->ninst].set = set;
+      memcpy(scene->inst[scene->ninst].box, box, sizeof(box));
+      scene->ninst++;
+   }
+   free(scene->pending);
+   scene->pending = NULL;
+   scene->npending = scene->maxpending = 0;
+}
+
+/*
+ *  Create an empty scene
+ */
+Scene *SceneNew(void)
+{
+   Scene *scene = (Scene *)calloc(1, sizeof(Scene));
+   if (!scene)
+      Fatal("Cannot allocate scene\n");
+   return scene;
+}
+
+/*
+ *  Delete a scene with its batches and instance sets
+ */
+void SceneFree(Scene *scene)
+{
+   if (!scene)
+      return;
+   if (recording == scene)
+      Fatal("Cannot free a scene while recording it\n");
+   for (int k = 0; k < scene->nbatch; k++)
+   {
+      MeshFree(scene->batch[k].mesh);
+      InstanceFree(scene->batch[k].copies);
+   }
+   for (int k = 0; k < scene->ninst; k++)
+      InstanceFree(scene->inst[k].set);
+   free(scene->batch);
+   free(scene->inst);
+   free(scene->pending);
+   CullFree(&scene->bounds);
+   free(scene->visible);
+   free(scene);
+}
+
+/*
+ *  Merge repeated meshes into batches instead of instancing them
+ *     Use for scenes drawn with SceneDrawCopies
+ */
+void SceneMerge(Scene *scene)
+{
+   scene->merge = 1;
+}
+
+/*
+ *  Split batches into square cells of size (in x and z) so the cells
+ *  outside the view can be culled
+ */
+void SceneCells(Scene *scene, double size)
+{
+   scene->cellSize = size;
+}
+
+/*
+ *  Start recording drawing calls into scene
+ *     Geometry is stored relative to the current modelview matrix
+ */
+void SceneRecord(Scene *scene)
+{
+   if (recording)
+      Fatal("Already recording a scene\n");
+   if (!prim)
+   {
+      prim = MeshNew();
+      prim->texCoords = 1;
+   }
+   recording = scene;
+   //  Recorded primitives start from the current normal and texture coordinate
+   float v[4];
+   glGetFloatv(GL_CURRENT_NORMAL, v);
+   MeshNormal3f(prim, v[0], v[1], v[2]);
+   glGetFloatv(GL_CURRENT_TEXTURE_COORDS, v);
+   MeshTexCoord2f(prim, v[0], v[1]);
+}
+
+/*
+ *  Stop recording and copy batches to buffer objects
+ */
+void SceneFinish(Scene *scene)
+{
+   if (recording != scene)
+      Fatal("Scene is not recording\n");
+   //  Instance repeated meshes, merge the rest
+   SceneInstance(scene);
+   recording = NULL;
+   tag = 0;
+   //  Remember state and current values to leave behind after drawing
+   SceneQuery(&scene->final, 0);
+   glGetFloatv(GL_CURRENT_COLOR, scene->final.color);
+   memcpy(scene->normal, prim->normal, sizeof(scene->normal));
+   memcpy(scene->tex, prim->tex, sizeof(scene->tex));
+   //  Sort and upload batches
+   qsort(scene->batch, scene->nbatch, sizeof(SceneBatch), SceneCompare);
+   for (int k = 0; k < scene->nbatch; k++)
+      MeshUpload(scene->batch[k].mesh);
+
+   //  Bounding spheres of batches then instance sets
+   if (scene->cellSize)
+   {
+      static const double identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+      for (int k = 0; k < scene->nbatch + scene->ninst; k++)
+      {
+         float box[6];
+         if (k < scene->nbatch)
+         {
+            const Mesh *mesh = scene->batch[k].mesh;
+            SceneBoxEmpty(box);
+            SceneBox(box, mesh, 0, mesh->nindex, identity);
+         }
+         else
+            memcpy(box, scene->inst[k - scene->nbatch].box, sizeof(box));
+         float dx = box[3] - box[0], dy = box[4] - box[1], dz = box[5] - box[2];
+         CullAdd(&scene->bounds, 0.5 * (box[0] + box[3]), 0.5 * (box[1] + box[4]), 0.5 * (box[2] + box[5]),
+                 0.5 * sqrt(dx * dx + dy * dy + dz * dz));
+      }
+      scene->visible = (unsigned char *)malloc(scene->bounds.n);
+      if (!scene->visible)
+         Fatal("Cannot allocate %d scene cells\n", scene->bounds.n);
+   }
+}
+
+//
+//  Leave the state and current values the recorded drawing left behind
+//
+static void SceneRestore(const Scene *scene)
+{
+   SceneApply(&scene->final);
+   glColor4fv(scene->final.color);
+   DrawNormal3f(scene->normal[0], scene->normal[1], scene->normal[2]);
+   DrawTexCoord2f(scene->tex[0], scene->tex[1]);
+}
+
+//
+//  Is batch (or instance set after the batches) k in view
+//
+static int SceneVisible(const Scene *scene, int k)
+{
+   return !scene->cellSize || scene->visible[k];
+}
+
+/*
+ *  Draw all batches of a scene
+ */
+void SceneDraw(const Scene *scene)
+{
+   //  Skip batches and instance sets outside the view
+   if (scene->cellSize)
+      CullTest(&scene->bounds, scene->visible);
+
+   //  Opaque batches, then instances, then blended batches
+   int k = 0;
+   for (; k < scene->nbatch && !scene->batch[k].state.blend; k++)
+   {
+      if (!SceneVisible(scene, k))
+         continue;
+      SceneApply(&scene->batch[k].state);
+      MeshDraw(scene->batch[k].mesh);
+   }
+   for (int i = 0; i < scene->ninst; i++)
+   {
+      if (!SceneVisible(scene, scene->nbatch + i))
+         continue;
+      SceneApply(&scene->inst[i].state);
+      InstanceDraw(scene->inst[i].set);
+   }
+   for (; k < scene->nbatch; k++)
+   {
+      if (!SceneVisible(scene, k))
+         continue;
+      SceneApply(&scene->batch[k].state);
+      MeshDraw(scene->batch[k].mesh);
+   }
+   SceneRestore(scene);
+}
+
+//
+//  Material of a batch for one copy
+//
+static void SceneCopyState(const SceneState *state, const SceneCopy *copy, SceneState *out)
+{
+   *out = *state;
+   if (state->tag && copy->material)
+   {
+      memcpy(out->ambient, copy->material[state->tag].ambient, sizeof(out->ambient));
+      memcpy(out->diffuse, copy->material[state->tag].diffuse, sizeof(out->diffuse));
+   }
+}
+
+//
+//  Draw copies of a batch
+//     One instanced draw call when the batch can be instanced,
+//     otherwise one draw call per copy
+//
+static void SceneDrawBatchCopies(SceneBatch *batch, const SceneCopy copy[], int n)
+{
+   SceneState state;
+   if (!SceneInstanced(&batch->state))
+   {
+      for (int i = 0; i < n; i++)
+      {
+         SceneCopyState(&batch->state, copy + i, &state);
+         SceneApply(&state);
+         glPushMatrix();
+         glMultMatrixd(copy[i].matrix);
+         MeshDraw(batch->mesh);
+         glPopMatrix();
+      }
+      return;
+   }
+
+   if (!batch->copies)
+   {
+      batch->copies = InstanceNew(batch->mesh, 0, batch->mesh->nindex);
+      if (batch->state.texture)
+         InstanceLayers(batch->copies, &batch->state.texture, 1);
+   }
+   InstanceClear(batch->copies);
+   for (int i = 0; i < n; i++)
+   {
+      SceneCopyState(&batch->state, copy + i, &state);
+      InstanceAdd(batch->copies, copy[i].matrix, state.ambient, state.diffuse, 0, NULL);
+   }
+   InstanceUpload(batch->copies);
+   SceneApply(&batch->state);
+   InstanceDraw(batch->copies);
+}
+
+/*
+ *  Draw n copies of a scene
+ *     Each copy has its own model matrix and material for tagged batches
+ */
+void SceneDrawCopies(Scene *scene, const SceneCopy copy[], int n)
+{
+   if (n == 0)
+      return;
+   //  Opaque batches, then instances, then blended batches
+   int k = 0;
+   for (; k < scene->nbatch && !scene->batch[k].state.blend; k++)
+      SceneDrawBatchCopies(scene->batch + k, copy, n);
+   for (int i = 0; i < scene->ninst; i++)
+   {
+      SceneApply(&scene->inst[i].state);
+      for (int j = 0; j < n; j++)
+      {
+         glPushMatrix();
+         glMultMatrixd(copy[j].matrix);
+         InstanceDraw(scene->inst[i].set);
+         glPopMatrix();
+      }
+   }
+   for (; k < scene->nbatch; k++)
+      SceneDrawBatchCopies(scene->batch + k, copy, n);
+   SceneRestore(scene);
+}
+
+/*
+ *  Is a scene being recorded
+ */
+int SceneRecording(void)
+{
+   return recording != NULL;
+}
+
+/*
+ *  Tag the drawing recorded from now on
+ *     Tagged batches take their material from each copy in SceneDrawCopies
+ */
+void SceneTag(int t)
+{
+   tag = t;
+}
+
+/*
+ *  Add count indices of a cached mesh to the scene being recorded
+ *     Returns 0 if no scene is recording
+ */
+int SceneAddMesh(const Mesh *mesh, int first, int count)
+{
+   if (!recording)
+      return 0;
+   SceneState state;
+   SceneQuery(&state, mesh->prim == GL_LINES);
+   float uv[4];
+   SceneAtlas(&state, mesh, first, count, prim->tex, uv);
+   double mat[16];
+   glGetDoublev(GL_MODELVIEW_MATRIX, mat);
+   if (recording->cellSize)
+      state.cell = SceneCell(mesh, first, count, mat);
+   //  Anything that cannot be instanced is merged straight away
+   //  to keep its draw order
+   if (recording->merge || !SceneInstanced(&state) || (state.texture && !mesh->texCoords))
+   {
+      SceneAppend(&state, mesh, first, count, mat, mesh->texCoords ? NULL : prim->tex, uv);
+      return 1;
+   }
+   if (recording->npending == recording->maxpending)
+   {
+      recording->maxpending = recording->maxpending ? 2 * recording->maxpending : 256;
+      recording->pending = (SceneMesh *)realloc(recording->pending, recording->maxpending * sizeof(SceneMesh));
+      if (!recording->pending)
+         Fatal("Cannot allocate %d scene meshes\n", recording->maxpending);
+   }
+   SceneMesh *draw = recording->pending + recording->npending++;
+   draw->mesh = mesh;
+   draw->first = first;
+   draw->count = count;
+   draw->state = state;
+   memcpy(draw->matrix, mat, sizeof(mat));
+   memcpy(draw->tex, prim->tex, sizeof(draw->tex));
+   memcpy(draw->uv, uv, sizeof(draw->uv));
+   draw->order = recording->npending - 1;
+   return 1;
+}
+
+/*
+ *  Immediate mode drawing that can be recorded into a scene
+ *     Same as glBegin/glNormal3f/glTexCoord2f/glVertex3f/glEnd otherwise
+ */
+void DrawBegin(GLenum mode)
+{
+   if (recording)
+      MeshBegin(prim, mode);
+   else
+      glBegin(mode);
+}
+
+void DrawNormal3f(float nx, float ny, float nz)
+{
+   if (recording)
+      MeshNormal3f(prim, nx, ny, nz);
+   glNormal3f(nx, ny, nz);
+}
+
+void DrawTexCoord2f(float s, float t)
+{
+   if (recording)
+      MeshTexCoord2f(prim, s, t);
+   glTexCoord2f(s, t);
+}
+
+void DrawVertex3f(float x, float y, float z)
+{
+   if (recording)
+      MeshVertex3f(prim, x, y, z);
+   else
+      glVertex3f(x, y, z);
+}
+
+void DrawEnd(void)
+{
+   if (!recording)
+   {
+      glEnd();
+      return;
+   }
+   MeshEnd(prim);
+   SceneState state;
+   SceneQuery(&state, prim->prim == GL_LINES);
+   float uv[4];
+   SceneAtlas(&state, prim, 0, prim->nindex, NULL, uv);
+   double mat[16];
+   glGetDoublev(GL_MODELVIEW_MATRIX, mat);
+   if (recording->cellSize)
+      state.cell = SceneCell(prim, 0, prim->nindex, mat);
+   SceneAppend(&state, prim, 0, prim->nindex, mat, NULL, uv);
+   //  Keep the current normal and texture coordinate for the next primitive
+   prim->nvert = prim->nindex = 0;
+}
@@ -14,9 +14,9 @@ void SetMaterial(float ambient_r, float ambient_g, float ambient_b,
     float spe[] = {specular_r, specular_g, specular_b, 1.0};
     float emi[] = {0.0, 0.0, 0.0, 1.0};
 
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, amb);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, dif);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, spe);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emi);
-    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+    StateMaterialfv(GL_AMBIENT, amb);
+    StateMaterialfv(GL_DIFFUSE, dif);
+    StateMaterialfv(GL_SPECULAR, spe);
+    StateMaterialfv(GL_EMISSION, emi);
+    StateMaterialf(GL_SHININESS, shininess);
 }
\ No newline at end of file
@@ -1,4 +1,86 @@
 #include "CSCIx229.h"
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(dir, mode) _mkdir(dir)
+#else
+#include <sys/stat.h>
+#endif
+
+//  Linked programs are kept in this directory, one file per program
+#define SHADER_CACHE "shadercache"
+#define SHADER_MAGIC 0x31425053 //  "SPB1"
+
+//  Start of a cached program file, followed by the binary
+typedef struct
+{
+    unsigned int magic;     //  SHADER_MAGIC
+    unsigned long long key; //  Hash of the sources and the driver
+    unsigned int format;    //  Binary format
+    int length;             //  Bytes of binary
+} ShaderCacheHeader;
+
+static int binaries = -1; //  Program binaries available (-1 = not checked)
+static int loaded = 0;    //  Programs loaded from the cache
+static int compiled = 0;  //  Programs compiled from text
+
+//  Names of the shared uniforms by SHADER_TIME, SHADER_HEIGHT and SHADER_POINTSCALE
+static const char *sharedName[SHADER_SHARED] = {[SHADER_TIME] = "time", [SHADER_HEIGHT] = "height", [SHADER_POINTSCALE] = "pointScale"};
+static ShaderShared shared; //  Values for this frame
+static int frame = 0;       //  Frames started by ShaderFrame
+
+//
+//  Hash a name (FNV-1a), never 0 so 0 marks an empty slot
+//
+static unsigned int ShaderHash(const char *name)
+{
+    unsigned int h = 2166136261u;
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h ? h : 1;
+}
+
+//
+//  Add a variable to a table
+//     Arrays are reported as name[0] and are stored as name
+//
+static void ShaderAdd(ShaderVar *table, const char *name, int location)
+{
+    ShaderVar var;
+    int len = strcspn(name, "[");
+    if (len >= (int)sizeof(var.name))
+        Fatal("Shader variable name %s too long\n", name);
+    memcpy(var.name, name, len);
+    var.name[len] = 0;
+    var.hash = ShaderHash(var.name);
+    var.location = location;
+    for (int k = 0; k < SHADER_SLOTS; k++)
+    {
+        ShaderVar *slot = table + ((var.hash + k) & (SHADER_SLOTS - 1));
+        if (!slot->hash)
+        {
+            *slot = var;
+            return;
+        }
+    }
+    Fatal("More than %d shader variables\n", SHADER_SLOTS);
+}
+
+//
+//  Find a variable in a table (-1 if it is not active)
+//
+static int ShaderFind(const ShaderVar *table, const char *name)
+{
+    unsigned int hash = ShaderHash(name);
+    for (int k = 0; k < SHADER_SLOTS; k++)
+    {
+        const ShaderVar *slot = table + ((hash + k) & (SHADER_SLOTS - 1));
+        if (!slot->hash)
+            return -1;
+        if (slot->hash == hash && !strcmp(slot->name, name))
+            return slot->location;
+    }
+    return -1;
+}
 
 /*
  *  Print Shader Log
@@ -67,38 +149,292 @@ char *ReadText(char *file)
     return buffer;
 }
 
+//
+//  Compile shader source read from file
+//
+static int CompileShader(GLenum type, const char *source, char *file)
+{
+    int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    PrintShaderLog(shader, file);
+    return shader;
+}
+
 /*
  *  Create Shader
  */
 int CreateShader(GLenum type, char *file)
 {
-    int shader = glCreateShader(type);
     char *source = ReadText(file);
-    glShaderSource(shader, 1, (const char **)&source, NULL);
+    int shader = CompileShader(type, source, file);
     free(source);
-    glCompileShader(shader);
-    PrintShaderLog(shader, file);
     return shader;
 }
 
+//
+//  Check for program binaries (OpenGL 4.1 or ARB_get_program_binary)
+//
+static int ShaderBinarySupported(void)
+{
+    if (binaries < 0)
+    {
+        const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+        const char *version = (const char *)glGetString(GL_VERSION);
+        int major = 0, minor = 0;
+        binaries = 0;
+        if ((version && sscanf(version, "%d.%d", &major, &minor) == 2 && 10 * major + minor >= 41) ||
+            (ext && strstr(ext, "GL_ARB_get_program_binary")))
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaries);
+        if (binaries > 0)
+            mkdir(SHADER_CACHE, 0755);
+    }
+    return binaries > 0;
+}
+
+//
+//  64 bit FNV-1a hash of text continuing from h
+//
+static unsigned long long ShaderKeyText(unsigned long long h, const char *text)
+{
+    while (text && *text)
+        h = (h ^ (unsigned char)*text++) * 1099511628211ull;
+    //  Separator so "ab"+"c" and "a"+"bc" differ
+    return (h ^ 0xff) * 1099511628211ull;
+}
+
+//
+//  Key of a program: its sources and the driver that compiled it
+//
+static unsigned long long ShaderKey(const char *vert, const char *frag)
+{
+    GLenum driver[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+    unsigned long long h = 14695981039346656037ull;
+    h = ShaderKeyText(h, vert);
+    h = ShaderKeyText(h, frag);
+    for (int k = 0; k < 4; k++)
+        h = ShaderKeyText(h, (const char *)glGetString(driver[k]));
+    return h;
+}
+
+//
+//  Load a cached program binary into prog
+//     Returns 0 if the file is missing, stale or the driver rejects it
+//
+static int ShaderCacheLoad(int prog, const char *file, unsigned long long key)
+{
+    ShaderCacheHeader head;
+    FILE *f = fopen(file, "rb");
+    if (!f)
+        return 0;
+    int ok = fread(&head, sizeof(head), 1, f) == 1 && head.magic == SHADER_MAGIC && head.key == key && head.length > 0;
+    void *binary = ok ? malloc(head.length) : NULL;
+    ok = binary && fread(binary, 1, head.length, f) == (size_t)head.length;
+    fclose(f);
+    if (ok)
+    {
+        glProgramBinary(prog, head.format, binary, head.length);
+        glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    }
+    free(binary);
+    return ok;
+}
+
+//
+//  Save the binary of a linked program
+//
+static void ShaderCacheSave(int prog, const char *file, unsigned long long key)
+{
+    ShaderCacheHeader head = {SHADER_MAGIC, key, 0, 0};
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &head.length);
+    if (head.length <= 0)
+        return;
+    void *binary = malloc(head.length);
+    if (!binary)
+        Fatal("Cannot allocate %d bytes for program binary\n", head.length);
+    glGetProgramBinary(prog, head.length, NULL, &head.format, binary);
+    FILE *f = fopen(file, "wb");
+    //  A cache that cannot be written only costs a compile next time
+    if (f)
+    {
+        fwrite(&head, sizeof(head), 1, f);
+        fwrite(binary, 1, head.length, f);
+        fclose(f);
+    }
+    free(binary);
+}
+
 /*
  *  Create Shader Program
+ *     The linked program is cached and loaded from the cache next time
+ *     unless the sources or the driver have changed
  */
 int CreateShaderProg(char *VertFile, char *FragFile)
 {
     int prog = glCreateProgram();
-    int vert = CreateShader(GL_VERTEX_SHADER, VertFile);
-    int frag = CreateShader(GL_FRAGMENT_SHADER, FragFile);
+    char *vertText = ReadText(VertFile);
+    char *fragText = ReadText(FragFile);
+    int cache = ShaderBinarySupported();
+    unsigned long long key = 0;
+    char file[256];
 
-    glAttachShader(prog, vert);
-    glAttachShader(prog, frag);
+    if (cache)
+    {
+        key = ShaderKey(vertText, fragText);
+        snprintf(file, sizeof(file), "%s/%s-%s.bin", SHADER_CACHE, VertFile, FragFile);
+    }
+    if (cache && ShaderCacheLoad(prog, file, key))
+        loaded++;
+    else
+    {
+        int vert = CompileShader(GL_VERTEX_SHADER, vertText, VertFile);
+        int frag = CompileShader(GL_FRAGMENT_SHADER, fragText, FragFile);
 
-    // Bind vec4 rainData to attribute 0 BEFORE linking
-    glBindAttribLocation(prog, 0, "rainData");
+        glAttachShader(prog, vert);
+        glAttachShader(prog, frag);
+        if (cache)
+            glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-    glLinkProgram(prog);
+        glLinkProgram(prog);
+        PrintProgramLog(prog);
 
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+        if (cache)
+            ShaderCacheSave(prog, file, key);
+        compiled++;
+    }
+    free(vertText);
+    free(fragText);
     return prog;
 }
+
+/*
+ *  Programs made by CreateShaderProg from the cache and from text
+ */
+void ShaderCacheStats(int *fromCache, int *fromText)
+{
+    *fromCache = loaded;
+    *fromText = compiled;
+}
+
+/*
+ *  Wrap a linked program with tables of its active uniforms and attributes
+ */
+ShaderProgram *ShaderReflect(int prog)
+{
+    int n, len;
+    char name[256];
+    ShaderProgram *p = (ShaderProgram *)calloc(1, sizeof(ShaderProgram));
+    if (!p)
+        Fatal("Cannot allocate shader program\n");
+    p->id = prog;
+    p->frame = -1;
+
+    glGetProgramiv(prog, GL_ACTIVE_UNIFORMS, &n);
+    for (int k = 0; k < n; k++)
+    {
+        int size;
+        GLenum type;
+        glGetActiveUniform(prog, k, sizeof(name), &len, &size, &type, name);
+        //  Built in uniforms have no location
+        int location = glGetUniformLocation(prog, name);
+        if (location >= 0)
+            ShaderAdd(p->uniform, name, location);
+    }
+
+    glGetProgramiv(prog, GL_ACTIVE_ATTRIBUTES, &n);
+    for (int k = 0; k < n; k++)
+    {
+        int size;
+        GLenum type;
+        glGetActiveAttrib(prog, k, sizeof(name), &len, &size, &type, name);
+        int location = glGetAttribLocation(prog, name);
+        if (location >= 0)
+            ShaderAdd(p->attrib, name, location);
+    }
+
+    for (int k = 0; k < SHADER_SHARED; k++)
+        p->shared[k] = ShaderFind(p->uniform, sharedName[k]);
+    return p;
+}
+
+/*
+ *  Create Shader Program with its uniform and attribute tables
+ */
+ShaderProgram *ShaderNew(char *VertFile, char *FragFile)
+{
+    return ShaderReflect(CreateShaderProg(VertFile, FragFile));
+}
+
+/*
+ *  Location of a uniform (-1 if it is not active)
+ */
+int ShaderUniform(const ShaderProgram *p, const char *name)
+{
+    return ShaderFind(p->uniform, name);
+}
+
+/*
+ *  Location of an attribute (-1 if it is not active)
+ */
+int ShaderAttrib(const ShaderProgram *p, const char *name)
+{
+    return ShaderFind(p->attrib, name);
+}
+
+/*
+ *  Start a frame with new shared uniform values
+ */
+void ShaderFrame(const ShaderShared *values)
+{
+    shared = *values;
+    frame++;
+}
+
+/*
+ *  Use a program
+ *     The shared uniforms are sent the first time it is used in a frame
+ */
+void ShaderUse(ShaderProgram *p)
+{
+    glUseProgram(p->id);
+    if (p->frame == frame)
+        return;
+    p->frame = frame;
+    for (int k = 0; k < SHADER_SHARED; k++)
+        if (p->shared[k] >= 0)
+            glUniform1f(p->shared[k], shared.value[k]);
+}
+
+/*
+ *  Set uniforms of the program in use by name
+ *     Names the program does not use are ignored
+ */
+void ShaderSet1i(const ShaderProgram *p, const char *name, int x)
+{
+    int location = ShaderFind(p->uniform, name);
+    if (location >= 0)
+        glUniform1i(location, x);
+}
+
+void ShaderSet1f(const ShaderProgram *p, const char *name, float x)
+{
+    int location = ShaderFind(p->uniform, name);
+    if (location >= 0)
+        glUniform1f(location, x);
+}
+
+void ShaderSet2f(const ShaderProgram *p, const char *name, float x, float y)
+{
+    int location = ShaderFind(p->uniform, name);
+    if (location >= 0)
+        glUniform2f(location, x, y);
+}
+
+void ShaderSet3fv(const ShaderProgram *p, const char *name, const float *v)
+{
+    int location = ShaderFind(p->uniform, name);
+    if (location >= 0)
+        glUniform3fv(location, 1, v);
+}
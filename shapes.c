@@ -1,99 +1,230 @@
 
 #include "CSCIx229.h"
 
+//  Shape types for the mesh cache
+enum
+{
+   SHAPE_CUBE,
+   SHAPE_TORUS,
+   SHAPE_TRAPEZOID,
+   SHAPE_CYLINDER,
+   SHAPE_CYLINDER_TEX,
+   SHAPE_PRISM,
+   SHAPE_SPHERE,
+   SHAPE_RECTANGLE,
+};
+
+//
+//  Level of detail
+//     Curved shapes pick one of LOD_LEVELS tessellations from their size on
+//     screen.  The level each shape used last frame is remembered by the
+//     order shapes are drawn in, and a shape only drops to a coarser level
+//     once it has shrunk LOD_HYSTERESIS past the switch point so levels do
+//     not flicker back and forth.
+//
+#define LOD_LEVELS 4            // tessellation levels per shape
+#define LOD_PIXELS 6.0          // target edge length on screen in pixels
+#define LOD_HYSTERESIS 1.25     // extra shrink needed to coarsen
+#define LOD_BAKE_DISTANCE 4.0   // viewing distance assumed for baked scenes
+#define LOD_SLOTS 4096          // shapes per frame with hysteresis
+
+typedef struct
+{
+   int shape; // shape type
+   int full;  // finest segment count
+   int level; // level used last frame
+} LodSlot;
+
+static LodSlot lodSlot[LOD_SLOTS];
+static int lodNext = 0;
+
 /*
- *  Draw a cube
- *     at (x,y,z)
- *     dimensions (dx,dy,dz)
- *     rotated th about the y axis
+ *  Start a new frame of level of detail selection
  */
-void cube(double x, double y, double z,
-          double dx, double dy, double dz,
-          double th,
-          int useTexture,
-          double texRepeatU,
-          double texRepeatV)
+void LodFrame(void)
 {
-   glPushMatrix();
-   glTranslated(x, y, z);
-   glRotated(th, 0, 1, 0);
-   glScaled(dx, dy, dz);
+   lodNext = 0;
+}
+
+//
+//  Segments at a level: halved per level down to min
+//
+static int LodSegments(int full, int level, int min)
+{
+   int n = full >> level;
+   if (n >= min)
+      return n;
+   return full < min ? full : min;
+}
+
+//
+//  Radius in pixels of a sphere of radius r at the origin
+//
+static double PixelRadius(double r)
+{
+   double mv[16], proj[16];
+   int vp[4];
+   glGetDoublev(GL_MODELVIEW_MATRIX, mv);
+   glGetDoublev(GL_PROJECTION_MATRIX, proj);
+   glGetIntegerv(GL_VIEWPORT, vp);
+   //  Largest scale of the modelview
+   double s = 0;
+   for (int k = 0; k < 3; k++)
+   {
+      double l = sqrt(mv[4 * k] * mv[4 * k] + mv[4 * k + 1] * mv[4 * k + 1] + mv[4 * k + 2] * mv[4 * k + 2]);
+      if (l > s)
+         s = l;
+   }
+   double size = r * s * proj[5] * vp[3] / 2;
+   //  Orthogonal projection does not depend on distance
+   if (proj[11] == 0)
+      return size;
+   //  Baked scenes are seen from anywhere, so assume they are close
+   double z = SceneRecording() ? LOD_BAKE_DISTANCE : -mv[14];
+   //  Use the finest level when the eye is in or near the shape
+   if (z <= r * s)
+      return 1e9;
+   return size / z;
+}
+
+//
+//  Coarsest level with at least need segments
+//
+static int LodPick(const int seg[LOD_LEVELS], double need)
+{
+   int level = 0;
+   while (level + 1 < LOD_LEVELS && seg[level + 1] >= need)
+      level++;
+   return level;
+}
+
+//
+//  Select the level for a shape of radius r
+//     seg is the number of segments around the shape at each level
+//
+static int LodLevel(int shape, const int seg[LOD_LEVELS], double r)
+{
+   double need = 2 * M_PI * PixelRadius(r) / LOD_PIXELS;
+   int fine = LodPick(seg, need);
+   if (SceneRecording() || lodNext == LOD_SLOTS)
+      return fine;
+
+   //  Refine right away, coarsen only past the hysteresis margin
+   LodSlot *slot = lodSlot + lodNext++;
+   int level = fine;
+   if (slot->shape == shape && slot->full == seg[0] && fine >= slot->level)
+   {
+      int coarse = LodPick(seg, need * LOD_HYSTERESIS);
+      level = coarse > slot->level ? coarse : slot->level;
+   }
+   slot->shape = shape;
+   slot->full = seg[0];
+   slot->level = level;
+   return level;
+}
 
-   glBegin(GL_QUADS);
+//
+//  Unit cube with texture repeats baked into the texture coordinates
+//
+static Mesh *CubeMesh(int texMode, double texRepeatU, double texRepeatV)
+{
+   MeshKey key = {SHAPE_CUBE, 0, 0, texMode, {texRepeatU, texRepeatV}};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   mesh->texCoords = texMode;
+
+   MeshBegin(mesh, GL_QUADS);
 
    // Front
-   glNormal3f(0, 0, 1);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, -1, 1);
-   glTexCoord2f(texRepeatU, 0);
-   glVertex3f(+1, -1, 1);
-   glTexCoord2f(texRepeatU, texRepeatV);
-   glVertex3f(+1, +1, 1);
-   glTexCoord2f(0, texRepeatV);
-   glVertex3f(-1, +1, 1);
+   MeshNormal3f(mesh, 0, 0, 1);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, -1, -1, 1);
+   MeshTexCoord2f(mesh, texRepeatU, 0);
+   MeshVertex3f(mesh, +1, -1, 1);
+   MeshTexCoord2f(mesh, texRepeatU, texRepeatV);
+   MeshVertex3f(mesh, +1, +1, 1);
+   MeshTexCoord2f(mesh, 0, texRepeatV);
+   MeshVertex3f(mesh, -1, +1, 1);
 
    // Back
-   glNormal3f(0, 0, -1);
-   glTexCoord2f(0, 0);
-   glVertex3f(+1, -1, -1);
-   glTexCoord2f(texRepeatU, 0);
-   glVertex3f(-1, -1, -1);
-   glTexCoord2f(texRepeatU, texRepeatV);
-   glVertex3f(-1, +1, -1);
-   glTexCoord2f(0, texRepeatV);
-   glVertex3f(+1, +1, -1);
+   MeshNormal3f(mesh, 0, 0, -1);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, +1, -1, -1);
+   MeshTexCoord2f(mesh, texRepeatU, 0);
+   MeshVertex3f(mesh, -1, -1, -1);
+   MeshTexCoord2f(mesh, texRepeatU, texRepeatV);
+   MeshVertex3f(mesh, -1, +1, -1);
+   MeshTexCoord2f(mesh, 0, texRepeatV);
+   MeshVertex3f(mesh, +1, +1, -1);
 
    // Right
-   glNormal3f(+1, 0, 0);
-   glVertex3f(+1, -1, +1);
-   glVertex3f(+1, -1, -1);
-   glVertex3f(+1, +1, -1);
-   glVertex3f(+1, +1, +1);
+   MeshNormal3f(mesh, +1, 0, 0);
+   MeshVertex3f(mesh, +1, -1, +1);
+   MeshVertex3f(mesh, +1, -1, -1);
+   MeshVertex3f(mesh, +1, +1, -1);
+   MeshVertex3f(mesh, +1, +1, +1);
 
    // Left
-   glNormal3f(-1, 0, 0);
-   glVertex3f(-1, -1, -1);
-   glVertex3f(-1, -1, +1);
-   glVertex3f(-1, +1, +1);
-   glVertex3f(-1, +1, -1);
+   MeshNormal3f(mesh, -1, 0, 0);
+   MeshVertex3f(mesh, -1, -1, -1);
+   MeshVertex3f(mesh, -1, -1, +1);
+   MeshVertex3f(mesh, -1, +1, +1);
+   MeshVertex3f(mesh, -1, +1, -1);
 
    // Top
-   glNormal3f(0, +1, 0);
-   glTexCoord2f(0, 0);
-   glVertex3f(-1, +1, +1);
-   glVertex3f(+1, +1, +1);
-   glVertex3f(+1, +1, -1);
-   glVertex3f(-1, +1, -1);
+   MeshNormal3f(mesh, 0, +1, 0);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, -1, +1, +1);
+   MeshVertex3f(mesh, +1, +1, +1);
+   MeshVertex3f(mesh, +1, +1, -1);
+   MeshVertex3f(mesh, -1, +1, -1);
 
    // Bottom
-   glNormal3f(0, -1, 0);
-   glVertex3f(-1, -1, -1);
-   glVertex3f(+1, -1, -1);
-   glVertex3f(+1, -1, +1);
-   glVertex3f(-1, -1, +1);
-
-   glEnd();
-
-   glPopMatrix();
+   MeshNormal3f(mesh, 0, -1, 0);
+   MeshVertex3f(mesh, -1, -1, -1);
+   MeshVertex3f(mesh, +1, -1, -1);
+   MeshVertex3f(mesh, +1, -1, +1);
+   MeshVertex3f(mesh, -1, -1, +1);
+
+   MeshEnd(mesh);
+   MeshUpload(mesh);
+   return mesh;
 }
 
 /*
- * Draw a torus
- * centerX, centerY, centerZ - position
- * majorRadius - distance from center to tube center
- * minorRadius - tube radius
- * numMajor - segments around major circle
- * numMinor - segments around minor circle (tube)
- * startAngle - starting angle in degrees (0-360)
- * endAngle - ending angle in degrees (0-360)
+ *  Draw a cube
+ *     at (x,y,z)
+ *     dimensions (dx,dy,dz)
+ *     rotated th about the y axis
  */
-void drawTorus(double centerX, double centerY, double centerZ,
-               double majorRadius, double minorRadius,
-               int numMajor, int numMinor,
-               double startAngle, double endAngle)
+void cube(double x, double y, double z,
+          double dx, double dy, double dz,
+          double th,
+          int useTexture,
+          double texRepeatU,
+          double texRepeatV)
 {
    glPushMatrix();
-   glTranslated(centerX, centerY, centerZ);
+   glTranslated(x, y, z);
+   glRotated(th, 0, 1, 0);
+   glScaled(dx, dy, dz);
+   MeshDraw(CubeMesh(1, texRepeatU, texRepeatV));
+   glPopMatrix();
+}
+
+//
+//  Torus with unit major radius
+//
+static Mesh *TorusMesh(double minorRadius, int numMajor, int numMinor,
+                       double startAngle, double endAngle)
+{
+   MeshKey key = {SHAPE_TORUS, numMajor, numMinor, 0, {minorRadius, startAngle, endAngle}};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
 
    // Convert angles to radians
    double startRad = startAngle * M_PI / 180.0;
@@ -105,72 +236,93 @@ void drawTorus(double centerX, double centerY, double centerZ,
       double u1 = startRad + angleRange * i / numMajor;
       double u2 = startRad + angleRange * (i + 1) / numMajor;
 
-      glBegin(GL_QUAD_STRIP);
+      MeshBegin(mesh, GL_QUAD_STRIP);
       for (int j = 0; j <= numMinor; j++)
       {
          double v = 2.0 * M_PI * j / numMinor;
 
          // First vertex (u1, v)
-         double x1 = (majorRadius + minorRadius * cos(v)) * cos(u1);
-         double y1 = (majorRadius + minorRadius * cos(v)) * sin(u1);
+         double x1 = (1 + minorRadius * cos(v)) * cos(u1);
+         double y1 = (1 + minorRadius * cos(v)) * sin(u1);
          double z1 = minorRadius * sin(v);
 
          // Normal at (u1, v)
-         double nx1 = cos(v) * cos(u1);
-         double ny1 = cos(v) * sin(u1);
-         double nz1 = sin(v);
-
-         glNormal3f(nx1, ny1, nz1);
-         glVertex3f(x1, y1, z1);
+         MeshNormal3f(mesh, cos(v) * cos(u1), cos(v) * sin(u1), sin(v));
+         MeshVertex3f(mesh, x1, y1, z1);
 
          // Second vertex (u2, v)
-         double x2 = (majorRadius + minorRadius * cos(v)) * cos(u2);
-         double y2 = (majorRadius + minorRadius * cos(v)) * sin(u2);
+         double x2 = (1 + minorRadius * cos(v)) * cos(u2);
+         double y2 = (1 + minorRadius * cos(v)) * sin(u2);
          double z2 = minorRadius * sin(v);
 
          // Normal at (u2, v)
-         double nx2 = cos(v) * cos(u2);
-         double ny2 = cos(v) * sin(u2);
-         double nz2 = sin(v);
-
-         glNormal3f(nx2, ny2, nz2);
-         glVertex3f(x2, y2, z2);
+         MeshNormal3f(mesh, cos(v) * cos(u2), cos(v) * sin(u2), sin(v));
+         MeshVertex3f(mesh, x2, y2, z2);
       }
-      glEnd();
+      MeshEnd(mesh);
    }
 
    // Draw end caps if not a full circle
    if (fabs(angleRange - 2.0 * M_PI) > 0.01) // Not a full torus
    {
       // Start cap at startAngle
-      glBegin(GL_TRIANGLE_FAN);
-      glNormal3f(-sin(startRad), cos(startRad), 0);                            // Normal perpendicular to cut
-      glVertex3f(majorRadius * cos(startRad), majorRadius * sin(startRad), 0); // Center
+      MeshBegin(mesh, GL_TRIANGLE_FAN);
+      MeshNormal3f(mesh, -sin(startRad), cos(startRad), 0);          // Normal perpendicular to cut
+      MeshVertex3f(mesh, cos(startRad), sin(startRad), 0);           // Center
       for (int j = 0; j <= numMinor; j++)
       {
          double v = 2.0 * M_PI * j / numMinor;
-         double x = (majorRadius + minorRadius * cos(v)) * cos(startRad);
-         double y = (majorRadius + minorRadius * cos(v)) * sin(startRad);
+         double x = (1 + minorRadius * cos(v)) * cos(startRad);
+         double y = (1 + minorRadius * cos(v)) * sin(startRad);
          double z = minorRadius * sin(v);
-         glVertex3f(x, y, z);
+         MeshVertex3f(mesh, x, y, z);
       }
-      glEnd();
+      MeshEnd(mesh);
 
       // End cap at endAngle
-      glBegin(GL_TRIANGLE_FAN);
-      glNormal3f(sin(endRad), -cos(endRad), 0);                            // Normal perpendicular to cut
-      glVertex3f(majorRadius * cos(endRad), majorRadius * sin(endRad), 0); // Center
+      MeshBegin(mesh, GL_TRIANGLE_FAN);
+      MeshNormal3f(mesh, sin(endRad), -cos(endRad), 0);              // Normal perpendicular to cut
+      MeshVertex3f(mesh, cos(endRad), sin(endRad), 0);               // Center
       for (int j = 0; j <= numMinor; j++)
       {
          double v = 2.0 * M_PI * j / numMinor;
-         double x = (majorRadius + minorRadius * cos(v)) * cos(endRad);
-         double y = (majorRadius + minorRadius * cos(v)) * sin(endRad);
+         double x = (1 + minorRadius * cos(v)) * cos(endRad);
+         double y = (1 + minorRadius * cos(v)) * sin(endRad);
          double z = minorRadius * sin(v);
-         glVertex3f(x, y, z);
+         MeshVertex3f(mesh, x, y, z);
       }
-      glEnd();
+      MeshEnd(mesh);
    }
 
+   MeshUpload(mesh);
+   return mesh;
+}
+
+/*
+ * Draw a torus
+ * centerX, centerY, centerZ - position
+ * majorRadius - distance from center to tube center
+ * minorRadius - tube radius
+ * numMajor - segments around major circle
+ * numMinor - segments around minor circle (tube)
+ * startAngle - starting angle in degrees (0-360)
+ * endAngle - ending angle in degrees (0-360)
+ */
+void drawTorus(double centerX, double centerY, double centerZ,
+               double majorRadius, double minorRadius,
+               int numMajor, int numMinor,
+               double startAngle, double endAngle)
+{
+   glPushMatrix();
+   glTranslated(centerX, centerY, centerZ);
+   // Fewer segments both ways when small on screen
+   int seg[LOD_LEVELS];
+   for (int k = 0; k < LOD_LEVELS; k++)
+      seg[k] = LodSegments(numMajor, k, 6);
+   int level = LodLevel(SHAPE_TORUS, seg, majorRadius + minorRadius);
+   // Torus mesh is built with unit major radius
+   glScaled(majorRadius, majorRadius, majorRadius);
+   MeshDraw(TorusMesh(minorRadius / majorRadius, seg[level], LodSegments(numMinor, level, 3), startAngle, endAngle));
    glPopMatrix();
 }
 
@@ -186,72 +338,25 @@ void noTexCube(double x, double y, double z,
    glRotated(th, 0, 1, 0);
    glScaled(dx, dy, dz);
 
-   // Begin drawing faces
-   glBegin(GL_QUADS);
-
-   // Front (+Z)
-   glNormal3f(0, 0, 1);
-   glVertex3f(-1, -1, 1);
-   glVertex3f(+1, -1, 1);
-   glVertex3f(+1, +1, 1);
-   glVertex3f(-1, +1, 1);
-
-   // Back (-Z)
-   glNormal3f(0, 0, -1);
-   glVertex3f(+1, -1, -1);
-   glVertex3f(-1, -1, -1);
-   glVertex3f(-1, +1, -1);
-   glVertex3f(+1, +1, -1);
-
-   // Right (+X)
-   glNormal3f(+1, 0, 0);
-   glVertex3f(+1, -1, +1);
-   glVertex3f(+1, -1, -1);
-   glVertex3f(+1, +1, -1);
-   glVertex3f(+1, +1, +1);
-
-   // Left (-X)
-   glNormal3f(-1, 0, 0);
-   glVertex3f(-1, -1, -1);
-   glVertex3f(-1, -1, +1);
-   glVertex3f(-1, +1, +1);
-   glVertex3f(-1, +1, -1);
-
-   // Top (+Y)
-   glNormal3f(0, +1, 0);
-   glVertex3f(-1, +1, +1);
-   glVertex3f(+1, +1, +1);
-   glVertex3f(+1, +1, -1);
-   glVertex3f(-1, +1, -1);
-
-   // Bottom (-Y)
-   glNormal3f(0, -1, 0);
-   glVertex3f(-1, -1, -1);
-   glVertex3f(+1, -1, -1);
-   glVertex3f(+1, -1, +1);
-   glVertex3f(-1, -1, +1);
-
-   glEnd();
+   // Same faces as cube without texture coordinates
+   MeshDraw(CubeMesh(0, 0, 0));
 
    glPopMatrix();
 }
 
-// Bottom rests on ground (y=0), height along +Y
-void trapezoid(double x, double y, double z,
-               double dx, double dy, double dz,    // scale
-               double thX, double thY, double thZ, // rotations
-               double topWidthX, double topWidthZ,
-               double bottomWidthX, double bottomWidthZ,
-               double height)
+//
+//  Trapezoid (cached by its widths and height)
+//
+static Mesh *TrapezoidMesh(double topWidthX, double topWidthZ,
+                           double bottomWidthX, double bottomWidthZ,
+                           double height)
 {
-   glPushMatrix();
-
-   // Transformations
-   glTranslated(x, y, z);
-   glRotated(thX, 1, 0, 0);
-   glRotated(thY, 0, 1, 0);
-   glRotated(thZ, 0, 0, 1);
-   glScaled(dx, dy, dz);
+   MeshKey key = {SHAPE_TRAPEZOID, 0, 0, 1, {topWidthX, topWidthZ, bottomWidthX, bottomWidthZ, height}};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   mesh->texCoords = 1;
 
    double bx = bottomWidthX;
    double bz = bottomWidthZ;
@@ -259,8 +364,9 @@ void trapezoid(double x, double y, double z,
    double tz = topWidthZ;
    double h = height;
 
-   // Draw
-   glBegin(GL_QUADS);
+   // Faces without texture coordinates use the last one set by the sides
+   MeshTexCoord2f(mesh, 1, 0);
+   MeshBegin(mesh, GL_QUADS);
 
    // Front (+Z)
    {
@@ -268,12 +374,12 @@ void trapezoid(double x, double y, double z,
       double ny = (bz - tz);
       double nz = 2.0;
       double len = sqrt(nx * nx + ny * ny + nz * nz);
-      glNormal3f(nx / len, ny / len, nz / len);
+      MeshNormal3f(mesh, nx / len, ny / len, nz / len);
    }
-   glVertex3f(-bx, 0, bz);
-   glVertex3f(bx, 0, bz);
-   glVertex3f(tx, h, tz);
-   glVertex3f(-tx, h, tz);
+   MeshVertex3f(mesh, -bx, 0, bz);
+   MeshVertex3f(mesh, bx, 0, bz);
+   MeshVertex3f(mesh, tx, h, tz);
+   MeshVertex3f(mesh, -tx, h, tz);
 
    // Back (-Z)
    {
@@ -281,12 +387,12 @@ void trapezoid(double x, double y, double z,
       double ny = (bz - tz);
       double nz = -2.0;
       double len = sqrt(nx * nx + ny * ny + nz * nz);
-      glNormal3f(nx / len, ny / len, nz / len);
+      MeshNormal3f(mesh, nx / len, ny / len, nz / len);
    }
-   glVertex3f(bx, 0, -bz);
-   glVertex3f(-bx, 0, -bz);
-   glVertex3f(-tx, h, -tz);
-   glVertex3f(tx, h, -tz);
+   MeshVertex3f(mesh, bx, 0, -bz);
+   MeshVertex3f(mesh, -bx, 0, -bz);
+   MeshVertex3f(mesh, -tx, h, -tz);
+   MeshVertex3f(mesh, tx, h, -tz);
 
    // Right (+X)
    {
@@ -294,16 +400,16 @@ void trapezoid(double x, double y, double z,
       double ny = (bx - tx);
       double nz = 0.0;
       double len = sqrt(nx * nx + ny * ny + nz * nz);
-      glNormal3f(nx / len, ny / len, nz / len);
+      MeshNormal3f(mesh, nx / len, ny / len, nz / len);
    }
-   glTexCoord2f(0, 1);
-   glVertex3f(bx, 0, bz);
-   glTexCoord2f(0, 0);
-   glVertex3f(bx, 0, -bz);
-   glTexCoord2f(1, 0);
-   glVertex3f(tx, h, -tz);
-   glTexCoord2f(1, 1);
-   glVertex3f(tx, h, tz);
+   MeshTexCoord2f(mesh, 0, 1);
+   MeshVertex3f(mesh, bx, 0, bz);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, bx, 0, -bz);
+   MeshTexCoord2f(mesh, 1, 0);
+   MeshVertex3f(mesh, tx, h, -tz);
+   MeshTexCoord2f(mesh, 1, 1);
+   MeshVertex3f(mesh, tx, h, tz);
 
    // Left (-X)
    {
@@ -311,35 +417,122 @@ void trapezoid(double x, double y, double z,
       double ny = (bx - tx);
       double nz = 0.0;
       double len = sqrt(nx * nx + ny * ny + nz * nz);
-      glNormal3f(nx / len, ny / len, nz / len);
+      MeshNormal3f(mesh, nx / len, ny / len, nz / len);
    }
-   glTexCoord2f(0, 0);
-   glVertex3f(-bx, 0, -bz);
-   glTexCoord2f(0, 1);
-   glVertex3f(-bx, 0, bz);
-   glTexCoord2f(1, 1);
-   glVertex3f(-tx, h, tz);
-   glTexCoord2f(1, 0);
-   glVertex3f(-tx, h, -tz);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, -bx, 0, -bz);
+   MeshTexCoord2f(mesh, 0, 1);
+   MeshVertex3f(mesh, -bx, 0, bz);
+   MeshTexCoord2f(mesh, 1, 1);
+   MeshVertex3f(mesh, -tx, h, tz);
+   MeshTexCoord2f(mesh, 1, 0);
+   MeshVertex3f(mesh, -tx, h, -tz);
 
    // Top face
-   glNormal3f(0, 1, 0);
-   glVertex3f(-tx, h, tz);
-   glVertex3f(tx, h, tz);
-   glVertex3f(tx, h, -tz);
-   glVertex3f(-tx, h, -tz);
+   MeshNormal3f(mesh, 0, 1, 0);
+   MeshVertex3f(mesh, -tx, h, tz);
+   MeshVertex3f(mesh, tx, h, tz);
+   MeshVertex3f(mesh, tx, h, -tz);
+   MeshVertex3f(mesh, -tx, h, -tz);
 
    // Bottom face
-   glNormal3f(0, -1, 0);
-   glVertex3f(-bx, 0, -bz);
-   glVertex3f(bx, 0, -bz);
-   glVertex3f(bx, 0, bz);
-   glVertex3f(-bx, 0, bz);
+   MeshNormal3f(mesh, 0, -1, 0);
+   MeshVertex3f(mesh, -bx, 0, -bz);
+   MeshVertex3f(mesh, bx, 0, -bz);
+   MeshVertex3f(mesh, bx, 0, bz);
+   MeshVertex3f(mesh, -bx, 0, bz);
+
+   MeshEnd(mesh);
+   MeshUpload(mesh);
+   return mesh;
+}
+
+// Bottom rests on ground (y=0), height along +Y
+void trapezoid(double x, double y, double z,
+               double dx, double dy, double dz,    // scale
+               double thX, double thY, double thZ, // rotations
+               double topWidthX, double topWidthZ,
+               double bottomWidthX, double bottomWidthZ,
+               double height)
+{
+   glPushMatrix();
+
+   // Transformations
+   glTranslated(x, y, z);
+   glRotated(thX, 1, 0, 0);
+   glRotated(thY, 0, 1, 0);
+   glRotated(thZ, 0, 0, 1);
+   glScaled(dx, dy, dz);
+
+   // Draw
+   MeshDraw(TrapezoidMesh(topWidthX, topWidthZ, bottomWidthX, bottomWidthZ, height));
 
-   glEnd();
    glPopMatrix();
 }
 
+//
+//  Unit cylinder (radius 1, height 1) with optional texture repeats
+//
+static Mesh *CylinderMesh(int slices, int useTexture, double texRepeatU, double texRepeatV)
+{
+   if (!useTexture)
+      texRepeatU = texRepeatV = 0;
+   MeshKey key = {SHAPE_CYLINDER, slices, 0, useTexture, {texRepeatU, texRepeatV}};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   mesh->texCoords = useTexture;
+
+   // Cylinder Side
+   MeshBegin(mesh, GL_QUAD_STRIP);
+   for (int i = 0; i <= slices; i++)
+   {
+      double theta = 2.0 * M_PI * i / slices;
+      double dx = cos(theta);
+      double dz = sin(theta);
+      double u = (double)i / slices * texRepeatU; // Texture U wraps around
+
+      MeshNormal3f(mesh, cos(theta), 0, sin(theta));
+      MeshTexCoord2f(mesh, u, 0);
+      MeshVertex3f(mesh, dx, -0.5, dz); // bottom
+
+      MeshTexCoord2f(mesh, u, texRepeatV);
+      MeshVertex3f(mesh, dx, 0.5, dz); // top
+   }
+   MeshEnd(mesh);
+
+   // Top cap
+   MeshBegin(mesh, GL_TRIANGLE_FAN);
+   MeshNormal3f(mesh, 0, 1, 0);
+   MeshTexCoord2f(mesh, 0.5, 0.5); // Center of texture
+   MeshVertex3f(mesh, 0, 0.5, 0);  // center
+   for (int i = 0; i <= slices; i++)
+   {
+      double theta = 2.0 * M_PI * i / slices;
+      // Map circle to texture space (0.5, 0.5) = center
+      MeshTexCoord2f(mesh, 0.5 + 0.5 * cos(theta), 0.5 + 0.5 * sin(theta));
+      MeshVertex3f(mesh, cos(theta), 0.5, sin(theta));
+   }
+   MeshEnd(mesh);
+
+   // Bottom cap
+   MeshBegin(mesh, GL_TRIANGLE_FAN);
+   MeshNormal3f(mesh, 0, -1, 0);
+   MeshTexCoord2f(mesh, 0.5, 0.5); // Center
+   MeshVertex3f(mesh, 0, -0.5, 0); // center
+   for (int i = 0; i <= slices; i++)
+   {
+      double theta = 2.0 * M_PI * i / slices;
+      MeshTexCoord2f(mesh, 0.5 + 0.5 * cos(theta), 0.5 + 0.5 * sin(theta));
+      MeshVertex3f(mesh, cos(theta), -0.5, sin(theta));
+   }
+   MeshEnd(mesh);
+
+   MeshUpload(mesh);
+   return mesh;
+}
+
 void cylinder(double x, double y, double z,
               double radius, double height,
               int slices,
@@ -357,72 +550,88 @@ void cylinder(double x, double y, double z,
    glRotated(thY, 0, 1, 0);
    glRotated(thZ, 0, 0, 1);
 
+   // Fewer slices when small on screen
+   int seg[LOD_LEVELS];
+   for (int k = 0; k < LOD_LEVELS; k++)
+      seg[k] = LodSegments(slices, k, 4);
+   slices = seg[LodLevel(SHAPE_CYLINDER, seg, radius)];
+
+   // Unit cylinder scaled to size
+   glScaled(radius, height, radius);
+   MeshDraw(CylinderMesh(slices, useTexture, texRepeatU, texRepeatV));
+
+   glPopMatrix();
+}
+
+//
+//  Unit cylinder with the side (part 0) and caps (part 1) separate
+//  so they can use different textures
+//
+static Mesh *CylinderTexMesh(int slices, int useTexture)
+{
+   MeshKey key = {SHAPE_CYLINDER_TEX, slices, 0, useTexture};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   mesh->texCoords = 1;
+
    // Cylinder Side
-   glBegin(GL_QUAD_STRIP);
+   MeshBegin(mesh, GL_QUAD_STRIP);
    for (int i = 0; i <= slices; i++)
    {
       double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-      double u = (double)i / slices * texRepeatU; // Texture U wraps around
+      double dx = cos(theta);
+      double dz = sin(theta);
+      double u = (double)i / slices;
 
-      glNormal3d(cos(theta), 0, sin(theta));
-      if (useTexture)
-         glTexCoord2f(u, 0);
-      glVertex3f(dx, -height / 2, dz); // bottom
+      MeshNormal3f(mesh, cos(theta), 0, sin(theta));
+      MeshTexCoord2f(mesh, 0, u);
+      MeshVertex3f(mesh, dx, -0.5, dz); // bottom
 
-      if (useTexture)
-         glTexCoord2f(u, texRepeatV);
-      glVertex3f(dx, height / 2, dz); // top
+      MeshTexCoord2f(mesh, 1, u);
+      MeshVertex3f(mesh, dx, 0.5, dz); // top
    }
-   glEnd();
+   MeshEnd(mesh);
+
+   // Caps keep the last side coordinate when not textured
+   MeshPart(mesh);
 
    // Top cap
-   glBegin(GL_TRIANGLE_FAN);
-   glNormal3d(0, 1, 0);
+   MeshBegin(mesh, GL_TRIANGLE_FAN);
+   MeshNormal3f(mesh, 0, 1, 0);
    if (useTexture)
-      glTexCoord2f(0.5, 0.5);    // Center of texture
-   glVertex3f(0, height / 2, 0); // center
+      MeshTexCoord2f(mesh, 0.5, 0.5); // Center of texture
+   MeshVertex3f(mesh, 0, 0.5, 0);     // center
    for (int i = 0; i <= slices; i++)
    {
       double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-
       if (useTexture)
       {
          // Map circle to texture space (0.5, 0.5) = center
-         double u = 0.5 + 0.5 * cos(theta);
-         double v = 0.5 + 0.5 * sin(theta);
-         glTexCoord2f(u, v);
+         MeshTexCoord2f(mesh, 0.5 + 0.5 * cos(theta), 0.5 + 0.5 * sin(theta));
       }
-      glVertex3f(dx, height / 2, dz);
+      MeshVertex3f(mesh, cos(theta), 0.5, sin(theta));
    }
-   glEnd();
+   MeshEnd(mesh);
 
    // Bottom cap
-   glBegin(GL_TRIANGLE_FAN);
-   glNormal3d(0, -1, 0);
+   MeshBegin(mesh, GL_TRIANGLE_FAN);
+   MeshNormal3f(mesh, 0, -1, 0);
    if (useTexture)
-      glTexCoord2f(0.5, 0.5);     // Center
-   glVertex3f(0, -height / 2, 0); // center
+      MeshTexCoord2f(mesh, 0.5, 0.5); // Center
+   MeshVertex3f(mesh, 0, -0.5, 0);    // center
    for (int i = 0; i <= slices; i++)
    {
       double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-
       if (useTexture)
-      {
-         double u = 0.5 + 0.5 * cos(theta);
-         double v = 0.5 + 0.5 * sin(theta);
-         glTexCoord2f(u, v);
-      }
-      glVertex3f(dx, -height / 2, dz);
+         MeshTexCoord2f(mesh, 0.5 + 0.5 * cos(theta), 0.5 + 0.5 * sin(theta));
+      MeshVertex3f(mesh, cos(theta), -0.5, sin(theta));
    }
-   glEnd();
+   MeshEnd(mesh);
 
-   glPopMatrix();
+   MeshUpload(mesh);
+   return mesh;
 }
 
 void cylinderTex(double x, double y, double z,
@@ -440,132 +649,128 @@ void cylinderTex(double x, double y, double z,
    glRotated(thX, 1, 0, 0);
    glRotated(thY, 0, 1, 0);
    glRotated(thZ, 0, 0, 1);
-   if (useTexture)
-   {
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, texture[tex1]);
-   }
-   // Cylinder Side
-   glBegin(GL_QUAD_STRIP);
-   for (int i = 0; i <= slices; i++)
-   {
-      double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-      double u = (double)i / slices;
-
-      glNormal3d(cos(theta), 0, sin(theta));
-      glTexCoord2f(0, u);
-      glVertex3f(dx, -height / 2, dz); // bottom
-
-      glTexCoord2f(1, u);
-      glVertex3f(dx, height / 2, dz); // top
-   }
-   glEnd();
+   glScaled(radius, height, radius);
 
+   Mesh *mesh = CylinderTexMesh(slices, useTexture);
    if (useTexture)
    {
-      glBindTexture(GL_TEXTURE_2D, texture[tex2]);
-   }
-   // Top cap
-   glBegin(GL_TRIANGLE_FAN);
-   glNormal3d(0, 1, 0);
-   if (useTexture)
-      glTexCoord2f(0.5, 0.5);    // Center of texture
-   glVertex3f(0, height / 2, 0); // center
-   for (int i = 0; i <= slices; i++)
-   {
-      double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-
-      if (useTexture)
-      {
-         // Map circle to texture space (0.5, 0.5) = center
-         double u = 0.5 + 0.5 * cos(theta);
-         double v = 0.5 + 0.5 * sin(theta);
-         glTexCoord2f(u, v);
-      }
-      glVertex3f(dx, height / 2, dz);
+      StateEnable(GL_TEXTURE_2D);
+      StateBindTexture(texture[tex1]);
    }
-   glEnd();
+   // Cylinder Side
+   MeshDrawPart(mesh, 0);
 
-   // Bottom cap
-   glBegin(GL_TRIANGLE_FAN);
-   glNormal3d(0, -1, 0);
    if (useTexture)
-      glTexCoord2f(0.5, 0.5);     // Center
-   glVertex3f(0, -height / 2, 0); // center
-   for (int i = 0; i <= slices; i++)
    {
-      double theta = 2.0 * M_PI * i / slices;
-      double dx = radius * cos(theta);
-      double dz = radius * sin(theta);
-
-      if (useTexture)
-      {
-         double u = 0.5 + 0.5 * cos(theta);
-         double v = 0.5 + 0.5 * sin(theta);
-         glTexCoord2f(u, v);
-      }
-      glVertex3f(dx, -height / 2, dz);
+      StateBindTexture(texture[tex2]);
    }
-   glEnd();
-   glDisable(GL_TEXTURE_2D);
+   // Top and bottom caps
+   MeshDrawPart(mesh, 1);
+   StateDisable(GL_TEXTURE_2D);
 
    glPopMatrix();
 }
 
-// Draw a triangular prism
-void prism(double base, double height, double depth)
+//
+//  Unit triangular prism (base, height and depth of 1)
+//
+static Mesh *PrismMesh(void)
 {
-   double halfBase = base / 2.0;
-   double halfDepth = depth / 2.0;
+   MeshKey key = {SHAPE_PRISM};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+
+   double halfBase = 0.5;
+   double halfDepth = 0.5;
+   double height = 1;
 
    // Front triangle (z = +halfDepth)
-   glBegin(GL_TRIANGLES);
-   glNormal3f(0, 0, 1);
-   glVertex3f(-halfBase, -height / 2, halfDepth); // left
-   glVertex3f(halfBase, -height / 2, halfDepth);  // right
-   glVertex3f(0.0, height / 2, halfDepth);        // top
-   glEnd();
+   MeshBegin(mesh, GL_TRIANGLES);
+   MeshNormal3f(mesh, 0, 0, 1);
+   MeshVertex3f(mesh, -halfBase, -height / 2, halfDepth); // left
+   MeshVertex3f(mesh, halfBase, -height / 2, halfDepth);  // right
+   MeshVertex3f(mesh, 0.0, height / 2, halfDepth);        // top
+   MeshEnd(mesh);
 
    // Back triangle (z = -halfDepth)
-   glBegin(GL_TRIANGLES);
-   glNormal3f(0, 0, -1);
-   glVertex3f(-halfBase, -height / 2, -halfDepth);
-   glVertex3f(halfBase, -height / 2, -halfDepth);
-   glVertex3f(0.0, height / 2, -halfDepth);
-   glEnd();
+   MeshBegin(mesh, GL_TRIANGLES);
+   MeshNormal3f(mesh, 0, 0, -1);
+   MeshVertex3f(mesh, -halfBase, -height / 2, -halfDepth);
+   MeshVertex3f(mesh, halfBase, -height / 2, -halfDepth);
+   MeshVertex3f(mesh, 0.0, height / 2, -halfDepth);
+   MeshEnd(mesh);
 
    // Left side
    double len_left = sqrt(height * height + halfBase * halfBase);
-   glBegin(GL_QUADS);
-   glNormal3f(-height / len_left, halfBase / len_left, 0);
-   glVertex3f(-halfBase, -height / 2, halfDepth);
-   glVertex3f(-halfBase, -height / 2, -halfDepth);
-   glVertex3f(0.0, height / 2, -halfDepth);
-   glVertex3f(0.0, height / 2, halfDepth);
-   glEnd();
+   MeshBegin(mesh, GL_QUADS);
+   MeshNormal3f(mesh, -height / len_left, halfBase / len_left, 0);
+   MeshVertex3f(mesh, -halfBase, -height / 2, halfDepth);
+   MeshVertex3f(mesh, -halfBase, -height / 2, -halfDepth);
+   MeshVertex3f(mesh, 0.0, height / 2, -halfDepth);
+   MeshVertex3f(mesh, 0.0, height / 2, halfDepth);
+   MeshEnd(mesh);
 
    // Right side
    double len_right = sqrt(height * height + halfBase * halfBase);
-   glBegin(GL_QUADS);
-   glNormal3f(height / len_right, halfBase / len_right, 0);
-   glVertex3f(halfBase, -height / 2, halfDepth);
-   glVertex3f(halfBase, -height / 2, -halfDepth);
-   glVertex3f(0.0, height / 2, -halfDepth);
-   glVertex3f(0.0, height / 2, halfDepth);
-   glEnd();
+   MeshBegin(mesh, GL_QUADS);
+   MeshNormal3f(mesh, height / len_right, halfBase / len_right, 0);
+   MeshVertex3f(mesh, halfBase, -height / 2, halfDepth);
+   MeshVertex3f(mesh, halfBase, -height / 2, -halfDepth);
+   MeshVertex3f(mesh, 0.0, height / 2, -halfDepth);
+   MeshVertex3f(mesh, 0.0, height / 2, halfDepth);
+   MeshEnd(mesh);
 
    // Bottom side
-   glBegin(GL_QUADS);
-   glNormal3f(0, -1, 0);
-   glVertex3f(-halfBase, -height / 2, halfDepth);
-   glVertex3f(halfBase, -height / 2, halfDepth);
-   glVertex3f(halfBase, -height / 2, -halfDepth);
-   glVertex3f(-halfBase, -height / 2, -halfDepth);
-   glEnd();
+   MeshBegin(mesh, GL_QUADS);
+   MeshNormal3f(mesh, 0, -1, 0);
+   MeshVertex3f(mesh, -halfBase, -height / 2, halfDepth);
+   MeshVertex3f(mesh, halfBase, -height / 2, halfDepth);
+   MeshVertex3f(mesh, halfBase, -height / 2, -halfDepth);
+   MeshVertex3f(mesh, -halfBase, -height / 2, -halfDepth);
+   MeshEnd(mesh);
+
+   MeshUpload(mesh);
+   return mesh;
+}
+
+// Draw a triangular prism
+void prism(double base, double height, double depth)
+{
+   // Unit prism scaled to size (normals are renormalized by GL_NORMALIZE)
+   glPushMatrix();
+   glScaled(base, height, depth);
+   MeshDraw(PrismMesh());
+   glPopMatrix();
+}
+
+//
+//  Unit rectangle in the XY plane
+//
+static Mesh *RectangleMesh(int texMode)
+{
+   MeshKey key = {SHAPE_RECTANGLE, 0, 0, texMode};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   mesh->texCoords = texMode;
+
+   MeshBegin(mesh, GL_QUADS);
+   MeshNormal3f(mesh, 0, 0, 1);
+   MeshTexCoord2f(mesh, 0, 0);
+   MeshVertex3f(mesh, -0.5, -0.5, 0); // bottom left
+   MeshTexCoord2f(mesh, 1, 0);
+   MeshVertex3f(mesh, +0.5, -0.5, 0); // bottom right
+   MeshTexCoord2f(mesh, 1, 1);
+   MeshVertex3f(mesh, +0.5, +0.5, 0); // top right
+   MeshTexCoord2f(mesh, 0, 1);
+   MeshVertex3f(mesh, -0.5, +0.5, 0); // top left
+   MeshEnd(mesh);
+
+   MeshUpload(mesh);
+   return mesh;
 }
 
 void rectangle(double x, double y, double z,    // center position
@@ -583,13 +788,8 @@ void rectangle(double x, double y, double z,    // center position
    glRotated(rz, 0, 0, 1); // rotate about Z
 
    // Draw filled rectangle (in XY plane, z=0)
-   glBegin(GL_QUADS);
-   glNormal3f(0, 0, 1);
-   glVertex3f(-w / 2, -h / 2, 0); // bottom left
-   glVertex3f(+w / 2, -h / 2, 0); // bottom right
-   glVertex3f(+w / 2, +h / 2, 0); // top right
-   glVertex3f(-w / 2, +h / 2, 0); // top left
-   glEnd();
+   glScaled(w, h, 1);
+   MeshDraw(RectangleMesh(0));
 
    glPopMatrix();
 }
@@ -597,15 +797,53 @@ void rectangle(double x, double y, double z,    // center position
 /*
  *  Draw vertex in polar coordinates with normal
  */
-static void Vertex(double th, double ph)
+static void Vertex(Mesh *mesh, double th, double ph)
 {
    double x = Sin(th) * Cos(ph);
    double y = Cos(th) * Cos(ph);
    double z = Sin(ph);
    //  For a sphere at the origin, the position
    //  and normal vectors are the same
-   glNormal3d(x, y, z);
-   glVertex3d(x, y, z);
+   MeshNormal3f(mesh, x, y, z);
+   MeshVertex3f(mesh, x, y, z);
+}
+
+//
+//  Unit sphere with bands of d degrees
+//
+static Mesh *SphereMesh(int d)
+{
+   MeshKey key = {SHAPE_SPHERE, d};
+   Mesh *mesh = MeshCacheFind(&key);
+   if (mesh)
+      return mesh;
+   mesh = MeshCacheAdd(&key);
+   //  Bands of latitude
+   for (int ph = -90; ph < 90; ph += d)
+   {
+      MeshBegin(mesh, GL_QUAD_STRIP);
+      for (int th = 0; th <= 360; th += 2 * d)
+      {
+         Vertex(mesh, th, ph);
+         Vertex(mesh, th, ph + d);
+      }
+      MeshEnd(mesh);
+   }
+   MeshUpload(mesh);
+   return mesh;
+}
+
+//
+//  Band size in degrees for a sphere of radius r at the origin
+//
+static int SphereBand(double r)
+{
+   //  Bands that divide 90 degrees, halving the segments around each level
+   static const int band[LOD_LEVELS] = {10, 15, 30, 45};
+   int seg[LOD_LEVELS];
+   for (int k = 0; k < LOD_LEVELS; k++)
+      seg[k] = 180 / band[k];
+   return band[LodLevel(SHAPE_SPHERE, seg, r)];
 }
 
 /*
@@ -619,25 +857,16 @@ void ball(double x, double y, double z, double r)
    glPushMatrix();
    //  Offset, scale and rotate
    glTranslated(x, y, z);
+   int d = SphereBand(r);
    glScaled(r, r, r);
    //  White ball with yellow specular
    float yellow[] = {1.0, 1.0, 0.0, 1.0};
    float Emission[] = {0.0, 0.0, 0.01 * 1, 1.0};
    glColor3f(1, 1, 1);
-   glMaterialf(GL_FRONT, GL_SHININESS, 1);
-   glMaterialfv(GL_FRONT, GL_SPECULAR, yellow);
-   glMaterialfv(GL_FRONT, GL_EMISSION, Emission);
-   //  Bands of latitude
-   for (int ph = -90; ph < 90; ph += 10)
-   {
-      glBegin(GL_QUAD_STRIP);
-      for (int th = 0; th <= 360; th += 2 * 10)
-      {
-         Vertex(th, ph);
-         Vertex(th, ph + 10);
-      }
-      glEnd();
-   }
+   StateMaterialf(GL_SHININESS, 1);
+   StateMaterialfv(GL_SPECULAR, yellow);
+   StateMaterialfv(GL_EMISSION, Emission);
+   MeshDraw(SphereMesh(d));
    glPopMatrix();
 }
 
@@ -653,17 +882,7 @@ void sphere(double x, double y, double z, double r)
    //  Offset, scale and rotate
    glTranslated(x, y, z);
    glScaled(r, r, r);
-   //  Bands of latitude
-   for (int ph = -90; ph < 90; ph += 10)
-   {
-      glBegin(GL_QUAD_STRIP);
-      for (int th = 0; th <= 360; th += 2 * 10)
-      {
-         Vertex(th, ph);
-         Vertex(th, ph + 10);
-      }
-      glEnd();
-   }
+   MeshDraw(SphereMesh(SphereBand(r)));
    glPopMatrix();
 }
 
@@ -677,29 +896,16 @@ void rectangleTex(double x, double y, double z, double width, double height, dou
 
    if (useTexture)
    {
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, texture);
+      StateEnable(GL_TEXTURE_2D);
+      StateBindTexture(texture);
    }
 
-   glBegin(GL_QUADS);
-   glNormal3f(0, 0, 1);
-   if (useTexture)
-      glTexCoord2f(0, 0);
-   glVertex3f(-width / 2, -height / 2, 0);
-   if (useTexture)
-      glTexCoord2f(1, 0);
-   glVertex3f(width / 2, -height / 2, 0);
-   if (useTexture)
-      glTexCoord2f(1, 1);
-   glVertex3f(width / 2, height / 2, 0);
-   if (useTexture)
-      glTexCoord2f(0, 1);
-   glVertex3f(-width / 2, height / 2, 0);
-   glEnd();
+   glScaled(width, height, 1);
+   MeshDraw(RectangleMesh(useTexture));
 
    if (useTexture)
    {
-      glDisable(GL_TEXTURE_2D);
+      StateDisable(GL_TEXTURE_2D);
    }
 
    glPopMatrix();
@@ -0,0 +1,59 @@
+//  Cube map skybox
+//
+//  The six faces of a sky are one cube map, drawn as a cube around the eye
+//  with a single draw call after the opaque scene.  The vertex shader puts
+//  every vertex on the far plane and the depth test passes only where the
+//  depth buffer is still clear, so sky pixels covered by the scene are never
+//  shaded.  Faces are wound to be seen from inside and the outside is
+//  culled, which also hides the face behind the eye of an orthogonal view.
+#include "CSCIx229.h"
+
+static ShaderProgram *shader = NULL;
+
+//  Faces of a unit cube seen from inside (+X, -X, +Y, -Y, +Z, -Z)
+static const float faces[24][3] = {
+   {+1, +1, +1}, {+1, +1, -1}, {+1, -1, -1}, {+1, -1, +1},
+   {-1, +1, -1}, {-1, +1, +1}, {-1, -1, +1}, {-1, -1, -1},
+   {-1, +1, -1}, {+1, +1, -1}, {+1, +1, +1}, {-1, +1, +1},
+   {-1, -1, +1}, {+1, -1, +1}, {+1, -1, -1}, {-1, -1, -1},
+   {-1, -1, +1}, {-1, +1, +1}, {+1, +1, +1}, {+1, -1, +1},
+   {+1, -1, -1}, {+1, +1, -1}, {-1, +1, -1}, {-1, -1, -1},
+};
+
+/*
+ *  Draw a cube map sky in a cube of half width size around the eye
+ *     Call after the opaque scene with the camera in the modelview matrix
+ */
+void SkyDraw(unsigned int cubemap, const double eye[3], float size)
+{
+   if (!shader)
+      shader = ShaderNew("sky.vert", "sky.frag");
+
+   glPushMatrix();
+   glTranslated(eye[0], eye[1], eye[2]);
+   glScalef(size, size, size);
+
+   glUseProgram(shader->id);
+   ShaderSet1i(shader, "sky", 0);
+   glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+
+   //  Far plane passes where nothing was drawn, nothing to write
+   int depthFunc, cull = glIsEnabled(GL_CULL_FACE);
+   glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+   glDepthFunc(GL_LEQUAL);
+   glDepthMask(GL_FALSE);
+   glEnable(GL_CULL_FACE);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3, GL_FLOAT, 0, faces);
+   glDrawArrays(GL_QUADS, 0, 24);
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+   if (!cull)
+      glDisable(GL_CULL_FACE);
+   glDepthMask(GL_TRUE);
+   glDepthFunc(depthFunc);
+   glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+   glUseProgram(0);
+   glPopMatrix();
+}
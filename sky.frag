@@ -0,0 +1,10 @@
+#version 120
+
+uniform samplerCube sky;  // day or night sky
+
+varying vec3 dir;
+
+void main()
+{
+    gl_FragColor = textureCube(sky, dir);
+}
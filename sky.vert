@@ -0,0 +1,13 @@
+#version 120
+
+// Skybox cube around the eye, pushed back to the far plane so only the
+// pixels nothing else covered pass the depth test
+varying vec3 dir;  // direction looked up in the cube map
+
+void main()
+{
+    // Faces are BMP rows stored bottom up, upside down for a cube map,
+    // so the loader put the top and bottom images in the -Y and +Y faces
+    dir = vec3(gl_Vertex.x, -gl_Vertex.y, gl_Vertex.z);
+    gl_Position = (gl_ModelViewProjectionMatrix * gl_Vertex).xyww;
+}
@@ -3,6 +3,7 @@
 attribute vec3 splashData;  // (xPos, zPos, collisionTime)
 //currtime
 uniform float time;
+uniform float pointScale;  // pixels of the target per pixel of the window
 
 void main()
 {
@@ -25,6 +26,6 @@ void main()
 
     // small to big
     float progress = age / 0.4;  // 0 to 1
-    gl_PointSize = 5.0 + progress * 30.0;  // Grows from 5 to 25
+    gl_PointSize = (5.0 + progress * 30.0) * pointScale;  // Grows from 5 to 25
     gl_FrontColor = vec4(1.0, 1.0, 1.0, 1.0 - progress);  // Fades out
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 120
+
+attribute vec4 rainData;  // (xPos, zPos, speed, length) of the drop
+
+uniform float time;       // current time
+uniform float height;     // height drops fall from
+uniform float pointScale; // pixels of the target per pixel of the window
+
+void main()
+{
+    float xPos = rainData.x;
+    float zPos = rainData.y;
+    float speed = rainData.z;
+
+    // The drop falls mod(time*speed, height) like in rain.vert and splashes
+    // when it passes 0.5 above the ground, so the distance it has fallen
+    // since then (in this or the previous fall) gives the age of its splash
+    float since = mod(time * speed - (height - 0.5), height);
+    float age = since / speed;
+
+    // if greater than 0.4, means the entire animation of it growing has completed
+    if (age > 0.4) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);  // outside the view
+        gl_PointSize = 0.0;
+        return;
+    }
+
+    // Splash generated just above ground
+    vec3 pos = vec3(xPos, 0.05, zPos);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(pos, 1.0);
+
+    // small to big
+    float progress = age / 0.4;  // 0 to 1
+    gl_PointSize = (5.0 + progress * 30.0) * pointScale;  // Grows from 5 to 25
+    gl_FrontColor = vec4(1.0, 1.0, 1.0, 1.0 - progress);  // Fades out
+}
@@ -0,0 +1,27 @@
+#version 120
+
+attribute vec4 dropSplash;  // (xPos, zPos, time) of the last splash of the drop
+
+uniform float time;         // current time
+uniform float pointScale;   // pixels of the target per pixel of the window
+
+void main()
+{
+    float age = time - dropSplash.z;
+
+    // if greater than 0.4, means the entire animation of it growing has completed
+    if (age < 0.0 || age > 0.4) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);  // outside the view
+        gl_PointSize = 0.0;
+        return;
+    }
+
+    // Splash generated just above ground
+    vec3 pos = vec3(dropSplash.x, 0.05, dropSplash.y);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(pos, 1.0);
+
+    // small to big
+    float progress = age / 0.4;  // 0 to 1
+    gl_PointSize = (5.0 + progress * 30.0) * pointScale;  // Grows from 5 to 25
+    gl_FrontColor = vec4(1.0, 1.0, 1.0, 1.0 - progress);  // Fades out
+}
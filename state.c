@@ -0,0 +1,217 @@
+//  GL state cache
+//
+//  Material, texture binding, enable bits, blend function and texture
+//  environment set through these functions are remembered so calls that
+//  would not change anything are dropped before they reach GL.  Drawing
+//  code must change this state through the cache.  Anything else that
+//  changes it (glPopAttrib, texture loading) must be followed by
+//  StateReset so the cache stops trusting what it remembers.
+#include "CSCIx229.h"
+
+#define STATE_CAPS 16 //  Enable bits tracked
+
+static struct
+{
+   GLenum cap;
+   int on;
+} caps[STATE_CAPS];
+static int ncaps = 0;
+
+static float material[5][4];          //  Ambient, diffuse, specular, emission, shininess
+static int materialValid[5];          //  Material parameter is known
+static unsigned int texture = 0;      //  Texture bound to GL_TEXTURE_2D
+static int textureValid = 0;
+static int blendSrc, blendDst;        //  Blend function
+static int blendSrcA, blendDstA;      //  Blend function for alpha
+static int blendValid = 0;
+static int texEnv;                    //  Texture environment mode
+static int texEnvValid = 0;
+
+static int calls = 0;  //  Calls made through the cache since the last reset
+static int elided = 0; //  Calls dropped since the last reset
+static int binds = 0;  //  Textures bound since the last reset
+
+/*
+ *  Forget all remembered state
+ */
+void StateReset(void)
+{
+   for (int k = 0; k < ncaps; k++)
+      caps[k].on = -1;
+   memset(materialValid, 0, sizeof(materialValid));
+   textureValid = blendValid = texEnvValid = 0;
+}
+
+//
+//  Slot of an enable bit
+//
+static int StateCap(GLenum cap)
+{
+   for (int k = 0; k < ncaps; k++)
+      if (caps[k].cap == cap)
+         return k;
+   if (ncaps == STATE_CAPS)
+      Fatal("Too many enable bits in state cache\n");
+   caps[ncaps].cap = cap;
+   caps[ncaps].on = -1;
+   return ncaps++;
+}
+
+/*
+ *  glEnable/glDisable unless already set
+ */
+void StateEnable(GLenum cap)
+{
+   int k = StateCap(cap);
+   calls++;
+   if (caps[k].on == 1)
+   {
+      elided++;
+      return;
+   }
+   glEnable(cap);
+   caps[k].on = 1;
+}
+
+void StateDisable(GLenum cap)
+{
+   int k = StateCap(cap);
+   calls++;
+   if (caps[k].on == 0)
+   {
+      elided++;
+      return;
+   }
+   glDisable(cap);
+   caps[k].on = 0;
+}
+
+//
+//  Slot of a material parameter
+//
+static int StateMaterialSlot(GLenum pname)
+{
+   switch (pname)
+   {
+   case GL_AMBIENT:
+      return 0;
+   case GL_DIFFUSE:
+      return 1;
+   case GL_SPECULAR:
+      return 2;
+   case GL_EMISSION:
+      return 3;
+   case GL_SHININESS:
+      return 4;
+   }
+   Fatal("Unsupported material parameter %d\n", pname);
+}
+
+/*
+ *  glMaterialfv(GL_FRONT_AND_BACK, ...) unless already set
+ */
+void StateMaterialfv(GLenum pname, const float *v)
+{
+   int k = StateMaterialSlot(pname);
+   int n = pname == GL_SHININESS ? 1 : 4;
+   calls++;
+   if (materialValid[k] && !memcmp(material[k], v, n * sizeof(float)))
+   {
+      elided++;
+      return;
+   }
+   glMaterialfv(GL_FRONT_AND_BACK, pname, v);
+   memcpy(material[k], v, n * sizeof(float));
+   materialValid[k] = 1;
+}
+
+/*
+ *  glMaterialf(GL_FRONT_AND_BACK, ...) unless already set
+ */
+void StateMaterialf(GLenum pname, float v)
+{
+   StateMaterialfv(pname, &v);
+}
+
+/*
+ *  glBindTexture(GL_TEXTURE_2D, ...) unless already bound
+ */
+void StateBindTexture(unsigned int tex)
+{
+   calls++;
+   if (textureValid && texture == tex)
+   {
+      elided++;
+      return;
+   }
+   glBindTexture(GL_TEXTURE_2D, tex);
+   texture = tex;
+   textureValid = 1;
+   binds++;
+}
+
+/*
+ *  glBlendFuncSeparate unless already set
+ */
+void StateBlendFuncSeparate(GLenum src, GLenum dst, GLenum srcAlpha, GLenum dstAlpha)
+{
+   calls++;
+   if (blendValid && blendSrc == (int)src && blendDst == (int)dst &&
+       blendSrcA == (int)srcAlpha && blendDstA == (int)dstAlpha)
+   {
+      elided++;
+      return;
+   }
+   if (src == srcAlpha && dst == dstAlpha)
+      glBlendFunc(src, dst);
+   else
+      glBlendFuncSeparate(src, dst, srcAlpha, dstAlpha);
+   blendSrc = src;
+   blendDst = dst;
+   blendSrcA = srcAlpha;
+   blendDstA = dstAlpha;
+   blendValid = 1;
+}
+
+/*
+ *  glBlendFunc unless already set
+ */
+void StateBlendFunc(GLenum src, GLenum dst)
+{
+   StateBlendFuncSeparate(src, dst, src, dst);
+}
+
+/*
+ *  Texture environment mode unless already set
+ */
+void StateTexEnv(int mode)
+{
+   calls++;
+   if (texEnvValid && texEnv == mode)
+   {
+      elided++;
+      return;
+   }
+   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, mode);
+   texEnv = mode;
+   texEnvValid = 1;
+}
+
+/*
+ *  Calls made through the cache and calls elided since the last reset
+ */
+void StateStats(int *made, int *dropped, int reset)
+{
+   *made = calls;
+   *dropped = elided;
+   if (reset)
+      calls = elided = binds = 0;
+}
+
+/*
+ *  Textures bound through the cache since StateStats last reset
+ */
+int StateTextureBinds(void)
+{
+   return binds;
+}
@@ -0,0 +1,127 @@
+//  Texture filtering
+//
+//  Textures that get minified (tiled ground, road, banners seen from far
+//  away) are sampled trilinearly from a full mipmap chain, optionally with
+//  anisotropic filtering.  The BMP loader builds the chain with a box filter
+//  on its decode threads; glGenerateMipmap builds it for other textures.
+//  Every mipmapped texture is remembered so the filtering can be changed at
+//  run time.
+//  Textures only ever drawn near their own size (HUD, UI, skybox faces) ask
+//  for TEX_LINEAR and keep plain bilinear filtering without mipmaps.
+#include "CSCIx229.h"
+
+static int supported = -1;    //  glGenerateMipmap available (-1 = not checked)
+static float maxAniso = 1;    //  Largest anisotropy the driver allows
+static int s3tc = 0;          //  DXT1 compressed textures available
+static int trilinear = 1;     //  Sample mipmapped textures through their mipmaps
+static float anisotropy = 1;  //  Anisotropy of mipmapped textures
+static unsigned int *tex;     //  Mipmapped textures
+static GLenum *target;        //  and their targets
+static int ntex = 0, maxtex = 0;
+
+//
+//  Check for glGenerateMipmap (OpenGL 3.0 or ARB_framebuffer_object),
+//  anisotropic filtering and S3TC compression
+//
+static int TexSupported(void)
+{
+   if (supported < 0)
+   {
+      const char *version = (const char *)glGetString(GL_VERSION);
+      const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+      int major = 0;
+      supported = (version && sscanf(version, "%d", &major) == 1 && major >= 3) ||
+                  (ext && strstr(ext, "GL_ARB_framebuffer_object"));
+      if (ext && strstr(ext, "GL_EXT_texture_filter_anisotropic"))
+         glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAniso);
+      s3tc = ext && strstr(ext, "GL_EXT_texture_compression_s3tc");
+   }
+   return supported;
+}
+
+//
+//  Set the filters of the bound mipmapped texture
+//
+static void TexApply(GLenum tgt)
+{
+   glTexParameteri(tgt, GL_TEXTURE_MIN_FILTER, trilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+   glTexParameteri(tgt, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   if (maxAniso > 1)
+      glTexParameterf(tgt, GL_TEXTURE_MAX_ANISOTROPY_EXT, trilinear ? anisotropy : 1);
+}
+
+/*
+ *  Set the filtering of the texture bound to target
+ *     TEX_MIPMAP samples its mipmaps trilinearly, building them from level 0
+ *     if only level 0 was loaded.  TEX_LINEAR (or no way to build the
+ *     mipmaps) keeps bilinear filtering.
+ */
+void TexFilter(GLenum tgt, int filter)
+{
+   int mipmaps = 0;
+   if (filter == TEX_MIPMAP)
+      glGetTexLevelParameteriv(tgt, 1, GL_TEXTURE_WIDTH, &mipmaps);
+   if (filter == TEX_MIPMAP && !mipmaps && TexSupported())
+   {
+      glGenerateMipmap(tgt);
+      mipmaps = 1;
+   }
+   if (!mipmaps)
+   {
+      glTexParameteri(tgt, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(tgt, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      return;
+   }
+   TexSupported();
+   TexApply(tgt);
+
+   //  Remember it for TexFiltering
+   if (ntex == maxtex)
+   {
+      maxtex = maxtex ? 2 * maxtex : 64;
+      tex = (unsigned int *)realloc(tex, maxtex * sizeof(unsigned int));
+      target = (GLenum *)realloc(target, maxtex * sizeof(GLenum));
+      if (!tex || !target)
+         Fatal("Cannot allocate %d mipmapped textures\n", maxtex);
+   }
+   glGetIntegerv(tgt == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_2D_ARRAY_EXT, (int *)&tex[ntex]);
+   target[ntex++] = tgt;
+}
+
+/*
+ *  Change how every mipmapped texture is sampled
+ *     trilinear 0 falls back to bilinear from the full size image,
+ *     aniso is clamped to what the driver allows
+ */
+void TexFiltering(int tri, float aniso)
+{
+   TexSupported();
+   trilinear = tri;
+   anisotropy = aniso < 1 ? 1 : aniso > maxAniso ? maxAniso : aniso;
+   for (int k = 0; k < ntex; k++)
+   {
+      glBindTexture(target[k], tex[k]);
+      TexApply(target[k]);
+      glBindTexture(target[k], 0);
+   }
+   //  Bindings changed behind the state cache
+   StateReset();
+}
+
+/*
+ *  Check the driver takes DXT1 compressed textures (call on the GL thread)
+ */
+int TexCompressed(void)
+{
+   TexSupported();
+   return s3tc;
+}
+
+/*
+ *  Largest anisotropy the driver allows (1 without anisotropic filtering)
+ */
+float TexMaxAnisotropy(void)
+{
+   TexSupported();
+   return maxAniso;
+}
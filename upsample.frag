@@ -0,0 +1,46 @@
+#version 120
+
+uniform sampler2D colour;      // small target, premultiplied colour
+uniform sampler2D lowDepth;    // depth of the small target
+uniform sampler2D sceneDepth;  // depth of the scene at full resolution
+uniform vec2 lowSize;          // size of the small target
+uniform vec2 scale;            // part of the small target covering the window
+uniform vec3 proj;             // projection matrix [10], [14] and [11] (0 when orthogonal)
+
+varying vec2 uv;
+
+// Distance for a depth buffer value, from the eye for a perspective
+// projection and from the near plane for an orthogonal one (which can be
+// behind the eye), so it is positive either way
+float linear(float depth)
+{
+    float ndc = 2.0 * depth - 1.0;
+    if (proj.z == 0.0)
+        return (ndc + 1.0) / -proj.x;
+    return proj.y / (ndc + proj.x);
+}
+
+void main()
+{
+    float z = linear(texture2D(sceneDepth, uv).r);
+
+    // Four nearest texels of the small target and their bilinear weights
+    vec2 p = uv * scale * lowSize - 0.5;
+    vec2 f = fract(p);
+    vec2 base = (floor(p) + 0.5) / lowSize;
+
+    vec4 sum = vec4(0.0);
+    float total = 0.0;
+    for (int j = 0; j < 2; j++)
+        for (int i = 0; i < 2; i++)
+        {
+            vec2 t = base + vec2(i, j) / lowSize;
+            float w = (i == 0 ? 1.0 - f.x : f.x) * (j == 0 ? 1.0 - f.y : f.y);
+            // Texels at a different depth belong to something else
+            float zt = linear(texture2D(lowDepth, t).r);
+            w /= 0.01 + abs(zt - z) / max(z, 0.01);
+            sum += w * texture2D(colour, t);
+            total += w;
+        }
+    gl_FragColor = sum / max(total, 1e-6);
+}